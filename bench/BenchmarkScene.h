@@ -0,0 +1,58 @@
+#pragma once
+#include "Renderer.h"
+#include "MeshLoader.h"
+#include <cmath>
+#include <functional>
+#include <string>
+
+using namespace tgl;
+
+//The scene the renderer benchmarks draw: one mesh with three levels of detail, a grid of its entities in front of a
+//camera at the origin and a light above them. A header, since every .cpp in bench/ becomes its own executable.
+struct BenchmarkScene {
+    //Frames rendered before measuring
+    static const uint32_t WARM_UP_FRAMES = 10;
+
+    Camera camera;
+    Light light{};
+    //The scene's reference, the entities hold their own
+    MeshHandle mesh;
+
+    //Loads the model into the renderer
+    BenchmarkScene(Renderer &renderer, const std::string &modelPath) {
+        MeshLoadOptions loadOptions;
+        loadOptions.lodRatios = {0.5F, 0.25F, 0.125F};
+        mesh = renderer.addMesh(MeshLoader::loadObj(modelPath.c_str(), {1, 0, 0, 1}, loadOptions));
+        camera.farClipPlane = 1000;
+        camera.nearClipPlane = 0.1f;
+        camera.fov = 80;
+        camera.position = {0, 0, 0};
+        light.position = {0, -6, 0};
+    }
+
+    //Registers entityCount entities of the mesh in a square grid
+    void addEntityGrid(Renderer &renderer, uint32_t entityCount) const {
+        std::vector<Entity> entities;
+        entities.reserve(entityCount);
+        const uint32_t gridSize = (uint32_t) std::ceil(std::sqrt((double) entityCount));
+        for (uint32_t i = 0; i < entityCount; i++) {
+            Entity entity(mesh);
+            entity.scale = {0.1, 0.1, 0.1};
+            entity.position = {(float) (i % gridSize) * 3, 1, (float) (i / gridSize) * 3 + 3};
+            renderer.uploadEntity(entity);
+            entities.push_back(entity);
+        }
+        renderer.registerEntities(entities);
+    }
+
+    //Warm up so uploads and buffer growth don't end up in the average. beforeFrame runs ahead of every frame, e.g. to
+    //poll window events, returning false stops early.
+    void warmUp(Renderer &renderer, const std::function<bool()> &beforeFrame = nullptr) {
+        for (uint32_t i = 0; i < WARM_UP_FRAMES; i++) {
+            if (beforeFrame && !beforeFrame()) {
+                return;
+            }
+            renderer.render(camera, light);
+        }
+    }
+};
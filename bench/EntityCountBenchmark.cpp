@@ -0,0 +1,63 @@
+#include "BenchmarkScene.h"
+#include "Window.h"
+#include "TGL.h"
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+
+//Renders a grid of entities sharing one mesh and reports the average frame time for each entity count, to see how
+//the per entity CPU cost of recording and submitting a frame scales.
+//Usage: EntityCountBenchmark [modelPath] [frameCount] [entityCount...]
+int main(int argc, char **argv) {
+    std::string modelPath = argc > 1 ? argv[1] : "../resources/models/Porsche.obj";
+    uint32_t frameCount = argc > 2 ? std::stoul(argv[2]) : 300;
+    std::vector<uint32_t> entityCounts;
+    for (int i = 3; i < argc; i++) {
+        entityCounts.push_back(std::stoul(argv[i]));
+    }
+    if (entityCounts.empty()) {
+        entityCounts = {1000, 10000, 20000};
+    }
+    std::cout << std::fixed << std::setprecision(3);
+
+    TGL::init();
+    Window window("Entity Count Benchmark", 1280, 720, false, {0, 0, 0, 1});
+    window.create();
+    Renderer renderer(&window, 3);
+    renderer.init();
+
+    BenchmarkScene scene(renderer, modelPath);
+
+    for (uint32_t entityCount : entityCounts) {
+        scene.addEntityGrid(renderer, entityCount);
+        scene.warmUp(renderer, [&]() {
+            if (window.hasRequestedClose()) {
+                return false;
+            }
+            window.updateEvents();
+            return true;
+        });
+        uint32_t renderedFrames = 0;
+        double waitMs = 0;
+        auto start = std::chrono::high_resolution_clock::now();
+        while (renderedFrames < frameCount && !window.hasRequestedClose()) {
+            window.updateEvents();
+            renderer.render(scene.camera, scene.light);
+            waitMs += renderer.getCpuWaitMilliseconds();
+            renderedFrames++;
+        }
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+        std::cout << entityCount << " entities: " << ms / std::max(renderedFrames, 1U) << " ms per frame over "
+                  << renderedFrames << " frames, " << renderer.getDrawCallCount() << " draw calls, "
+                  << renderer.getVisibleInstanceCount() << " visible, " << renderer.getBindCounters().getIssued()
+                  << " binds issued, " << renderer.getBindCounters().getSkipped() << " skipped, "
+                  << waitMs / std::max(renderedFrames, 1U) << " ms per frame waiting on the GPU" << std::endl;
+        renderer.clearEntities();
+    }
+
+    renderer.releaseMesh(scene.mesh);
+    renderer.destroy();
+    window.destroy();
+    TGL::terminate();
+    return 0;
+}
@@ -0,0 +1,74 @@
+#include "FrustumCuller.h"
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+
+using namespace tgl;
+
+//Culls random bounding spheres against a camera frustum with FrustumCuller::cull and the scalar reference, and
+//reports the throughput of both in objects per microsecond.
+//Usage: FrustumCullBenchmark [objectCount] [iterations]
+int main(int argc, char **argv) {
+    size_t objectCount = argc > 1 ? std::stoul(argv[1]) : 100000;
+    int iterations = argc > 2 ? std::stoi(argv[2]) : 200;
+
+    //Spheres scattered all around the camera, only some of them end up inside the frustum
+    FrustumCuller frustumCuller;
+    frustumCuller.reserve(objectCount);
+    std::mt19937 random(42);
+    std::uniform_real_distribution<float> position(-500, 500);
+    std::uniform_real_distribution<float> radius(0.5F, 5);
+    for (size_t i = 0; i < objectCount; i++) {
+        frustumCuller.add({position(random), position(random), position(random)}, radius(random), (uint32_t) i);
+    }
+    //Frustum looking down +z with a 90 degree fov, near 0.1 and far 1000, in the form extractPlanes returns
+    const float diagonal = 1.0F / std::sqrt(2.0F);
+    const glm::vec4 planes[6] = {
+            {diagonal,  0,         diagonal, 0},
+            {-diagonal, 0,         diagonal, 0},
+            {0,         diagonal,  diagonal, 0},
+            {0,         -diagonal, diagonal, 0},
+            {0,         0,         1,        -0.1F},
+            {0,         0,         -1,       1000}
+    };
+
+    std::vector<uint32_t> visible;
+    std::vector<uint32_t> reference;
+    visible.reserve(objectCount);
+    reference.reserve(objectCount);
+    frustumCuller.cull(planes, visible);
+    frustumCuller.cullScalar(planes, reference);
+    if (visible != reference) {
+        std::cout << "SIMD and scalar culling disagree: " << visible.size() << " vs " << reference.size()
+                  << " visible" << std::endl;
+        return 1;
+    }
+    std::cout << "Objects: " << objectCount << ", visible: " << visible.size() << ", iterations: " << iterations
+              << std::endl;
+    std::cout << std::fixed << std::setprecision(2);
+
+    double simdMicroseconds = 0;
+    double scalarMicroseconds = 0;
+    for (int i = 0; i < iterations; i++) {
+        visible.clear();
+        auto start = std::chrono::high_resolution_clock::now();
+        frustumCuller.cull(planes, visible);
+        auto end = std::chrono::high_resolution_clock::now();
+        simdMicroseconds += std::chrono::duration<double, std::micro>(end - start).count();
+
+        reference.clear();
+        start = std::chrono::high_resolution_clock::now();
+        frustumCuller.cullScalar(planes, reference);
+        end = std::chrono::high_resolution_clock::now();
+        scalarMicroseconds += std::chrono::duration<double, std::micro>(end - start).count();
+    }
+    const double objects = (double) objectCount * iterations;
+    std::cout << "SIMD (" << FrustumCuller::getInstructionSet() << "): " << objects / simdMicroseconds << " objects/us"
+              << std::endl;
+    std::cout << "Scalar: " << objects / scalarMicroseconds << " objects/us" << std::endl;
+    std::cout << "Speedup: " << scalarMicroseconds / simdMicroseconds << "x" << std::endl;
+    return 0;
+}
@@ -0,0 +1,58 @@
+#include "BenchmarkScene.h"
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+
+//Renders a grid of entities without a window, e.g. in CI or under lavapipe, and reports the average frame time. Every
+//frame is read back, the last one is checked for drawn pixels so a broken render path doesn't go unnoticed.
+//Usage: HeadlessBenchmark [modelPath] [frameCount] [entityCount] [width] [height]
+int main(int argc, char **argv) {
+    std::string modelPath = argc > 1 ? argv[1] : "../resources/models/Porsche.obj";
+    uint32_t frameCount = argc > 2 ? std::stoul(argv[2]) : 300;
+    uint32_t entityCount = argc > 3 ? std::stoul(argv[3]) : 1000;
+    uint32_t width = argc > 4 ? std::stoul(argv[4]) : 1280;
+    uint32_t height = argc > 5 ? std::stoul(argv[5]) : 720;
+    std::cout << std::fixed << std::setprecision(3);
+
+    Renderer renderer(width, height, 3);
+    renderer.window->backgroundColor = {0, 0, 0, 1};
+    renderer.init();
+    std::cout << "GPU: " << renderer.gpu.name << std::endl;
+    //Run twice to compare, the first run stores the cache the second one starts from
+    std::cout << "Pipelines created in " << renderer.getPipelineBuildMilliseconds() << " ms from a "
+              << (renderer.isPipelineCacheWarm() ? "warm" : "cold") << " pipeline cache" << std::endl;
+
+    //Pixels of the most recent frame the GPU finished that differ from the black background
+    uint32_t lastReadbackFrame = 0;
+    uint64_t drawnPixels = 0;
+    renderer.readbackCallback = [&](uint32_t frame, const uint8_t *pixels) {
+        lastReadbackFrame = frame;
+        drawnPixels = 0;
+        for (uint64_t i = 0; i < (uint64_t) width * height; i++) {
+            if (pixels[i * 4] != 0 || pixels[i * 4 + 1] != 0 || pixels[i * 4 + 2] != 0) {
+                drawnPixels++;
+            }
+        }
+    };
+
+    BenchmarkScene scene(renderer, modelPath);
+    scene.addEntityGrid(renderer, entityCount);
+    renderer.releaseMesh(scene.mesh);
+
+    scene.warmUp(renderer);
+    auto start = std::chrono::high_resolution_clock::now();
+    for (uint32_t i = 0; i < frameCount; i++) {
+        renderer.render(scene.camera, scene.light);
+    }
+    renderer.flushReadbacks();
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+    std::cout << entityCount << " entities at " << width << "x" << height << ": " << ms / std::max(frameCount, 1U)
+              << " ms per frame over " << frameCount << " frames, " << renderer.getDrawCallCount()
+              << " draw calls, " << renderer.getVisibleInstanceCount() << " instances passed GPU culling"
+              << std::endl;
+    std::cout << "Frame " << lastReadbackFrame << " has " << drawnPixels << " drawn pixels" << std::endl;
+
+    renderer.clearEntities();
+    renderer.destroy();
+    return drawnPixels > 0 ? 0 : 1;
+}
@@ -0,0 +1,33 @@
+#include "MeshLoader.h"
+#include <chrono>
+#include <filesystem>
+#include <iomanip>
+
+using namespace tgl;
+
+//Reports the vertex cache statistics of every model in a directory before and after MeshOptimizer.
+//Usage: MeshOptimizerBenchmark [modelDirectory] [overdrawThreshold]
+int main(int argc, char **argv) {
+    std::string modelDirectory = argc > 1 ? argv[1] : "../resources/models";
+    float overdrawThreshold = argc > 2 ? std::stof(argv[2]) : 1.05F;
+    MeshLoadOptions options;
+    options.useCache = false;
+    std::cout << std::fixed << std::setprecision(3);
+    std::cout << "Overdraw threshold: " << overdrawThreshold << ", FIFO cache size: "
+              << MeshOptimizer::ANALYSIS_CACHE_SIZE << std::endl;
+
+    for (const auto &entry : std::filesystem::directory_iterator(modelDirectory)) {
+        if (entry.path().extension() != ".obj") {
+            continue;
+        }
+        Mesh mesh = MeshLoader::loadObj(entry.path().string().c_str(), {1, 1, 1, 1}, options);
+        auto start = std::chrono::high_resolution_clock::now();
+        MeshOptimizationReport report = MeshOptimizer::optimize(mesh.description, overdrawThreshold);
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+        std::cout << entry.path().filename().string() << " (" << mesh.description.indices.size() / 3
+                  << " triangles, " << mesh.description.vertices.size() << " vertices) in " << ms << " ms" << std::endl;
+        std::cout << "  ACMR " << report.before.acmr << " -> " << report.after.acmr << std::endl;
+        std::cout << "  ATVR " << report.before.atvr << " -> " << report.after.atvr << std::endl;
+    }
+    return 0;
+}
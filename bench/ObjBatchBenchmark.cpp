@@ -0,0 +1,66 @@
+#include "MeshLoader.h"
+#include <chrono>
+#include <filesystem>
+#include <iomanip>
+
+using namespace tgl;
+
+//Loads every model in a directory with MeshLoader::loadObjBatch on 1 to N threads and reports the scaling.
+//Usage: ObjBatchBenchmark [modelDirectory] [iterations] [maxThreads]
+int main(int argc, char **argv) {
+    std::string modelDirectory = argc > 1 ? argv[1] : "../resources/models";
+    int iterations = argc > 2 ? std::stoi(argv[2]) : 3;
+    uint32_t maxThreads = argc > 3 ? (uint32_t) std::stoi(argv[3]) : std::thread::hardware_concurrency();
+    maxThreads = std::max<uint32_t>(maxThreads, 1);
+
+    std::vector<std::string> paths;
+    double megabytes = 0;
+    for (const auto &entry : std::filesystem::directory_iterator(modelDirectory)) {
+        if (entry.path().extension() == ".obj") {
+            paths.push_back(entry.path().string());
+            megabytes += (double) entry.file_size() / (1024.0 * 1024.0);
+        }
+    }
+    std::cout << "Models: " << paths.size() << ", iterations: " << iterations << std::endl;
+    std::cout << std::fixed << std::setprecision(2);
+
+    //Powers of two up to maxThreads, plus maxThreads itself
+    std::vector<uint32_t> threadCounts;
+    for (uint32_t threadCount = 1; threadCount < maxThreads; threadCount *= 2) {
+        threadCounts.push_back(threadCount);
+    }
+    threadCounts.push_back(maxThreads);
+
+    double singleThreadMs = 0;
+    for (uint32_t threadCount : threadCounts) {
+        ThreadPool threadPool(threadCount);
+        MeshLoadOptions options;
+        options.threadPool = &threadPool;
+        //Measure the loading, not the mesh cache
+        options.useCache = false;
+
+        size_t failed = 0;
+        auto start = std::chrono::high_resolution_clock::now();
+        for (int i = 0; i < iterations; i++) {
+            std::vector<MeshLoadResult> results = MeshLoader::loadObjBatch(paths, {{1, 1, 1, 1}}, options);
+            for (const MeshLoadResult &result : results) {
+                if (!result.success) {
+                    failed++;
+                    if (i == 0) {
+                        std::cout << "  " << result.error << std::endl;
+                    }
+                }
+            }
+        }
+        double batchMs = std::chrono::duration<double, std::milli>(
+                std::chrono::high_resolution_clock::now() - start).count() / iterations;
+        if (threadCount == 1) {
+            singleThreadMs = batchMs;
+        }
+        double speedup = singleThreadMs / batchMs;
+        std::cout << threadCount << " threads: " << batchMs << " ms, " << megabytes / (batchMs / 1000.0) << " MB/s, "
+                  << speedup << "x (" << speedup / threadCount * 100.0 << "% efficiency)"
+                  << (failed == 0 ? "" : " (FAILED LOADS!)") << std::endl;
+    }
+    return 0;
+}
@@ -0,0 +1,68 @@
+#include "MeshLoader.h"
+#include <chrono>
+#include <filesystem>
+#include <iomanip>
+
+using namespace tgl;
+
+//Compares the chunked parallel OBJ parser against the tinyobjloader path on every model in a directory.
+//Usage: ObjLoadBenchmark [modelDirectory] [iterations]
+int main(int argc, char **argv) {
+    std::string modelDirectory = argc > 1 ? argv[1] : "../resources/models";
+    int iterations = argc > 2 ? std::stoi(argv[2]) : 5;
+    ThreadPool threadPool;
+    MeshLoadOptions options;
+    options.threadPool = &threadPool;
+    //Measure the parser, not the mesh cache
+    options.useCache = false;
+    std::cout << "Threads: " << threadPool.getThreadCount() << ", iterations: " << iterations << std::endl;
+    std::cout << std::fixed << std::setprecision(2);
+
+    for (const auto &entry : std::filesystem::directory_iterator(modelDirectory)) {
+        if (entry.path().extension() != ".obj") {
+            continue;
+        }
+        const std::string path = entry.path().string();
+        const double megabytes = (double) entry.file_size() / (1024.0 * 1024.0);
+
+        Mesh reference, parallel;
+        auto start = std::chrono::high_resolution_clock::now();
+        for (int i = 0; i < iterations; i++) {
+            reference = MeshLoader::loadObjTinyObj(path.c_str(), {1, 1, 1, 1});
+        }
+        double tinyObjMs = std::chrono::duration<double, std::milli>(
+                std::chrono::high_resolution_clock::now() - start).count() / iterations;
+
+        start = std::chrono::high_resolution_clock::now();
+        for (int i = 0; i < iterations; i++) {
+            parallel = MeshLoader::loadObj(path.c_str(), {1, 1, 1, 1}, options);
+        }
+        double parallelMs = std::chrono::duration<double, std::milli>(
+                std::chrono::high_resolution_clock::now() - start).count() / iterations;
+
+        //First load writes the .tglmesh cache, the timed ones read it back
+        MeshLoadOptions cachedOptions = options;
+        cachedOptions.useCache = true;
+        Mesh cached = MeshLoader::loadObj(path.c_str(), {1, 1, 1, 1}, cachedOptions);
+        start = std::chrono::high_resolution_clock::now();
+        for (int i = 0; i < iterations; i++) {
+            cached = MeshLoader::loadObj(path.c_str(), {1, 1, 1, 1}, cachedOptions);
+        }
+        double cachedMs = std::chrono::duration<double, std::milli>(
+                std::chrono::high_resolution_clock::now() - start).count() / iterations;
+
+        bool identical = reference.description.vertices == parallel.description.vertices &&
+                         reference.description.indices == parallel.description.indices;
+        std::cout << entry.path().filename().string() << " (" << megabytes << " MB)" << std::endl;
+        std::cout << "  tinyobj:  " << tinyObjMs << " ms, " << megabytes / (tinyObjMs / 1000.0) << " MB/s" << std::endl;
+        std::cout << "  parallel: " << parallelMs << " ms, " << megabytes / (parallelMs / 1000.0) << " MB/s"
+                  << " (" << tinyObjMs / parallelMs << "x)" << std::endl;
+        std::cout << "  cached:   " << cachedMs << " ms (" << tinyObjMs / cachedMs << "x)"
+                  << (cached.description.indices == parallel.description.indices ? "" : " (MISMATCH with parser!)")
+                  << std::endl;
+        std::cout << "  vertices: " << parallel.description.vertices.size() << ", indices: "
+                  << parallel.description.indices.size() << (identical ? "" : " (MISMATCH with tinyobj!)")
+                  << std::endl;
+    }
+    return 0;
+}
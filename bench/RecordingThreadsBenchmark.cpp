@@ -0,0 +1,114 @@
+#include "Renderer.h"
+#include "Window.h"
+#include "TGL.h"
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+
+using namespace tgl;
+
+//Cube with its own color, so every mesh has different content and gets its own draw
+static Mesh createCube(glm::vec4 color) {
+    Mesh mesh;
+    MeshDescription &description = mesh.description;
+    const glm::vec3 normals[6] = {{1, 0, 0}, {-1, 0, 0}, {0, 1, 0}, {0, -1, 0}, {0, 0, 1}, {0, 0, -1}};
+    for (const glm::vec3 &normal : normals) {
+        //Two axes spanning the face
+        const glm::vec3 u = normal.x != 0 ? glm::vec3(0, 1, 0) : glm::vec3(1, 0, 0);
+        const glm::vec3 v = glm::cross(normal, u);
+        const uint32_t first = (uint32_t) description.vertices.size();
+        description.vertices.emplace_back(normal - u - v, normal, color);
+        description.vertices.emplace_back(normal + u - v, normal, color);
+        description.vertices.emplace_back(normal + u + v, normal, color);
+        description.vertices.emplace_back(normal - u + v, normal, color);
+        for (uint32_t index : {0U, 1U, 2U, 0U, 2U, 3U}) {
+            description.indices.push_back(first + index);
+        }
+    }
+    description.computeBounds();
+    return mesh;
+}
+
+//Draws one entity for each of meshCount distinct meshes, so a frame has meshCount draws, and reports the average
+//frame time for 1 to maxThreads recording threads.
+//Usage: RecordingThreadsBenchmark [meshCount] [frameCount] [maxThreads]
+int main(int argc, char **argv) {
+    uint32_t meshCount = argc > 1 ? std::stoul(argv[1]) : 20000;
+    uint32_t frameCount = argc > 2 ? std::stoul(argv[2]) : 300;
+    uint32_t maxThreads = argc > 3 ? std::stoul(argv[3]) : std::thread::hardware_concurrency();
+    maxThreads = std::max<uint32_t>(maxThreads, 1);
+    std::cout << std::fixed << std::setprecision(3);
+
+    TGL::init();
+    Window window("Recording Threads Benchmark", 1280, 720, false, {0, 0, 0, 1});
+    window.create();
+    Renderer renderer(&window, 3);
+    renderer.init();
+    //Measure one draw per mesh, GPU culling would merge them into a few indirect draws
+    renderer.gpuCulling = false;
+    renderer.cpuCulling = false;
+
+    std::vector<MeshHandle> meshes;
+    std::vector<Entity> entities;
+    entities.reserve(meshCount);
+    const uint32_t gridSize = (uint32_t) std::ceil(std::sqrt((double) meshCount));
+    for (uint32_t i = 0; i < meshCount; i++) {
+        MeshHandle mesh = renderer.addMesh(createCube({(float) i / (float) meshCount, 0.5F, 0.5F, 1}));
+        Entity entity(mesh);
+        entity.scale = {0.5, 0.5, 0.5};
+        entity.position = {(float) (i % gridSize) * 2, 1, (float) (i / gridSize) * 2 + 3};
+        renderer.uploadEntity(entity);
+        entities.push_back(entity);
+        meshes.push_back(mesh);
+    }
+    renderer.registerEntities(entities);
+    //The entities hold their own references now
+    for (MeshHandle mesh : meshes) {
+        renderer.releaseMesh(mesh);
+    }
+
+    Camera camera;
+    camera.farClipPlane = 1000;
+    camera.nearClipPlane = 0.1f;
+    camera.fov = 80;
+    camera.position = {0, 0, 0};
+    Light light{};
+    light.position = {0, -6, 0};
+
+    //Powers of two up to maxThreads, plus maxThreads itself
+    std::vector<uint32_t> threadCounts;
+    for (uint32_t threadCount = 1; threadCount < maxThreads; threadCount *= 2) {
+        threadCounts.push_back(threadCount);
+    }
+    threadCounts.push_back(maxThreads);
+
+    double singleThreadMs = 0;
+    for (uint32_t threadCount : threadCounts) {
+        renderer.setRecordingThreadCount(threadCount);
+        //Warm up so uploads and buffer growth don't end up in the average
+        for (uint32_t i = 0; i < 10 && !window.hasRequestedClose(); i++) {
+            window.updateEvents();
+            renderer.render(camera, light);
+        }
+        uint32_t renderedFrames = 0;
+        auto start = std::chrono::high_resolution_clock::now();
+        while (renderedFrames < frameCount && !window.hasRequestedClose()) {
+            window.updateEvents();
+            renderer.render(camera, light);
+            renderedFrames++;
+        }
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+        ms /= std::max(renderedFrames, 1U);
+        if (threadCount == 1) {
+            singleThreadMs = ms;
+        }
+        std::cout << threadCount << " threads: " << ms << " ms per frame, " << renderer.getDrawCallCount()
+                  << " draw calls, speedup " << singleThreadMs / ms << "x" << std::endl;
+    }
+
+    renderer.clearEntities();
+    renderer.destroy();
+    window.destroy();
+    TGL::terminate();
+    return 0;
+}
@@ -0,0 +1,100 @@
+#include "RenderQueue.h"
+#include "Renderer.h"
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+
+using namespace tgl;
+
+//Keys the renderer builds for two entities straight ahead of a turned camera, the nearer one has to sort first
+static bool isNearerFirst() {
+    Camera camera;
+    camera.position = {3, 1, -2};
+    glm::mat4 camMatrix = glm::translate(camera.position) * glm::rotate(0.5F, glm::vec3(0, 1, 0));
+    camera.data.view = glm::inverse(camMatrix);
+    camera.data.projection = glm::perspectiveLH(0.8F, 16.0F / 9.0F, camera.nearClipPlane, camera.farClipPlane);
+    glm::vec3 forward = camMatrix[2];
+    glm::vec3 nearPosition = camera.position + forward * 5.0F;
+    glm::vec3 farPosition = camera.position + forward * 50.0F;
+    //Both are in front of the camera as far as the projection is concerned
+    if ((camera.data.projection * camera.data.view * glm::vec4(nearPosition, 1)).w <= 0 ||
+        (camera.data.projection * camera.data.view * glm::vec4(farPosition, 1)).w <= 0) {
+        return false;
+    }
+    RenderQueue renderQueue;
+    renderQueue.push(RenderQueue::makeKey(DRAW_PASS_OPAQUE, 0, 0, 0, 0,
+                                          Renderer::getViewDepth(camera, farPosition) / camera.farClipPlane), 0);
+    renderQueue.push(RenderQueue::makeKey(DRAW_PASS_OPAQUE, 0, 0, 0, 0,
+                                          Renderer::getViewDepth(camera, nearPosition) / camera.farClipPlane), 1);
+    renderQueue.sort();
+    return renderQueue[0].entityIndex == 1;
+}
+
+//Sorts the packets of a random scene with RenderQueue::sort and std::stable_sort, and reports the time per sort of
+//both. Keys are built like the renderer builds them: few pipelines, meshCount meshes and random depths.
+//Usage: RenderQueueSortBenchmark [packetCount] [meshCount] [iterations]
+int main(int argc, char **argv) {
+    size_t packetCount = argc > 1 ? std::stoul(argv[1]) : 100000;
+    uint32_t meshCount = argc > 2 ? std::stoul(argv[2]) : 500;
+    int iterations = argc > 3 ? std::stoi(argv[3]) : 100;
+
+    std::mt19937 random(42);
+    std::uniform_int_distribution<uint32_t> pipeline(0, 1);
+    std::uniform_int_distribution<uint32_t> mesh(0, std::max<uint32_t>(meshCount, 1) - 1);
+    std::uniform_int_distribution<uint32_t> lod(0, 3);
+    std::uniform_real_distribution<float> depth(0, 1);
+    std::vector<DrawPacket> packets(packetCount);
+    for (size_t i = 0; i < packetCount; i++) {
+        packets[i].key = RenderQueue::makeKey(DRAW_PASS_OPAQUE, pipeline(random), 0, mesh(random), lod(random),
+                                              depth(random));
+        packets[i].entityIndex = (uint32_t) i;
+    }
+
+    RenderQueue renderQueue;
+    renderQueue.reserve(packetCount);
+    std::vector<DrawPacket> reference;
+    reference.reserve(packetCount);
+    auto byKey = [](const DrawPacket &a, const DrawPacket &b) {
+        return a.key < b.key;
+    };
+
+    double radixMicroseconds = 0;
+    double stdMicroseconds = 0;
+    for (int i = 0; i < iterations; i++) {
+        renderQueue.clear();
+        for (const DrawPacket &packet : packets) {
+            renderQueue.push(packet.key, packet.entityIndex);
+        }
+        auto start = std::chrono::high_resolution_clock::now();
+        renderQueue.sort();
+        auto end = std::chrono::high_resolution_clock::now();
+        radixMicroseconds += std::chrono::duration<double, std::micro>(end - start).count();
+
+        reference = packets;
+        start = std::chrono::high_resolution_clock::now();
+        std::stable_sort(reference.begin(), reference.end(), byKey);
+        end = std::chrono::high_resolution_clock::now();
+        stdMicroseconds += std::chrono::duration<double, std::micro>(end - start).count();
+    }
+
+    //Both sorts are stable, so they have to agree on the entity order as well
+    for (size_t i = 0; i < packetCount; i++) {
+        if (renderQueue[i].key != reference[i].key || renderQueue[i].entityIndex != reference[i].entityIndex) {
+            std::cout << "Radix sort and std::stable_sort disagree at packet " << i << std::endl;
+            return 1;
+        }
+    }
+    if (!isNearerFirst()) {
+        std::cout << "Nearer entities don't sort before farther ones" << std::endl;
+        return 1;
+    }
+    std::cout << "Packets: " << packetCount << ", meshes: " << meshCount << ", iterations: " << iterations
+              << std::endl;
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << "Radix sort: " << radixMicroseconds / iterations << " us per sort" << std::endl;
+    std::cout << "std::stable_sort: " << stdMicroseconds / iterations << " us per sort" << std::endl;
+    return 0;
+}
@@ -0,0 +1,113 @@
+#include "ObjParser.h"
+#include "VertexHashTable.h"
+#include <chrono>
+#include <filesystem>
+#include <iomanip>
+#include <iostream>
+#include <unordered_map>
+#include <unordered_set>
+
+using namespace tgl;
+
+//The std::hash<tgl::Vertex> specialization the loader used before VertexHashTable
+struct LegacyVertexHash {
+    size_t operator()(const Vertex &other) const {
+        size_t posHash = std::hash<glm::vec3>()(other.position);
+        size_t colorHash = std::hash<glm::vec4>()(other.color);
+        size_t uvHash = 1;
+        size_t normalHash = std::hash<glm::vec3>()(other.normal);
+        return ((((posHash ^ (colorHash << 1)) >> 1) ^ uvHash) << 1) ^ normalHash;
+    }
+};
+
+template<typename Map>
+static double bucketCollisionRate(const Map &map) {
+    size_t collisions = 0;
+    for (size_t bucket = 0; bucket < map.bucket_count(); bucket++) {
+        size_t bucketSize = map.bucket_size(bucket);
+        if (bucketSize > 1) {
+            collisions += bucketSize - 1;
+        }
+    }
+    return map.empty() ? 0.0 : (double) collisions / (double) map.size();
+}
+
+template<typename Hasher>
+static double hashCollisionRate(const std::vector<Vertex> &uniqueVertices) {
+    std::unordered_set<size_t> hashes;
+    for (const Vertex &vertex : uniqueVertices) {
+        hashes.insert(Hasher()(vertex));
+    }
+    return uniqueVertices.empty() ? 0.0 : 1.0 - (double) hashes.size() / (double) uniqueVertices.size();
+}
+
+template<typename Hasher>
+static double dedupUnorderedMap(const std::vector<Vertex> &corners, std::vector<Vertex> &vertices,
+                                std::vector<uint32_t> &indices, double &bucketCollisions) {
+    auto start = std::chrono::high_resolution_clock::now();
+    std::unordered_map<Vertex, uint32_t, Hasher> newVertices;
+    //Same access pattern as the original loader: count, operator[] and operator[] again
+    for (const Vertex &vertex : corners) {
+        if (newVertices.count(vertex) == 0) {
+            newVertices[vertex] = newVertices.size();
+            vertices.push_back(vertex);
+        }
+        indices.push_back(newVertices[vertex]);
+    }
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+    bucketCollisions = bucketCollisionRate(newVertices);
+    return ms;
+}
+
+//Deduplicates the corners of every model in a directory with the old and new approaches.
+//Usage: VertexDedupBenchmark [modelDirectory]
+int main(int argc, char **argv) {
+    std::string modelDirectory = argc > 1 ? argv[1] : "../resources/models";
+    std::cout << std::fixed << std::setprecision(3);
+
+    for (const auto &entry : std::filesystem::directory_iterator(modelDirectory)) {
+        if (entry.path().extension() != ".obj") {
+            continue;
+        }
+        ObjData objData;
+        std::string error;
+        if (!ObjParser::parseFile(entry.path().string().c_str(), objData, error)) {
+            std::cout << entry.path().filename().string() << ": " << error << std::endl;
+            continue;
+        }
+        std::vector<Vertex> corners;
+        corners.reserve(objData.corners.size());
+        for (const ObjCorner &corner : objData.corners) {
+            glm::vec3 normal = corner.normalIndex >= 0 ? objData.normals[corner.normalIndex] : glm::vec3(0, 0, 0);
+            corners.emplace_back(objData.positions[corner.vertexIndex], normal, glm::vec4(1, 1, 1, 1));
+        }
+
+        std::vector<Vertex> legacyVertices, mapVertices, tableVertices;
+        std::vector<uint32_t> legacyIndices, mapIndices, tableIndices;
+        double legacyBuckets, mapBuckets;
+        double legacyMs = dedupUnorderedMap<LegacyVertexHash>(corners, legacyVertices, legacyIndices, legacyBuckets);
+        double mapMs = dedupUnorderedMap<std::hash<Vertex>>(corners, mapVertices, mapIndices, mapBuckets);
+
+        auto start = std::chrono::high_resolution_clock::now();
+        VertexHashTable table(corners.size());
+        tableIndices.reserve(corners.size());
+        for (const Vertex &vertex : corners) {
+            tableIndices.push_back(table.insert(vertex, tableVertices));
+        }
+        double tableMs = std::chrono::duration<double, std::milli>(
+                std::chrono::high_resolution_clock::now() - start).count();
+
+        std::cout << entry.path().filename().string() << ": " << corners.size() << " corners, "
+                  << tableVertices.size() << " unique vertices"
+                  << (tableIndices == legacyIndices ? "" : " (MISMATCH with unordered_map!)") << std::endl;
+        std::cout << "  unordered_map + legacy hash: " << legacyMs << " ms, 64-bit hash collisions "
+                  << hashCollisionRate<LegacyVertexHash>(tableVertices) * 100.0 << "%, bucket collisions "
+                  << legacyBuckets * 100.0 << "%" << std::endl;
+        std::cout << "  unordered_map + XXH64:       " << mapMs << " ms, 64-bit hash collisions "
+                  << hashCollisionRate<std::hash<Vertex>>(tableVertices) * 100.0 << "%, bucket collisions "
+                  << mapBuckets * 100.0 << "%" << std::endl;
+        std::cout << "  VertexHashTable:             " << tableMs << " ms, average probe length "
+                  << table.getAverageProbeLength() << " (" << legacyMs / tableMs << "x)" << std::endl;
+    }
+    return 0;
+}
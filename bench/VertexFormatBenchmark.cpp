@@ -0,0 +1,85 @@
+#include "Renderer.h"
+#include "Window.h"
+#include "TGL.h"
+#include "MeshLoader.h"
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+
+using namespace tgl;
+
+//Compares the vertex buffer size of VERTEX_FORMAT_FLOAT and VERTEX_FORMAT_PACKED and the average frame time
+//of rendering a grid of entities in the chosen format.
+//Usage: VertexFormatBenchmark [float|packed] [modelPath] [entityCount] [frameCount]
+int main(int argc, char **argv) {
+    VertexFormat vertexFormat = argc > 1 && std::string(argv[1]) == "packed" ? VERTEX_FORMAT_PACKED
+                                                                              : VERTEX_FORMAT_FLOAT;
+    std::string modelPath = argc > 2 ? argv[2] : "../resources/models/Porsche.obj";
+    uint32_t entityCount = argc > 3 ? std::stoul(argv[3]) : 2;
+    uint32_t frameCount = argc > 4 ? std::stoul(argv[4]) : 1000;
+    std::cout << std::fixed << std::setprecision(3);
+
+    MeshLoadOptions floatOptions;
+    floatOptions.vertexFormat = VERTEX_FORMAT_FLOAT;
+    MeshLoadOptions packedOptions;
+    packedOptions.vertexFormat = VERTEX_FORMAT_PACKED;
+    for (const MeshLoadOptions &options : {floatOptions, packedOptions}) {
+        Mesh mesh = MeshLoader::loadObj(modelPath.c_str(), {1, 0, 0, 1}, options);
+        const MeshDescription &description = mesh.description;
+        std::cout << (options.vertexFormat == VERTEX_FORMAT_PACKED ? "Packed" : "Float") << ": "
+                  << description.getVertexStride() << " bytes per vertex, "
+                  << description.getVertexCount() * description.getVertexStride() / 1024.0 << " KB of vertices, "
+                  << description.indices.size() * sizeof(uint32_t) / 1024.0 << " KB of indices" << std::endl;
+    }
+
+    TGL::init();
+    Window window("Vertex Format Benchmark", 1280, 720, false, {0, 0, 0, 1});
+    window.create();
+    Renderer renderer(&window, 3);
+    renderer.init();
+
+    MeshLoadOptions options;
+    options.vertexFormat = vertexFormat;
+    MeshHandle mesh = renderer.addMesh(MeshLoader::loadObj(modelPath.c_str(), {1, 0, 0, 1}, options));
+    std::vector<Entity> entities;
+    const uint32_t gridSize = (uint32_t) std::ceil(std::sqrt((double) entityCount));
+    for (uint32_t i = 0; i < entityCount; i++) {
+        Entity entity;
+        entity.mesh = mesh;
+        entity.position = {(float) (i % gridSize) * 3, 1, (float) (i / gridSize) * 3 + 3};
+        renderer.uploadEntity(entity);
+        entities.push_back(entity);
+    }
+    renderer.registerEntities(entities);
+    renderer.releaseMesh(mesh);
+
+    Camera camera;
+    camera.farClipPlane = 1000;
+    camera.nearClipPlane = 0.1f;
+    camera.fov = 80;
+    camera.position = {0, 0, 0};
+    Light light{};
+    light.position = {0, -6, 0};
+
+    //Warm up so pipeline creation and first use costs don't end up in the average
+    for (uint32_t i = 0; i < 10 && !window.hasRequestedClose(); i++) {
+        window.updateEvents();
+        renderer.render(camera, light);
+    }
+    uint32_t renderedFrames = 0;
+    auto start = std::chrono::high_resolution_clock::now();
+    while (renderedFrames < frameCount && !window.hasRequestedClose()) {
+        window.updateEvents();
+        renderer.render(camera, light);
+        renderedFrames++;
+    }
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+    std::cout << (vertexFormat == VERTEX_FORMAT_PACKED ? "Packed" : "Float") << ", " << entityCount << " entities: "
+              << ms / std::max(renderedFrames, 1U) << " ms per frame over " << renderedFrames << " frames" << std::endl;
+
+    renderer.clearEntities();
+    renderer.destroy();
+    window.destroy();
+    TGL::terminate();
+    return 0;
+}
@@ -0,0 +1,142 @@
+#include "DescriptorAllocator.h"
+#include <stdexcept>
+#include <string>
+
+namespace tgl {
+    void DescriptorAllocator::init(VkDevice device, uint32_t initialSetsPerPool,
+                                   const std::vector<DescriptorPoolRatio> &ratios) {
+        vkLogicalDevice = device;
+        poolRatios = ratios;
+        setsPerPool = std::max<uint32_t>(initialSetsPerPool, 1);
+        readyPools.push_back(createPool(setsPerPool));
+    }
+
+    VkDescriptorPool DescriptorAllocator::createPool(uint32_t setCount) {
+        std::vector<VkDescriptorPoolSize> vkDescriptorPoolSizes;
+        vkDescriptorPoolSizes.reserve(poolRatios.size());
+        for (const DescriptorPoolRatio &poolRatio : poolRatios) {
+            VkDescriptorPoolSize vkDescriptorPoolSize;
+            vkDescriptorPoolSize.type = poolRatio.type;
+            vkDescriptorPoolSize.descriptorCount = std::max<uint32_t>((uint32_t) (poolRatio.ratio * (float) setCount), 1);
+            vkDescriptorPoolSizes.push_back(vkDescriptorPoolSize);
+        }
+
+        VkDescriptorPoolCreateInfo vkDescriptorPoolCreateInfo{};
+        vkDescriptorPoolCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+        vkDescriptorPoolCreateInfo.flags = 0;
+        vkDescriptorPoolCreateInfo.maxSets = setCount;
+        vkDescriptorPoolCreateInfo.poolSizeCount = vkDescriptorPoolSizes.size();
+        vkDescriptorPoolCreateInfo.pPoolSizes = vkDescriptorPoolSizes.data();
+
+        VkDescriptorPool vkDescriptorPool;
+        VK_HANDLE_ERROR(vkCreateDescriptorPool(vkLogicalDevice, &vkDescriptorPoolCreateInfo, nullptr, &vkDescriptorPool),
+                        "Failed to create a descriptor pool!");
+        return vkDescriptorPool;
+    }
+
+    VkDescriptorPool DescriptorAllocator::getPool(bool &created) {
+        created = readyPools.empty();
+        if (!created) {
+            return readyPools.back();
+        }
+        //Every pool is full, the next one is larger so long running scenes end up with few pools
+        setsPerPool = std::min(setsPerPool + setsPerPool / 2, MAX_SETS_PER_POOL);
+        readyPools.push_back(createPool(setsPerPool));
+        return readyPools.back();
+    }
+
+    void DescriptorAllocator::allocate(VkDescriptorSetLayout vkDescriptorSetLayout, VkDescriptorSet *vkDescriptorSet) {
+        allocate(vkDescriptorSetLayout, 1, vkDescriptorSet);
+    }
+
+    void DescriptorAllocator::allocate(VkDescriptorSetLayout vkDescriptorSetLayout, uint32_t count,
+                                       VkDescriptorSet *vkDescriptorSets) {
+        std::vector<VkDescriptorSetLayout> vkDescriptorSetLayouts(count, vkDescriptorSetLayout);
+        uint32_t allocated = 0;
+        while (allocated < count) {
+            bool created;
+            VkDescriptorPool vkDescriptorPool = getPool(created);
+            VkDescriptorSetAllocateInfo vkDescriptorSetAllocateInfo{};
+            vkDescriptorSetAllocateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+            vkDescriptorSetAllocateInfo.descriptorPool = vkDescriptorPool;
+            vkDescriptorSetAllocateInfo.descriptorSetCount = count - allocated;
+            vkDescriptorSetAllocateInfo.pSetLayouts = vkDescriptorSetLayouts.data() + allocated;
+            VkResult vkResult = vkAllocateDescriptorSets(vkLogicalDevice, &vkDescriptorSetAllocateInfo,
+                                                         vkDescriptorSets + allocated);
+            if (vkResult == VK_SUCCESS) {
+                return;
+            }
+            //Thrown as well as reported, with the logger compiled out ERROR doesn't stop the loop below
+            if (vkResult != VK_ERROR_OUT_OF_POOL_MEMORY && vkResult != VK_ERROR_FRAGMENTED_POOL) {
+                ERROR("Failed to allocate a descriptor set! Error code: " << vkResult);
+                throw std::runtime_error("Failed to allocate a descriptor set! Error code: " + std::to_string(vkResult));
+            }
+            //A failed bulk allocation allocates nothing. If the rest doesn't fit, fill up the pool one set at a time.
+            const uint32_t allocatedBefore = allocated;
+            while (allocated < count) {
+                vkDescriptorSetAllocateInfo.descriptorSetCount = 1;
+                vkDescriptorSetAllocateInfo.pSetLayouts = vkDescriptorSetLayouts.data() + allocated;
+                if (vkAllocateDescriptorSets(vkLogicalDevice, &vkDescriptorSetAllocateInfo,
+                                             vkDescriptorSets + allocated) != VK_SUCCESS) {
+                    break;
+                }
+                allocated++;
+            }
+            //Another new pool wouldn't fit it either, retrying would create pools until memory runs out
+            if (created && allocated == allocatedBefore) {
+                ERROR("A descriptor set needs more descriptors than the pool ratios reserve!");
+                throw std::runtime_error("A descriptor set needs more descriptors than the pool ratios reserve!");
+            }
+            readyPools.pop_back();
+            fullPools.push_back(vkDescriptorPool);
+        }
+    }
+
+    void DescriptorAllocator::reset() {
+        for (VkDescriptorPool vkDescriptorPool : fullPools) {
+            readyPools.push_back(vkDescriptorPool);
+        }
+        fullPools.clear();
+        for (VkDescriptorPool vkDescriptorPool : readyPools) {
+            vkResetDescriptorPool(vkLogicalDevice, vkDescriptorPool, 0);
+        }
+    }
+
+    void DescriptorAllocator::destroy() {
+        for (VkDescriptorPool vkDescriptorPool : readyPools) {
+            vkDestroyDescriptorPool(vkLogicalDevice, vkDescriptorPool, nullptr);
+        }
+        for (VkDescriptorPool vkDescriptorPool : fullPools) {
+            vkDestroyDescriptorPool(vkLogicalDevice, vkDescriptorPool, nullptr);
+        }
+        readyPools.clear();
+        fullPools.clear();
+    }
+
+    void DescriptorWriter::writeBuffer(VkDescriptorSet vkDescriptorSet, uint32_t binding, VkDescriptorType type,
+                                       VkBuffer vkBuffer, VkDeviceSize offset, VkDeviceSize range) {
+        VkDescriptorBufferInfo vkDescriptorBufferInfo;
+        vkDescriptorBufferInfo.buffer = vkBuffer;
+        vkDescriptorBufferInfo.offset = offset;
+        vkDescriptorBufferInfo.range = range;
+        bufferInfos.push_back(vkDescriptorBufferInfo);
+
+        VkWriteDescriptorSet vkWriteDescriptorSet{};
+        vkWriteDescriptorSet.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        vkWriteDescriptorSet.dstSet = vkDescriptorSet;
+        vkWriteDescriptorSet.dstBinding = binding;
+        vkWriteDescriptorSet.dstArrayElement = 0;
+        vkWriteDescriptorSet.descriptorCount = 1;
+        vkWriteDescriptorSet.descriptorType = type;
+        vkWriteDescriptorSet.pBufferInfo = &bufferInfos.back();
+        writes.push_back(vkWriteDescriptorSet);
+    }
+
+    void DescriptorWriter::update(VkDevice vkLogicalDevice) {
+        if (!writes.empty()) {
+            vkUpdateDescriptorSets(vkLogicalDevice, (uint32_t) writes.size(), writes.data(), 0, nullptr);
+        }
+        writes.clear();
+        bufferInfos.clear();
+    }
+}
@@ -2,12 +2,12 @@
 
 namespace tgl {
 
-    Entity::Entity(const Mesh &mesh) {
+    Entity::Entity(MeshHandle mesh) {
         this->mesh = mesh;
         this->scale = {1, 1, 1};
     }
 
-    Entity::Entity(const Mesh &mesh, glm::vec3 position, float pitch, float yaw, glm::vec3 scale) {
+    Entity::Entity(MeshHandle mesh, glm::vec3 position, float pitch, float yaw, glm::vec3 scale) {
         this->mesh = mesh;
         this->position = position;
         this->pitch = pitch;
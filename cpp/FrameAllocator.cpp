@@ -0,0 +1,104 @@
+#include "FrameAllocator.h"
+#include "VkUtils.h"
+#include <cstring>
+
+namespace tgl {
+    void FrameAllocator::createBuffer(VkDeviceSize size) {
+        capacity = size;
+        VkUtils::createBuffer(allocator, buffer.allocation, buffer.vkBuffer, capacity, usage);
+        //Stays mapped for the allocator's lifetime. CPU_TO_GPU memory isn't guaranteed to be host coherent, see flush.
+        vmaMapMemory(allocator, buffer.allocation, (void **) &mappedData);
+    }
+
+    void FrameAllocator::destroyBuffer() {
+        if (mappedData != nullptr) {
+            vmaUnmapMemory(allocator, buffer.allocation);
+            vmaDestroyBuffer(allocator, buffer.vkBuffer, buffer.allocation);
+            mappedData = nullptr;
+        }
+    }
+
+    void FrameAllocator::init(VmaAllocator vmaAllocator, VkBufferUsageFlags bufferUsage, VkDeviceSize size,
+                              VkDeviceSize bufferAlignment) {
+        allocator = vmaAllocator;
+        usage = bufferUsage;
+        alignment = std::max<VkDeviceSize>(bufferAlignment, 1);
+        offset = 0;
+        createBuffer(size);
+    }
+
+    void FrameAllocator::reserve(VkDeviceSize size, uint32_t allocationCount) {
+        //Every allocation may start with up to alignment - 1 bytes of padding
+        const VkDeviceSize required = offset + size + allocationCount * (alignment - 1);
+        if (required <= capacity) {
+            return;
+        }
+        VkDeviceSize newCapacity = std::max<VkDeviceSize>(capacity, 1);
+        while (newCapacity < required) {
+            newCapacity *= 2;
+        }
+        INFO("Growing a frame allocator from " << capacity << " to " << newCapacity << " bytes");
+        AllocatedBuffer oldBuffer = buffer;
+        char* oldMappedData = mappedData;
+        createBuffer(newCapacity);
+        memcpy(mappedData, oldMappedData, offset);
+        vmaUnmapMemory(allocator, oldBuffer.allocation);
+        vmaDestroyBuffer(allocator, oldBuffer.vkBuffer, oldBuffer.allocation);
+    }
+
+    VkDeviceSize FrameAllocator::allocate(VkDeviceSize size) {
+        const VkDeviceSize alignedOffset = (offset + alignment - 1) & ~(alignment - 1);
+        if (alignedOffset + size > capacity) {
+            return INVALID_OFFSET;
+        }
+        offset = alignedOffset + size;
+        return alignedOffset;
+    }
+
+    VkDeviceSize FrameAllocator::push(const void *data, VkDeviceSize size) {
+        VkDeviceSize allocationOffset = allocate(size);
+        if (allocationOffset != INVALID_OFFSET) {
+            memcpy(mappedData + allocationOffset, data, size);
+        }
+        return allocationOffset;
+    }
+
+    void *FrameAllocator::getMappedData(VkDeviceSize allocationOffset) const {
+        return mappedData + allocationOffset;
+    }
+
+    void FrameAllocator::flush() {
+        if (offset > 0) {
+            //VMA rounds the range to nonCoherentAtomSize
+            vmaFlushAllocation(allocator, buffer.allocation, 0, offset);
+        }
+    }
+
+    void FrameAllocator::invalidate(VkDeviceSize allocationOffset, VkDeviceSize size) {
+        if (size > 0) {
+            vmaInvalidateAllocation(allocator, buffer.allocation, allocationOffset, size);
+        }
+    }
+
+    void FrameAllocator::reset() {
+        offset = 0;
+    }
+
+    VkBuffer FrameAllocator::getBuffer() const {
+        return buffer.vkBuffer;
+    }
+
+    VkDeviceSize FrameAllocator::getCapacity() const {
+        return capacity;
+    }
+
+    VkDeviceSize FrameAllocator::getUsedBytes() const {
+        return offset;
+    }
+
+    void FrameAllocator::destroy() {
+        destroyBuffer();
+        capacity = 0;
+        offset = 0;
+    }
+}
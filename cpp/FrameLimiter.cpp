@@ -0,0 +1,22 @@
+#include "FrameLimiter.h"
+#include <algorithm>
+#include <thread>
+
+namespace tgl {
+    void FrameLimiter::wait(float framesPerSecond) {
+        using Clock = std::chrono::steady_clock;
+        const Clock::time_point now = Clock::now();
+        if (framesPerSecond <= 0) {
+            deadline = now;
+            return;
+        }
+        const auto period = std::chrono::duration_cast<Clock::duration>(
+                std::chrono::duration<double>(1.0 / framesPerSecond));
+        deadline = std::max(deadline + period, now);
+        if (deadline - now > SPIN_TIME) {
+            std::this_thread::sleep_for(deadline - now - SPIN_TIME);
+        }
+        while (Clock::now() < deadline) {
+        }
+    }
+}
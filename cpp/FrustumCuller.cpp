@@ -0,0 +1,192 @@
+#include "FrustumCuller.h"
+#if defined(__SSE2__) || defined(_M_X64)
+#include <immintrin.h>
+#define TGL_CULL_SSE
+#if defined(__GNUC__) || defined(__clang__)
+//Compiled for AVX regardless of the build flags and only called if the CPU supports it
+#define TGL_CULL_AVX
+#define TGL_CULL_AVX_TARGET __attribute__((target("avx")))
+#elif defined(__AVX__)
+//MSVC can't target single functions, /arch:AVX enables the path for the whole binary
+#define TGL_CULL_AVX
+#define TGL_CULL_AVX_TARGET
+#endif
+#endif
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace tgl {
+    void FrustumCuller::extractPlanes(const glm::mat4 &viewProjection, glm::vec4 *planes) {
+        //Rows of the matrix, glm stores columns
+        const glm::mat4 rows = glm::transpose(viewProjection);
+        planes[0] = rows[3] + rows[0];
+        planes[1] = rows[3] - rows[0];
+        planes[2] = rows[3] + rows[1];
+        planes[3] = rows[3] - rows[1];
+        planes[4] = rows[2];
+        planes[5] = rows[3] - rows[2];
+        for (int i = 0; i < 6; i++) {
+            planes[i] /= glm::length(glm::vec3(planes[i]));
+        }
+    }
+
+    void FrustumCuller::clear() {
+        centerX.clear();
+        centerY.clear();
+        centerZ.clear();
+        radius.clear();
+        ids.clear();
+    }
+
+    void FrustumCuller::reserve(size_t count) {
+        centerX.reserve(count);
+        centerY.reserve(count);
+        centerZ.reserve(count);
+        radius.reserve(count);
+        ids.reserve(count);
+    }
+
+    void FrustumCuller::add(glm::vec3 center, float sphereRadius, uint32_t id) {
+        centerX.push_back(center.x);
+        centerY.push_back(center.y);
+        centerZ.push_back(center.z);
+        radius.push_back(sphereRadius);
+        ids.push_back(id);
+    }
+
+    size_t FrustumCuller::size() const {
+        return ids.size();
+    }
+
+    void FrustumCuller::cullScalar(const glm::vec4 *planes, size_t first, std::vector<uint32_t> &visible) const {
+        for (size_t i = first; i < ids.size(); i++) {
+            bool inside = true;
+            for (int plane = 0; plane < 6 && inside; plane++) {
+                const float distance = planes[plane].x * centerX[i] + planes[plane].y * centerY[i] +
+                                       planes[plane].z * centerZ[i] + planes[plane].w;
+                inside = distance >= -radius[i];
+            }
+            if (inside) {
+                visible.push_back(ids[i]);
+            }
+        }
+    }
+
+    void FrustumCuller::cullScalar(const glm::vec4 *planes, std::vector<uint32_t> &visible) const {
+        cullScalar(planes, 0, visible);
+    }
+
+#ifdef TGL_CULL_SSE
+    //Index of the lowest set bit, mask must not be 0
+    static inline uint32_t lowestSetBit(uint32_t mask) {
+#ifdef _MSC_VER
+        unsigned long index;
+        _BitScanForward(&index, mask);
+        return (uint32_t) index;
+#else
+        return (uint32_t) __builtin_ctz(mask);
+#endif
+    }
+
+    //Tests 4 spheres per iteration, returns the first sphere left for the scalar path
+    static size_t cullSse(const float *centerX, const float *centerY, const float *centerZ, const float *radius,
+                          const uint32_t *ids, size_t size, const glm::vec4 *planes, std::vector<uint32_t> &visible) {
+        const size_t count = size & ~(size_t) 3;
+        for (size_t i = 0; i < count; i += 4) {
+            const __m128 x = _mm_loadu_ps(centerX + i);
+            const __m128 y = _mm_loadu_ps(centerY + i);
+            const __m128 z = _mm_loadu_ps(centerZ + i);
+            const __m128 negativeRadius = _mm_sub_ps(_mm_setzero_ps(), _mm_loadu_ps(radius + i));
+            __m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+            for (int plane = 0; plane < 6; plane++) {
+                //Same order of operations as cullScalar, so both agree on spheres touching a plane
+                __m128 distance = _mm_mul_ps(x, _mm_set1_ps(planes[plane].x));
+                distance = _mm_add_ps(distance, _mm_mul_ps(y, _mm_set1_ps(planes[plane].y)));
+                distance = _mm_add_ps(distance, _mm_mul_ps(z, _mm_set1_ps(planes[plane].z)));
+                distance = _mm_add_ps(distance, _mm_set1_ps(planes[plane].w));
+                inside = _mm_and_ps(inside, _mm_cmpge_ps(distance, negativeRadius));
+            }
+            //One bit per sphere, lowest bit first keeps the visible list in order
+            uint32_t mask = (uint32_t) _mm_movemask_ps(inside);
+            while (mask != 0) {
+                visible.push_back(ids[i + lowestSetBit(mask)]);
+                mask &= mask - 1;
+            }
+        }
+        return count;
+    }
+#endif
+
+#ifdef TGL_CULL_AVX
+    //Same as cullSse with 8 spheres per iteration
+    TGL_CULL_AVX_TARGET
+    static size_t cullAvx(const float *centerX, const float *centerY, const float *centerZ, const float *radius,
+                          const uint32_t *ids, size_t size, const glm::vec4 *planes, std::vector<uint32_t> &visible) {
+        const size_t count = size & ~(size_t) 7;
+        for (size_t i = 0; i < count; i += 8) {
+            const __m256 x = _mm256_loadu_ps(centerX + i);
+            const __m256 y = _mm256_loadu_ps(centerY + i);
+            const __m256 z = _mm256_loadu_ps(centerZ + i);
+            const __m256 negativeRadius = _mm256_sub_ps(_mm256_setzero_ps(), _mm256_loadu_ps(radius + i));
+            __m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+            for (int plane = 0; plane < 6; plane++) {
+                __m256 distance = _mm256_mul_ps(x, _mm256_set1_ps(planes[plane].x));
+                distance = _mm256_add_ps(distance, _mm256_mul_ps(y, _mm256_set1_ps(planes[plane].y)));
+                distance = _mm256_add_ps(distance, _mm256_mul_ps(z, _mm256_set1_ps(planes[plane].z)));
+                distance = _mm256_add_ps(distance, _mm256_set1_ps(planes[plane].w));
+                inside = _mm256_and_ps(inside, _mm256_cmp_ps(distance, negativeRadius, _CMP_GE_OQ));
+            }
+            uint32_t mask = (uint32_t) _mm256_movemask_ps(inside);
+            while (mask != 0) {
+                visible.push_back(ids[i + lowestSetBit(mask)]);
+                mask &= mask - 1;
+            }
+        }
+        //Keeps the upper halves of the registers from slowing down SSE code that follows
+        _mm256_zeroupper();
+        return count;
+    }
+
+    static bool isAvxSupported() {
+#if defined(__GNUC__) || defined(__clang__)
+        //Also checks that the OS saves the AVX registers
+        static const bool supported = __builtin_cpu_supports("avx");
+        return supported;
+#else
+        return true;
+#endif
+    }
+#endif
+
+    const char *FrustumCuller::getInstructionSet() {
+#ifdef TGL_CULL_AVX
+        if (isAvxSupported()) {
+            return "AVX";
+        }
+#endif
+#ifdef TGL_CULL_SSE
+        return "SSE";
+#else
+        return "scalar";
+#endif
+    }
+
+    void FrustumCuller::cull(const glm::vec4 *planes, std::vector<uint32_t> &visible) const {
+        size_t i = 0;
+#ifdef TGL_CULL_AVX
+        if (isAvxSupported()) {
+            i = cullAvx(centerX.data(), centerY.data(), centerZ.data(), radius.data(), ids.data(), ids.size(), planes,
+                        visible);
+        } else {
+            i = cullSse(centerX.data(), centerY.data(), centerZ.data(), radius.data(), ids.data(), ids.size(), planes,
+                        visible);
+        }
+#elif defined(TGL_CULL_SSE)
+        i = cullSse(centerX.data(), centerY.data(), centerZ.data(), radius.data(), ids.data(), ids.size(), planes,
+                    visible);
+#endif
+        //The spheres that don't fill a whole register, or all of them without SIMD
+        cullScalar(planes, i, visible);
+    }
+}
@@ -0,0 +1,130 @@
+#include "GeometryArena.h"
+#include "VkUtils.h"
+
+namespace tgl {
+    void GeometryArena::init(VmaAllocator vmaAllocator, VkBufferUsageFlags bufferUsage, uint32_t size,
+                             VkDeviceSize blockBytes) {
+        allocator = vmaAllocator;
+        //Filled through staging copies
+        usage = bufferUsage | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+        elementSize = size;
+        blockCapacity = (uint32_t) std::min<VkDeviceSize>(blockBytes / elementSize, UINT32_MAX);
+    }
+
+    uint32_t GeometryArena::createBlock(uint32_t capacity) {
+        Block block;
+        block.capacity = capacity;
+        block.freeRanges.emplace(0, capacity);
+        VkUtils::createBuffer(allocator, block.buffer.allocation, block.buffer.vkBuffer,
+                              (VkDeviceSize) capacity * elementSize, usage, VMA_MEMORY_USAGE_GPU_ONLY);
+        blocks.push_back(std::move(block));
+        INFO("Created a geometry arena block of " << (VkDeviceSize) capacity * elementSize << " bytes");
+        return (uint32_t) blocks.size() - 1;
+    }
+
+    bool GeometryArena::allocateFromBlock(uint32_t blockIndex, uint32_t count, GeometryAllocation &allocation) {
+        Block &block = blocks[blockIndex];
+        if (block.capacity - block.used < count) {
+            return false;
+        }
+        //Best fit, the smallest range that holds the allocation leaves the large ranges for large meshes
+        auto bestRange = block.freeRanges.end();
+        for (auto it = block.freeRanges.begin(); it != block.freeRanges.end(); ++it) {
+            if (it->second >= count && (bestRange == block.freeRanges.end() || it->second < bestRange->second)) {
+                bestRange = it;
+                if (it->second == count) {
+                    break;
+                }
+            }
+        }
+        if (bestRange == block.freeRanges.end()) {
+            return false;
+        }
+        const uint32_t offset = bestRange->first;
+        const uint32_t remaining = bestRange->second - count;
+        block.freeRanges.erase(bestRange);
+        if (remaining > 0) {
+            block.freeRanges.emplace(offset + count, remaining);
+        }
+        block.used += count;
+        block.allocationCount++;
+        allocation.block = blockIndex;
+        allocation.offset = offset;
+        allocation.count = count;
+        return true;
+    }
+
+    GeometryAllocation GeometryArena::allocate(uint32_t count) {
+        GeometryAllocation allocation;
+        if (count == 0) {
+            return allocation;
+        }
+        for (uint32_t i = 0; i < blocks.size(); i++) {
+            if (allocateFromBlock(i, count, allocation)) {
+                return allocation;
+            }
+        }
+        allocateFromBlock(createBlock(std::max(count, blockCapacity)), count, allocation);
+        return allocation;
+    }
+
+    void GeometryArena::free(const GeometryAllocation &allocation) {
+        if (!allocation.isValid()) {
+            return;
+        }
+        Block &block = blocks[allocation.block];
+        uint32_t offset = allocation.offset;
+        uint32_t count = allocation.count;
+        //Merge with the free neighbours so the range can be reused by larger meshes
+        auto next = block.freeRanges.lower_bound(offset);
+        if (next != block.freeRanges.end() && next->first == offset + count) {
+            count += next->second;
+            next = block.freeRanges.erase(next);
+        }
+        if (next != block.freeRanges.begin()) {
+            auto previous = std::prev(next);
+            if (previous->first + previous->second == offset) {
+                offset = previous->first;
+                count += previous->second;
+                block.freeRanges.erase(previous);
+            }
+        }
+        block.freeRanges.emplace(offset, count);
+        block.used -= allocation.count;
+        block.allocationCount--;
+    }
+
+    VkBuffer GeometryArena::getBuffer(uint32_t block) const {
+        return blocks[block].buffer.vkBuffer;
+    }
+
+    uint32_t GeometryArena::getElementSize() const {
+        return elementSize;
+    }
+
+    GeometryArenaStats GeometryArena::getStats() const {
+        GeometryArenaStats stats;
+        stats.blockCount = (uint32_t) blocks.size();
+        for (const Block &block : blocks) {
+            stats.capacity += block.capacity;
+            stats.used += block.used;
+            stats.allocationCount += block.allocationCount;
+            stats.freeRangeCount += (uint32_t) block.freeRanges.size();
+            for (const auto &freeRange : block.freeRanges) {
+                stats.largestFreeRange = std::max<uint64_t>(stats.largestFreeRange, freeRange.second);
+            }
+        }
+        const uint64_t freeElements = stats.capacity - stats.used;
+        if (freeElements > 0) {
+            stats.fragmentation = 1.0F - (float) ((double) stats.largestFreeRange / (double) freeElements);
+        }
+        return stats;
+    }
+
+    void GeometryArena::destroy() {
+        for (Block &block : blocks) {
+            vmaDestroyBuffer(allocator, block.buffer.vkBuffer, block.buffer.allocation);
+        }
+        blocks.clear();
+    }
+}
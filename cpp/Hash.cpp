@@ -0,0 +1,89 @@
+#include "Hash.h"
+#include <cstring>
+
+namespace tgl {
+    static const uint64_t PRIME64_1 = 0x9E3779B185EBCA87ULL;
+    static const uint64_t PRIME64_2 = 0xC2B2AE3D27D4EB4FULL;
+    static const uint64_t PRIME64_3 = 0x165667B19E3779F9ULL;
+    static const uint64_t PRIME64_4 = 0x85EBCA77C2B2AE63ULL;
+    static const uint64_t PRIME64_5 = 0x27D4EB2F165667C5ULL;
+
+    static inline uint64_t rotateLeft(uint64_t value, int amount) {
+        return (value << amount) | (value >> (64 - amount));
+    }
+
+    static inline uint64_t read64(const uint8_t* p) {
+        uint64_t value;
+        memcpy(&value, p, sizeof(value));
+        return value;
+    }
+
+    static inline uint32_t read32(const uint8_t* p) {
+        uint32_t value;
+        memcpy(&value, p, sizeof(value));
+        return value;
+    }
+
+    static inline uint64_t accumulate(uint64_t accumulator, uint64_t input) {
+        accumulator += input * PRIME64_2;
+        accumulator = rotateLeft(accumulator, 31);
+        return accumulator * PRIME64_1;
+    }
+
+    static inline uint64_t mergeRound(uint64_t accumulator, uint64_t value) {
+        accumulator ^= accumulate(0, value);
+        return accumulator * PRIME64_1 + PRIME64_4;
+    }
+
+    uint64_t Hash::hash64(const void* data, size_t size, uint64_t seed) {
+        const uint8_t* p = (const uint8_t*) data;
+        const uint8_t* end = p + size;
+        uint64_t hash;
+
+        if (size >= 32) {
+            //Four independent lanes so the multiplies can overlap
+            uint64_t v1 = seed + PRIME64_1 + PRIME64_2;
+            uint64_t v2 = seed + PRIME64_2;
+            uint64_t v3 = seed;
+            uint64_t v4 = seed - PRIME64_1;
+            const uint8_t* limit = end - 32;
+            do {
+                v1 = accumulate(v1, read64(p));
+                v2 = accumulate(v2, read64(p + 8));
+                v3 = accumulate(v3, read64(p + 16));
+                v4 = accumulate(v4, read64(p + 24));
+                p += 32;
+            } while (p <= limit);
+            hash = rotateLeft(v1, 1) + rotateLeft(v2, 7) + rotateLeft(v3, 12) + rotateLeft(v4, 18);
+            hash = mergeRound(hash, v1);
+            hash = mergeRound(hash, v2);
+            hash = mergeRound(hash, v3);
+            hash = mergeRound(hash, v4);
+        } else {
+            hash = seed + PRIME64_5;
+        }
+        hash += (uint64_t) size;
+
+        for (; p + 8 <= end; p += 8) {
+            hash ^= accumulate(0, read64(p));
+            hash = rotateLeft(hash, 27) * PRIME64_1 + PRIME64_4;
+        }
+        if (p + 4 <= end) {
+            hash ^= (uint64_t) read32(p) * PRIME64_1;
+            hash = rotateLeft(hash, 23) * PRIME64_2 + PRIME64_3;
+            p += 4;
+        }
+        for (; p < end; p++) {
+            hash ^= (*p) * PRIME64_5;
+            hash = rotateLeft(hash, 11) * PRIME64_1;
+        }
+
+        //Avalanche
+        hash ^= hash >> 33;
+        hash *= PRIME64_2;
+        hash ^= hash >> 29;
+        hash *= PRIME64_3;
+        hash ^= hash >> 32;
+        return hash;
+    }
+}
@@ -1,33 +1,50 @@
 #include "Mesh.h"
+#include <algorithm>
 namespace tgl {
-    bool MeshDescription::operator==(const MeshDescription& other) const {
-        if (vertices.size() != other.vertices.size()) {
-            return false;
+    void MeshDescription::computeBounds() {
+        if (vertices.empty()) {
+            boundsMin = boundsMax = {0, 0, 0};
+            return;
         }
-        if (indices.size() != other.indices.size()) {
-            return false;
+        boundsMin = boundsMax = vertices[0].position;
+        for (const Vertex &vertex : vertices) {
+            boundsMin = glm::min(boundsMin, vertex.position);
+            boundsMax = glm::max(boundsMax, vertex.position);
         }
+    }
 
-        for (int i = 0; i < vertices.size(); i++) {
-            Vertex localVertex = vertices[i];
-            Vertex oppVertex = other.vertices[i];
-            if (localVertex != oppVertex) {
-                return false;
-            }
+    void MeshDescription::packVertices() {
+        packedVertices.resize(vertices.size());
+        for (size_t i = 0; i < vertices.size(); i++) {
+            packedVertices[i] = PackedVertex::pack(vertices[i], boundsMin, boundsMax);
         }
+        //The GPU only needs the packed copy
+        vertices.clear();
+        vertices.shrink_to_fit();
+        vertexFormat = VERTEX_FORMAT_PACKED;
+    }
 
-        for (int i = 0; i < indices.size(); i++) {
-            int localIndex = indices[i];
-            int oppIndex = other.indices[i];
-            if (localIndex != oppIndex) {
-                return false;
-            }
-        }
-        return true;
+    const void *MeshDescription::getVertexData() const {
+        return vertexFormat == VERTEX_FORMAT_PACKED ? (const void *) packedVertices.data()
+                                                    : (const void *) vertices.data();
+    }
+
+    size_t MeshDescription::getVertexCount() const {
+        return vertexFormat == VERTEX_FORMAT_PACKED ? packedVertices.size() : vertices.size();
     }
 
-    bool MeshDescription::operator<(const MeshDescription &other) const {
-        return true;
+    size_t MeshDescription::getVertexStride() const {
+        return vertexFormat == VERTEX_FORMAT_PACKED ? sizeof(PackedVertex) : sizeof(Vertex);
     }
 
+    uint32_t MeshDescription::getLodCount() const {
+        return lods.empty() ? 1 : (uint32_t) lods.size();
+    }
+
+    MeshLod MeshDescription::getLod(uint32_t level) const {
+        if (lods.empty()) {
+            return {0, (uint32_t) indices.size(), 0.0F};
+        }
+        return lods[std::min(level, (uint32_t) lods.size() - 1)];
+    }
 }
\ No newline at end of file
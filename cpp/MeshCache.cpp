@@ -0,0 +1,254 @@
+#include "MeshCache.h"
+#include "Hash.h"
+#include "VkUtils.h"
+#include <cstddef>
+#include <cstring>
+#include <cstdio>
+#include <fstream>
+#include <thread>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+namespace tgl {
+    static const char MESH_CACHE_MAGIC[8] = {'T', 'G', 'L', 'M', 'E', 'S', 'H', '\0'};
+
+    static uint64_t alignUp(uint64_t value, uint64_t alignment) {
+        return (value + alignment - 1) / alignment * alignment;
+    }
+
+    static uint64_t hashSourcePath(const char* sourcePath) {
+        std::error_code errorCode;
+        std::string absolutePath = std::filesystem::absolute(sourcePath, errorCode).lexically_normal().string();
+        if (errorCode) {
+            absolutePath = sourcePath;
+        }
+        return Hash::hash64(absolutePath.data(), absolutePath.size());
+    }
+
+    static bool statSource(const char* sourcePath, int64_t& modifiedTime, uint64_t& size) {
+        struct stat sourceStat{};
+        if (stat(sourcePath, &sourceStat) != 0) {
+            return false;
+        }
+        modifiedTime = (int64_t) sourceStat.st_mtim.tv_sec * 1000000000LL + sourceStat.st_mtim.tv_nsec;
+        size = (uint64_t) sourceStat.st_size;
+        return true;
+    }
+
+    static bool hashSourceContent(const char* sourcePath, uint64_t& contentHash) {
+        std::ifstream file(sourcePath, std::ios::binary | std::ios::ate);
+        if (!file) {
+            return false;
+        }
+        size_t fileSize = (size_t) file.tellg();
+        std::vector<char> data(fileSize);
+        file.seekg(0);
+        file.read(data.data(), fileSize);
+        if (!file) {
+            return false;
+        }
+        contentHash = Hash::hash64(data.data(), data.size());
+        return true;
+    }
+
+    static uint64_t hashPayload(const uint8_t* vertices, uint64_t vertexBytes, const uint8_t* indices,
+                                uint64_t indexBytes, const uint8_t* lods, uint64_t lodBytes) {
+        return Hash::hash64(lods, lodBytes, Hash::hash64(indices, indexBytes, Hash::hash64(vertices, vertexBytes)));
+    }
+
+    static uint64_t hashKey(const MeshCacheKey& key) {
+        uint64_t hash = Hash::hash64(&key.color[0], sizeof(float) * 4);
+        hash = Hash::hash64(&key.flags, sizeof(key.flags), hash);
+        hash = Hash::hash64(&key.overdrawThreshold, sizeof(key.overdrawThreshold), hash);
+        return Hash::hash64(&key.lodSettingsHash, sizeof(key.lodSettingsHash), hash);
+    }
+
+    //Records the source's new modification time in place, the rest of the cache stays valid
+    static void updateSourceModifiedTime(const std::string& cachePath, int64_t sourceModifiedTime) {
+        int fd = open(cachePath.c_str(), O_WRONLY);
+        if (fd < 0) {
+            return;
+        }
+        if (pwrite(fd, &sourceModifiedTime, sizeof(sourceModifiedTime),
+                   offsetof(MeshCacheHeader, sourceModifiedTime)) != (ssize_t) sizeof(sourceModifiedTime)) {
+            WARN("Failed to update the mesh cache " << cachePath);
+        }
+        close(fd);
+    }
+
+    std::string MeshCache::getCachePath(const char* sourcePath, const MeshCacheKey& key) {
+        char keyHash[17];
+        snprintf(keyHash, sizeof(keyHash), "%016llx", (unsigned long long) hashKey(key));
+        return std::string(sourcePath) + "." + keyHash + ".tglmesh";
+    }
+
+    bool MeshCache::load(const char* sourcePath, const MeshCacheKey& key, MeshDescription& description) {
+        int64_t sourceModifiedTime;
+        uint64_t sourceSize;
+        if (!statSource(sourcePath, sourceModifiedTime, sourceSize)) {
+            return false;
+        }
+
+        std::string cachePath = getCachePath(sourcePath, key);
+        int fd = open(cachePath.c_str(), O_RDONLY);
+        if (fd < 0) {
+            return false;
+        }
+        struct stat cacheStat{};
+        if (fstat(fd, &cacheStat) != 0 || (uint64_t) cacheStat.st_size < sizeof(MeshCacheHeader)) {
+            close(fd);
+            return false;
+        }
+        const uint64_t cacheSize = (uint64_t) cacheStat.st_size;
+        void* mapping = mmap(nullptr, cacheSize, PROT_READ, MAP_PRIVATE, fd, 0);
+        //The mapping stays valid after the descriptor is closed
+        close(fd);
+        if (mapping == MAP_FAILED) {
+            return false;
+        }
+        const uint8_t* bytes = (const uint8_t*) mapping;
+        MeshCacheHeader header{};
+        memcpy(&header, bytes, sizeof(header));
+        const bool packed = (key.flags & MESH_CACHE_FLAG_PACKED_VERTICES) != 0;
+        const uint64_t vertexStride = packed ? sizeof(PackedVertex) : sizeof(Vertex);
+
+        bool valid = memcmp(header.magic, MESH_CACHE_MAGIC, sizeof(MESH_CACHE_MAGIC)) == 0 &&
+                     header.version == VERSION &&
+                     header.headerSize == sizeof(MeshCacheHeader) &&
+                     header.sourcePathHash == hashSourcePath(sourcePath) &&
+                     header.sourceSize == sourceSize &&
+                     memcmp(header.color, &key.color[0], sizeof(header.color)) == 0 &&
+                     header.flags == key.flags &&
+                     header.overdrawThreshold == key.overdrawThreshold &&
+                     header.lodSettingsHash == key.lodSettingsHash &&
+                     header.vertexStride == vertexStride &&
+                     header.indexStride == sizeof(uint32_t);
+
+        const uint64_t vertexBytes = header.vertexCount * vertexStride;
+        const uint64_t indexBytes = header.indexCount * sizeof(uint32_t);
+        const uint64_t lodBytes = header.lodCount * sizeof(MeshLod);
+        //Guard against truncated files and counts that would overflow the size computations
+        valid = valid && header.vertexCount <= cacheSize / vertexStride &&
+                header.indexCount <= cacheSize / sizeof(uint32_t) && header.lodCount <= cacheSize / sizeof(MeshLod) &&
+                header.lodOffset % MESH_CACHE_ALIGNMENT == 0 &&
+                header.vertexOffset % MESH_CACHE_ALIGNMENT == 0 && header.indexOffset % MESH_CACHE_ALIGNMENT == 0 &&
+                header.vertexOffset >= sizeof(MeshCacheHeader) && header.vertexOffset <= cacheSize &&
+                vertexBytes <= cacheSize - header.vertexOffset &&
+                header.indexOffset >= header.vertexOffset + vertexBytes && header.indexOffset <= cacheSize &&
+                indexBytes <= cacheSize - header.indexOffset &&
+                header.lodOffset >= header.indexOffset + indexBytes && header.lodOffset <= cacheSize &&
+                lodBytes <= cacheSize - header.lodOffset;
+
+        //A touched but unchanged source keeps its cache, anything else has to match the recorded content hash
+        const bool sourceTouched = valid && header.sourceModifiedTime != sourceModifiedTime;
+        if (sourceTouched) {
+            uint64_t contentHash;
+            valid = hashSourceContent(sourcePath, contentHash) && contentHash == header.sourceContentHash;
+        }
+
+        valid = valid && hashPayload(bytes + header.vertexOffset, vertexBytes, bytes + header.indexOffset, indexBytes,
+                                     bytes + header.lodOffset, lodBytes) == header.payloadHash;
+
+        //Level of detail ranges have to stay inside the index buffer
+        for (uint64_t i = 0; valid && i < header.lodCount; i++) {
+            MeshLod lod{};
+            memcpy(&lod, bytes + header.lodOffset + i * sizeof(MeshLod), sizeof(MeshLod));
+            valid = (uint64_t) lod.indexOffset + lod.indexCount <= header.indexCount;
+        }
+
+        if (valid) {
+            if (packed) {
+                description.vertexFormat = VERTEX_FORMAT_PACKED;
+                description.packedVertices.resize(header.vertexCount);
+                memcpy(description.packedVertices.data(), bytes + header.vertexOffset, vertexBytes);
+            } else {
+                description.vertexFormat = VERTEX_FORMAT_FLOAT;
+                description.vertices.resize(header.vertexCount);
+                memcpy(description.vertices.data(), bytes + header.vertexOffset, vertexBytes);
+            }
+            description.boundsMin = {header.boundsMin[0], header.boundsMin[1], header.boundsMin[2]};
+            description.boundsMax = {header.boundsMax[0], header.boundsMax[1], header.boundsMax[2]};
+            description.indices.resize(header.indexCount);
+            memcpy(description.indices.data(), bytes + header.indexOffset, indexBytes);
+            description.lods.resize(header.lodCount);
+            memcpy(description.lods.data(), bytes + header.lodOffset, lodBytes);
+            if (sourceTouched) {
+                updateSourceModifiedTime(cachePath, sourceModifiedTime);
+            }
+        } else {
+            WARN("Ignoring stale or corrupt mesh cache " << cachePath);
+        }
+        munmap(mapping, cacheSize);
+        return valid;
+    }
+
+    bool MeshCache::store(const char* sourcePath, const MeshCacheKey& key, uint64_t sourceContentHash,
+                          const MeshDescription& description) {
+        MeshCacheHeader header{};
+        memcpy(header.magic, MESH_CACHE_MAGIC, sizeof(MESH_CACHE_MAGIC));
+        header.version = VERSION;
+        header.headerSize = sizeof(MeshCacheHeader);
+        header.sourcePathHash = hashSourcePath(sourcePath);
+        if (!statSource(sourcePath, header.sourceModifiedTime, header.sourceSize)) {
+            return false;
+        }
+        header.sourceContentHash = sourceContentHash;
+        memcpy(header.color, &key.color[0], sizeof(header.color));
+        header.flags = key.flags;
+        header.overdrawThreshold = key.overdrawThreshold;
+        header.lodSettingsHash = key.lodSettingsHash;
+        header.vertexStride = (uint32_t) description.getVertexStride();
+        header.indexStride = sizeof(uint32_t);
+        memcpy(header.boundsMin, &description.boundsMin[0], sizeof(header.boundsMin));
+        memcpy(header.boundsMax, &description.boundsMax[0], sizeof(header.boundsMax));
+
+        const uint8_t* vertexData = (const uint8_t*) description.getVertexData();
+        const uint64_t vertexBytes = description.getVertexCount() * description.getVertexStride();
+        const uint64_t indexBytes = description.indices.size() * sizeof(uint32_t);
+        const uint64_t lodBytes = description.lods.size() * sizeof(MeshLod);
+        header.vertexCount = description.getVertexCount();
+        header.vertexOffset = alignUp(sizeof(MeshCacheHeader), MESH_CACHE_ALIGNMENT);
+        header.indexCount = description.indices.size();
+        header.indexOffset = alignUp(header.vertexOffset + vertexBytes, MESH_CACHE_ALIGNMENT);
+        header.lodCount = description.lods.size();
+        header.lodOffset = alignUp(header.indexOffset + indexBytes, MESH_CACHE_ALIGNMENT);
+        header.payloadHash = hashPayload(vertexData, vertexBytes,
+                                         (const uint8_t*) description.indices.data(), indexBytes,
+                                         (const uint8_t*) description.lods.data(), lodBytes);
+
+        std::vector<uint8_t> file(header.lodOffset + lodBytes, 0);
+        memcpy(file.data(), &header, sizeof(header));
+        memcpy(file.data() + header.vertexOffset, vertexData, vertexBytes);
+        memcpy(file.data() + header.indexOffset, description.indices.data(), indexBytes);
+        memcpy(file.data() + header.lodOffset, description.lods.data(), lodBytes);
+
+        //Write to a temporary file first so readers never see a half written cache
+        std::string cachePath = getCachePath(sourcePath, key);
+        //Unique per thread as well, streaming threads may store the same mesh concurrently
+        std::string temporaryPath = cachePath + ".tmp" + std::to_string(getpid()) + "." +
+                                    std::to_string(std::hash<std::thread::id>()(std::this_thread::get_id()));
+        {
+            std::ofstream output(temporaryPath, std::ios::binary | std::ios::trunc);
+            if (!output) {
+                WARN("Failed to write the mesh cache " << cachePath);
+                return false;
+            }
+            output.write((const char*) file.data(), file.size());
+            if (!output) {
+                output.close();
+                remove(temporaryPath.c_str());
+                WARN("Failed to write the mesh cache " << cachePath);
+                return false;
+            }
+        }
+        if (rename(temporaryPath.c_str(), cachePath.c_str()) != 0) {
+            remove(temporaryPath.c_str());
+            WARN("Failed to write the mesh cache " << cachePath);
+            return false;
+        }
+        return true;
+    }
+}
@@ -1,11 +1,250 @@
 #include "MeshLoader.h"
+#include "Hash.h"
+#include <algorithm>
+#include <atomic>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
 
 namespace tgl {
-     Mesh tgl::MeshLoader::loadObj(const char *filePath) {
+    ThreadPool& MeshLoader::getThreadPool() {
+        //Shared by every load that doesn't bring its own pool, created on first use
+        static ThreadPool threadPool;
+        return threadPool;
+    }
+
+    ThreadPool& MeshLoader::getStreamingThreadPool() {
+        //Separate from the parsing pool, a load waiting on its parse tasks must not occupy one of their workers
+        static ThreadPool threadPool(STREAMING_THREAD_COUNT);
+        return threadPool;
+    }
+
+    void MeshLoader::buildMesh(const ObjData& objData, glm::vec4 color, MeshDescription& description) {
+        //Every corner could be a unique vertex, so this bound means the table never has to grow
+        VertexHashTable newVertices(objData.corners.size());
+        description.indices.reserve(objData.corners.size());
+
+        for (const ObjCorner &corner : objData.corners) {
+            const glm::vec3 &objPos = objData.positions[corner.vertexIndex];
+            //We use 0, 2, 1 due to the coordinate system vulkan uses compared to OpenGL
+            glm::vec3 pos = {objPos.x, objPos.z, objPos.y};
+
+            glm::vec3 normal = {0, 0, 0};
+            if (corner.normalIndex >= 0) {
+                const glm::vec3 &objNormal = objData.normals[corner.normalIndex];
+                normal = {objNormal.x, objNormal.z, objNormal.y};
+            }
+
+            description.indices.push_back(newVertices.insert(Vertex(pos, normal, color), description.vertices));
+        }
+    }
+
+    Mesh tgl::MeshLoader::loadObj(const char *filePath) {
          return loadObj(filePath, {0.5, 0.5, 0.5, 1});
     }
 
     Mesh tgl::MeshLoader::loadObj(const char *filePath, glm::vec4 color) {
+        return loadObj(filePath, color, MeshLoadOptions());
+    }
+
+    Mesh MeshLoader::loadObj(const char *filePath, glm::vec4 color, const MeshLoadOptions &options) {
+        Mesh resultMesh;
+        std::string errorStr;
+        ThreadPool* threadPool = options.threadPool != nullptr ? options.threadPool : &getThreadPool();
+        if (!tryLoadObj(filePath, color, options, threadPool, resultMesh, errorStr)) {
+            ERROR(errorStr);
+        }
+        return resultMesh;
+    }
+
+    bool MeshLoader::tryLoadObj(const char *filePath, glm::vec4 color, const MeshLoadOptions &options,
+                                ThreadPool *threadPool, Mesh &resultMesh, std::string &error) {
+        MeshCacheKey cacheKey{};
+        cacheKey.color = color;
+        cacheKey.flags = options.optimize ? MESH_CACHE_FLAG_OPTIMIZED : 0;
+        if (options.vertexFormat == VERTEX_FORMAT_PACKED) {
+            cacheKey.flags |= MESH_CACHE_FLAG_PACKED_VERTICES;
+        }
+        cacheKey.overdrawThreshold = options.optimize ? options.overdrawThreshold : 0.0F;
+        cacheKey.lodSettingsHash = Hash::hash64(&options.lodTargetError, sizeof(float),
+                                                Hash::hash64(options.lodRatios.data(),
+                                                             options.lodRatios.size() * sizeof(float)));
+        if (options.useCache && MeshCache::load(filePath, cacheKey, resultMesh.description)) {
+            return true;
+        }
+
+        std::ifstream file(filePath, std::ios::binary | std::ios::ate);
+        if (!file) {
+            error = std::string("Failed to open a model! ") + filePath;
+            return false;
+        }
+        size_t fileSize = (size_t) file.tellg();
+        std::vector<char> data(fileSize);
+        file.seekg(0);
+        file.read(data.data(), fileSize);
+        //A short read would otherwise be parsed as a truncated but valid model
+        if (!file) {
+            error = std::string("Failed to read a model! ") + filePath;
+            return false;
+        }
+
+        ObjData objData;
+        std::string errorStr;
+        if (!ObjParser::parse(data.data(), data.size(), objData, errorStr, threadPool)) {
+            error = std::string("Failed to load a model! ") + filePath + ": " + errorStr;
+            return false;
+        }
+        buildMesh(objData, color, resultMesh.description);
+        resultMesh.description.computeBounds();
+
+        if (options.optimize) {
+            MeshOptimizationReport report = MeshOptimizer::optimize(resultMesh.description, options.overdrawThreshold);
+            INFO("Optimized " << filePath << ": ACMR " << report.before.acmr << " -> " << report.after.acmr
+                              << ", ATVR " << report.before.atvr << " -> " << report.after.atvr);
+            if (options.optimizationReport != nullptr) {
+                *options.optimizationReport = report;
+            }
+        }
+        if (!options.lodRatios.empty()) {
+            MeshDescription &description = resultMesh.description;
+            MeshSimplifier::buildLodChain(description, options.lodRatios, options.lodTargetError);
+            //LOD 0 went through the full optimization above, the simplified levels only need their triangle order fixed
+            for (size_t level = 1; options.optimize && level < description.lods.size(); level++) {
+                auto lodBegin = description.indices.begin() + description.lods[level].indexOffset;
+                std::vector<uint32_t> lodIndices(lodBegin, lodBegin + description.lods[level].indexCount);
+                MeshOptimizer::optimizeVertexCache(lodIndices, description.vertices.size());
+                std::copy(lodIndices.begin(), lodIndices.end(), lodBegin);
+            }
+            if (!description.lods.empty()) {
+                INFO("Built " << description.lods.size() << " levels of detail for " << filePath);
+            }
+        }
+        //Packing comes last, the optimizer and simplifier work on the full precision vertices
+        if (options.vertexFormat == VERTEX_FORMAT_PACKED) {
+            resultMesh.description.packVertices();
+        }
+
+        if (options.useCache) {
+            MeshCache::store(filePath, cacheKey, Hash::hash64(data.data(), data.size()), resultMesh.description);
+        }
+        return true;
+    }
+
+    std::shared_future<Mesh> MeshLoader::loadObjAsync(const char *filePath, glm::vec4 color,
+                                                      const MeshLoadOptions &options) {
+        static std::atomic<uint32_t> nextThread{0};
+        //std::function needs a copyable task, so the promise is shared
+        auto promise = std::make_shared<std::promise<Mesh>>();
+        std::shared_future<Mesh> future = promise->get_future().share();
+        std::string path = filePath;
+        getStreamingThreadPool().sendTask(nextThread++, [promise, path, color, options]() {
+            //Not loadObj, its ERROR would exit from this thread or, with the logger compiled out, hand an empty mesh
+            //to a future that looks like a successful load
+            try {
+                Mesh mesh;
+                std::string error;
+                ThreadPool *threadPool = options.threadPool != nullptr ? options.threadPool : &getThreadPool();
+                if (tryLoadObj(path.c_str(), color, options, threadPool, mesh, error)) {
+                    promise->set_value(std::move(mesh));
+                } else {
+                    promise->set_exception(std::make_exception_ptr(std::runtime_error(error)));
+                }
+            } catch (...) {
+                promise->set_exception(std::current_exception());
+            }
+        });
+        return future;
+    }
+
+    std::vector<MeshLoadResult> MeshLoader::loadObjBatch(const std::vector<std::string> &filePaths,
+                                                         const std::vector<glm::vec4> &colors,
+                                                         const MeshLoadOptions &options) {
+        std::vector<MeshLoadResult> results(filePaths.size());
+        if (colors.size() != filePaths.size() && colors.size() != 1) {
+            for (MeshLoadResult &result : results) {
+                result.error = "Expected one color per model or a single color for all of them!";
+            }
+            return results;
+        }
+
+        //Unique loads and the input slots each of them fills
+        struct BatchLoad {
+            std::string path;
+            glm::vec4 color;
+            uint64_t fileSize;
+            std::vector<size_t> slots;
+        };
+        std::vector<BatchLoad> loads;
+        std::unordered_map<std::string, std::vector<size_t>> loadsByPath;
+        for (size_t i = 0; i < filePaths.size(); i++) {
+            glm::vec4 color = colors.size() == 1 ? colors[0] : colors[i];
+            std::error_code errorCode;
+            std::string path = std::filesystem::absolute(filePaths[i], errorCode).lexically_normal().string();
+            if (errorCode) {
+                path = filePaths[i];
+            }
+            std::vector<size_t> &sameLoads = loadsByPath[path];
+            auto sameLoad = std::find_if(sameLoads.begin(), sameLoads.end(), [&](size_t load) {
+                return loads[load].color == color;
+            });
+            if (sameLoad != sameLoads.end()) {
+                loads[*sameLoad].slots.push_back(i);
+                continue;
+            }
+            uint64_t fileSize = std::filesystem::file_size(filePaths[i], errorCode);
+            sameLoads.push_back(loads.size());
+            loads.push_back({filePaths[i], color, errorCode ? 0 : fileSize, {i}});
+        }
+
+        ThreadPool &threadPool = options.threadPool != nullptr ? *options.threadPool : getThreadPool();
+        //Tasks are pinned to a worker, so balance by hand: largest files first, each onto the least loaded worker
+        std::vector<size_t> order(loads.size());
+        for (size_t i = 0; i < order.size(); i++) {
+            order[i] = i;
+        }
+        std::sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+            return loads[a].fileSize > loads[b].fileSize;
+        });
+        std::vector<uint64_t> workerBytes(threadPool.getThreadCount(), 0);
+        //Not finishTasks, the pool may be running other work that this batch shouldn't wait for
+        std::vector<std::future<void>> finished;
+        finished.reserve(loads.size());
+        for (size_t load : order) {
+            uint32_t worker = (uint32_t) (std::min_element(workerBytes.begin(), workerBytes.end()) - workerBytes.begin());
+            //Empty files still cost a task
+            workerBytes[worker] += std::max<uint64_t>(loads[load].fileSize, 1);
+            auto promise = std::make_shared<std::promise<void>>();
+            finished.push_back(promise->get_future());
+            BatchLoad *batchLoad = &loads[load];
+            MeshLoadResult *result = &results[batchLoad->slots[0]];
+            threadPool.sendTask(worker, [promise, batchLoad, result, &options]() {
+                //Each load reports into its own result, the caller's report pointer would be written concurrently
+                MeshLoadOptions loadOptions = options;
+                loadOptions.optimizationReport = &result->optimizationReport;
+                try {
+                    result->success = tryLoadObj(batchLoad->path.c_str(), batchLoad->color, loadOptions, nullptr,
+                                                 result->mesh, result->error);
+                } catch (const std::exception &exception) {
+                    result->error = std::string("Failed to load a model! ") + batchLoad->path + ": " + exception.what();
+                } catch (...) {
+                    result->error = std::string("Failed to load a model! ") + batchLoad->path;
+                }
+                promise->set_value();
+            });
+        }
+        for (std::future<void> &future : finished) {
+            future.wait();
+        }
+
+        for (const BatchLoad &load : loads) {
+            for (size_t i = 1; i < load.slots.size(); i++) {
+                results[load.slots[i]] = results[load.slots[0]];
+            }
+        }
+        return results;
+    }
+
+    Mesh tgl::MeshLoader::loadObjTinyObj(const char *filePath, glm::vec4 color) {
         Mesh resultMesh;
         tinyobj::attrib_t vertexAttributes;
         std::vector<tinyobj::shape_t> shapes;
@@ -47,6 +286,7 @@ namespace tgl {
                 resultMesh.description.indices.push_back(newVertices[vertex]);
             }
         }
+        resultMesh.description.computeBounds();
 
         return resultMesh;
     }
@@ -0,0 +1,300 @@
+#include "MeshOptimizer.h"
+#include <algorithm>
+#include <cmath>
+
+namespace tgl {
+    //Tuning constants from Tom Forsyth's "Linear-Speed Vertex Cache Optimisation"
+    static const float CACHE_DECAY_POWER = 1.5F;
+    static const float LAST_TRIANGLE_SCORE = 0.75F;
+    static const float VALENCE_BOOST_SCALE = 2.0F;
+    static const float VALENCE_BOOST_POWER = 0.5F;
+
+    static float getVertexScore(int32_t cachePosition, uint32_t remainingValence) {
+        if (remainingValence == 0) {
+            //No triangle left to use this vertex
+            return -1.0F;
+        }
+        float score = 0.0F;
+        if (cachePosition >= 0) {
+            if (cachePosition < 3) {
+                //Used by the last triangle, deliberately scored lower so strips don't form
+                score = LAST_TRIANGLE_SCORE;
+            } else {
+                const float scaler = 1.0F / (MeshOptimizer::OPTIMIZATION_CACHE_SIZE - 3);
+                score = std::pow(1.0F - (float) (cachePosition - 3) * scaler, CACHE_DECAY_POWER);
+            }
+        }
+        //Prefer vertices with few triangles left so they can leave the cache for good
+        score += VALENCE_BOOST_SCALE * std::pow((float) remainingValence, -VALENCE_BOOST_POWER);
+        return score;
+    }
+
+    //FIFO cache simulation, a vertex is a hit if it was inserted less than cacheSize insertions ago.
+    static uint32_t updateCache(const uint32_t* triangle, uint32_t cacheSize, std::vector<uint32_t>& timestamps,
+                                uint32_t& timestamp) {
+        uint32_t misses = 0;
+        for (int i = 0; i < 3; i++) {
+            if (timestamp - timestamps[triangle[i]] > cacheSize) {
+                timestamps[triangle[i]] = timestamp++;
+                misses++;
+            }
+        }
+        return misses;
+    }
+
+    void MeshOptimizer::optimizeVertexCache(std::vector<uint32_t>& indices, size_t vertexCount) {
+        const size_t triangleCount = indices.size() / 3;
+        if (triangleCount == 0) {
+            return;
+        }
+
+        //Triangles using each vertex. The first liveTriangles[v] entries of a vertex' range haven't been emitted yet.
+        std::vector<uint32_t> liveTriangles(vertexCount, 0);
+        for (uint32_t index : indices) {
+            liveTriangles[index]++;
+        }
+        std::vector<uint32_t> adjacencyOffsets(vertexCount + 1, 0);
+        for (size_t v = 0; v < vertexCount; v++) {
+            adjacencyOffsets[v + 1] = adjacencyOffsets[v] + liveTriangles[v];
+        }
+        std::vector<uint32_t> adjacency(indices.size());
+        std::vector<uint32_t> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+        for (size_t i = 0; i < indices.size(); i++) {
+            adjacency[fill[indices[i]]++] = (uint32_t) (i / 3);
+        }
+
+        std::vector<int32_t> cachePositions(vertexCount, -1);
+        std::vector<float> vertexScores(vertexCount);
+        for (size_t v = 0; v < vertexCount; v++) {
+            vertexScores[v] = getVertexScore(-1, liveTriangles[v]);
+        }
+        std::vector<float> triangleScores(triangleCount);
+        std::vector<bool> emitted(triangleCount, false);
+        int64_t bestTriangle = 0;
+        for (size_t t = 0; t < triangleCount; t++) {
+            triangleScores[t] = vertexScores[indices[t * 3]] + vertexScores[indices[t * 3 + 1]] +
+                                vertexScores[indices[t * 3 + 2]];
+            if (triangleScores[t] > triangleScores[bestTriangle]) {
+                bestTriangle = (int64_t) t;
+            }
+        }
+
+        std::vector<uint32_t> result;
+        result.reserve(indices.size());
+        std::vector<uint32_t> cache, newCache;
+        cache.reserve(OPTIMIZATION_CACHE_SIZE + 3);
+        newCache.reserve(OPTIMIZATION_CACHE_SIZE + 3);
+        size_t inputCursor = 0;
+
+        for (size_t emittedCount = 0; emittedCount < triangleCount; emittedCount++) {
+            if (bestTriangle < 0) {
+                //Dead end, nothing in the cache has triangles left. Continue with the next one in input order.
+                while (emitted[inputCursor]) {
+                    inputCursor++;
+                }
+                bestTriangle = (int64_t) inputCursor;
+            }
+            const uint32_t* triangle = &indices[bestTriangle * 3];
+            emitted[bestTriangle] = true;
+            newCache.clear();
+            for (int i = 0; i < 3; i++) {
+                const uint32_t vertex = triangle[i];
+                result.push_back(vertex);
+                //Swap the emitted triangle out of the vertex' live range
+                uint32_t* begin = &adjacency[adjacencyOffsets[vertex]];
+                uint32_t* end = begin + liveTriangles[vertex];
+                uint32_t* found = std::find(begin, end, (uint32_t) bestTriangle);
+                std::swap(*found, *(end - 1));
+                liveTriangles[vertex]--;
+                if (std::find(newCache.begin(), newCache.end(), vertex) == newCache.end()) {
+                    newCache.push_back(vertex);
+                }
+            }
+            const size_t triangleVertexCount = newCache.size();
+            for (uint32_t vertex : cache) {
+                if (std::find(newCache.begin(), newCache.begin() + triangleVertexCount, vertex) ==
+                    newCache.begin() + triangleVertexCount) {
+                    newCache.push_back(vertex);
+                }
+            }
+
+            //Rescore every vertex that was or is in the cache and propagate the change to their live triangles
+            for (size_t i = 0; i < newCache.size(); i++) {
+                const uint32_t vertex = newCache[i];
+                cachePositions[vertex] = i < OPTIMIZATION_CACHE_SIZE ? (int32_t) i : -1;
+                const float score = getVertexScore(cachePositions[vertex], liveTriangles[vertex]);
+                const float delta = score - vertexScores[vertex];
+                vertexScores[vertex] = score;
+                const uint32_t* live = &adjacency[adjacencyOffsets[vertex]];
+                for (uint32_t j = 0; j < liveTriangles[vertex]; j++) {
+                    triangleScores[live[j]] += delta;
+                }
+            }
+
+            bestTriangle = -1;
+            float bestScore = -1.0F;
+            cache.clear();
+            for (size_t i = 0; i < newCache.size() && i < OPTIMIZATION_CACHE_SIZE; i++) {
+                const uint32_t vertex = newCache[i];
+                cache.push_back(vertex);
+                const uint32_t* live = &adjacency[adjacencyOffsets[vertex]];
+                for (uint32_t j = 0; j < liveTriangles[vertex]; j++) {
+                    if (triangleScores[live[j]] > bestScore) {
+                        bestScore = triangleScores[live[j]];
+                        bestTriangle = live[j];
+                    }
+                }
+            }
+        }
+        indices.swap(result);
+    }
+
+    void MeshOptimizer::optimizeOverdraw(std::vector<uint32_t>& indices, const std::vector<Vertex>& vertices,
+                                         float threshold) {
+        const size_t triangleCount = indices.size() / 3;
+        if (triangleCount == 0) {
+            return;
+        }
+        threshold = std::max(threshold, 1.0F);
+        std::vector<uint32_t> timestamps(vertices.size(), 0);
+        uint32_t timestamp = ANALYSIS_CACHE_SIZE + 1;
+
+        //Hard boundaries: a triangle missing the cache with all three vertices usually starts a new patch
+        std::vector<uint32_t> hardBoundaries;
+        for (size_t t = 0; t < triangleCount; t++) {
+            if (updateCache(&indices[t * 3], ANALYSIS_CACHE_SIZE, timestamps, timestamp) == 3 || t == 0) {
+                hardBoundaries.push_back((uint32_t) t);
+            }
+        }
+        hardBoundaries.push_back((uint32_t) triangleCount);
+
+        //Soft boundaries: split a patch further wherever the ACMR of the piece so far is within
+        //the threshold of the whole patch, since reordering pieces flushes the cache between them
+        std::vector<uint32_t> clusters;
+        for (size_t h = 0; h + 1 < hardBoundaries.size(); h++) {
+            const uint32_t start = hardBoundaries[h], end = hardBoundaries[h + 1];
+            timestamp += ANALYSIS_CACHE_SIZE + 1;
+            uint32_t patchMisses = 0;
+            for (uint32_t t = start; t < end; t++) {
+                patchMisses += updateCache(&indices[t * 3], ANALYSIS_CACHE_SIZE, timestamps, timestamp);
+            }
+            const float clusterThreshold = threshold * (float) patchMisses / (float) (end - start);
+
+            timestamp += ANALYSIS_CACHE_SIZE + 1;
+            uint32_t clusterStart = start, clusterMisses = 0;
+            for (uint32_t t = start; t < end; t++) {
+                clusterMisses += updateCache(&indices[t * 3], ANALYSIS_CACHE_SIZE, timestamps, timestamp);
+                if ((float) clusterMisses <= clusterThreshold * (float) (t + 1 - clusterStart)) {
+                    clusters.push_back(clusterStart);
+                    clusterStart = t + 1;
+                    clusterMisses = 0;
+                    timestamp += ANALYSIS_CACHE_SIZE + 1;
+                }
+            }
+            if (clusterStart < end) {
+                clusters.push_back(clusterStart);
+            }
+        }
+        const size_t clusterCount = clusters.size();
+        clusters.push_back((uint32_t) triangleCount);
+
+        //Area weighted centroid and facing of every cluster and of the whole mesh
+        glm::vec3 meshCentroid = {0, 0, 0};
+        float meshArea = 0.0F;
+        std::vector<glm::vec3> clusterCentroids(clusterCount), clusterNormals(clusterCount);
+        for (size_t c = 0; c < clusterCount; c++) {
+            glm::vec3 centroid = {0, 0, 0}, normal = {0, 0, 0}, geometricNormal = {0, 0, 0};
+            float area = 0.0F;
+            for (uint32_t t = clusters[c]; t < clusters[c + 1]; t++) {
+                const Vertex& a = vertices[indices[t * 3]];
+                const Vertex& b = vertices[indices[t * 3 + 1]];
+                const Vertex& d = vertices[indices[t * 3 + 2]];
+                const glm::vec3 crossProduct = glm::cross(b.position - a.position, d.position - a.position);
+                const float triangleArea = glm::length(crossProduct);
+                centroid += (a.position + b.position + d.position) * (triangleArea / 3.0F);
+                //The vertex normals know which side is outside regardless of the winding order
+                normal += (a.normal + b.normal + d.normal) * triangleArea;
+                geometricNormal += crossProduct;
+                area += triangleArea;
+            }
+            meshCentroid += centroid;
+            meshArea += area;
+            clusterCentroids[c] = area > 0.0F ? centroid / area : vertices[indices[clusters[c] * 3]].position;
+            if (glm::length(normal) == 0.0F) {
+                normal = geometricNormal;
+            }
+            const float normalLength = glm::length(normal);
+            clusterNormals[c] = normalLength > 0.0F ? normal / normalLength : normal;
+        }
+        if (meshArea > 0.0F) {
+            meshCentroid /= meshArea;
+        }
+
+        //Clusters facing away from the center are likely to occlude the rest, draw them first
+        std::vector<float> sortKeys(clusterCount);
+        std::vector<uint32_t> clusterOrder(clusterCount);
+        for (size_t c = 0; c < clusterCount; c++) {
+            sortKeys[c] = glm::dot(clusterCentroids[c] - meshCentroid, clusterNormals[c]);
+            clusterOrder[c] = (uint32_t) c;
+        }
+        std::stable_sort(clusterOrder.begin(), clusterOrder.end(), [&](uint32_t a, uint32_t b) {
+            return sortKeys[a] > sortKeys[b];
+        });
+
+        std::vector<uint32_t> result;
+        result.reserve(indices.size());
+        for (uint32_t c : clusterOrder) {
+            result.insert(result.end(), indices.begin() + clusters[c] * 3, indices.begin() + clusters[c + 1] * 3);
+        }
+        indices.swap(result);
+    }
+
+    void MeshOptimizer::optimizeVertexFetch(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices) {
+        std::vector<uint32_t> remap(vertices.size(), UINT32_MAX);
+        std::vector<Vertex> result;
+        result.reserve(vertices.size());
+        for (uint32_t& index : indices) {
+            if (remap[index] == UINT32_MAX) {
+                remap[index] = (uint32_t) result.size();
+                result.push_back(vertices[index]);
+            }
+            index = remap[index];
+        }
+        vertices.swap(result);
+    }
+
+    VertexCacheStatistics MeshOptimizer::analyzeVertexCache(const std::vector<uint32_t>& indices, size_t vertexCount,
+                                                            uint32_t cacheSize) {
+        VertexCacheStatistics statistics{};
+        const size_t triangleCount = indices.size() / 3;
+        if (triangleCount == 0) {
+            return statistics;
+        }
+        std::vector<uint32_t> timestamps(vertexCount, 0);
+        std::vector<bool> referenced(vertexCount, false);
+        uint32_t timestamp = cacheSize + 1;
+        size_t misses = 0, uniqueVertices = 0;
+        for (size_t t = 0; t < triangleCount; t++) {
+            misses += updateCache(&indices[t * 3], cacheSize, timestamps, timestamp);
+            for (int i = 0; i < 3; i++) {
+                if (!referenced[indices[t * 3 + i]]) {
+                    referenced[indices[t * 3 + i]] = true;
+                    uniqueVertices++;
+                }
+            }
+        }
+        statistics.acmr = (float) misses / (float) triangleCount;
+        statistics.atvr = (float) misses / (float) uniqueVertices;
+        return statistics;
+    }
+
+    MeshOptimizationReport MeshOptimizer::optimize(MeshDescription& description, float overdrawThreshold) {
+        MeshOptimizationReport report{};
+        report.before = analyzeVertexCache(description.indices, description.vertices.size());
+        optimizeVertexCache(description.indices, description.vertices.size());
+        optimizeOverdraw(description.indices, description.vertices, overdrawThreshold);
+        optimizeVertexFetch(description.vertices, description.indices);
+        report.after = analyzeVertexCache(description.indices, description.vertices.size());
+        return report;
+    }
+}
@@ -0,0 +1,350 @@
+#include "MeshRegistry.h"
+#include "Hash.h"
+#include "VkUtils.h"
+#include <cstring>
+#include <exception>
+
+namespace tgl {
+    uint64_t MeshRegistry::hashGeometry(const MeshDescription& description) {
+        uint64_t hash = Hash::hash64(&description.vertexFormat, sizeof(description.vertexFormat));
+        hash = Hash::hash64(description.getVertexData(), description.getVertexCount() * description.getVertexStride(),
+                            hash);
+        hash = Hash::hash64(description.indices.data(), description.indices.size() * sizeof(uint32_t), hash);
+        hash = Hash::hash64(description.lods.data(), description.lods.size() * sizeof(MeshLod), hash);
+        hash = Hash::hash64(&description.boundsMin, sizeof(glm::vec3), hash);
+        return Hash::hash64(&description.boundsMax, sizeof(glm::vec3), hash);
+    }
+
+    bool MeshRegistry::isSameGeometry(const MeshDescription& description, const MeshDescription& other) {
+        return description.vertexFormat == other.vertexFormat &&
+               description.getVertexCount() == other.getVertexCount() &&
+               description.indices.size() == other.indices.size() &&
+               description.lods.size() == other.lods.size() &&
+               description.boundsMin == other.boundsMin && description.boundsMax == other.boundsMax &&
+               memcmp(description.getVertexData(), other.getVertexData(),
+                      description.getVertexCount() * description.getVertexStride()) == 0 &&
+               memcmp(description.indices.data(), other.indices.data(), description.indices.size() * sizeof(uint32_t)) == 0 &&
+               memcmp(description.lods.data(), other.lods.data(), description.lods.size() * sizeof(MeshLod)) == 0;
+    }
+
+    uint32_t MeshRegistry::allocateEntry() {
+        uint32_t index;
+        if (!freeIndices.empty()) {
+            index = freeIndices.back();
+            freeIndices.pop_back();
+        } else {
+            index = (uint32_t) entries.size();
+            entries.emplace_back();
+        }
+        entries[index] = MeshEntry();
+        entries[index].used = true;
+        entries[index].canonicalIndex = index;
+        return index;
+    }
+
+    uint32_t MeshRegistry::resolve(MeshHandle handle) const {
+        return entries[handle.index].canonicalIndex;
+    }
+
+    uint32_t MeshRegistry::findDuplicate(const MeshDescription& description, uint64_t contentHash) const {
+        auto range = entriesByHash.equal_range(contentHash);
+        for (auto it = range.first; it != range.second; ++it) {
+            if (isSameGeometry(description, entries[it->second].description)) {
+                return it->second;
+            }
+        }
+        return MeshHandle::INVALID_INDEX;
+    }
+
+    void MeshRegistry::uploadEntries(const std::vector<uint32_t>& indices) {
+        //Staging offsets of the device local entries, vertex data followed by index data
+        std::vector<std::pair<uint32_t, VkDeviceSize>> stagedEntries;
+        VkDeviceSize stagingBytes = 0;
+        for (uint32_t index : indices) {
+            MeshEntry &entry = entries[index];
+            const MeshDescription &description = entry.description;
+            const size_t vertexBytes = description.getVertexCount() * description.getVertexStride();
+            const size_t indexBytes = description.indices.size() * sizeof(uint32_t);
+            entry.resident = true;
+            if (vertexBytes == 0 || indexBytes == 0) {
+                //Nothing to draw, Vulkan doesn't allow empty buffers
+                continue;
+            }
+            if (entry.memory == MESH_MEMORY_HOST_VISIBLE) {
+                VkUtils::createBuffer(allocator, entry.vertexBuffer.allocation, entry.vertexBuffer.vkBuffer, vertexBytes,
+                                      VK_BUFFER_USAGE_VERTEX_BUFFER_BIT);
+                VkUtils::createBuffer(allocator, entry.indexBuffer.allocation, entry.indexBuffer.vkBuffer, indexBytes,
+                                      VK_BUFFER_USAGE_INDEX_BUFFER_BIT);
+
+                void *data;
+                vmaMapMemory(allocator, entry.vertexBuffer.allocation, &data);
+                memcpy(data, description.getVertexData(), vertexBytes);
+                vmaUnmapMemory(allocator, entry.vertexBuffer.allocation);
+
+                vmaMapMemory(allocator, entry.indexBuffer.allocation, &data);
+                memcpy(data, description.indices.data(), indexBytes);
+                vmaUnmapMemory(allocator, entry.indexBuffer.allocation);
+                entry.vkVertexBuffer = entry.vertexBuffer.vkBuffer;
+                entry.vkIndexBuffer = entry.indexBuffer.vkBuffer;
+                continue;
+            }
+            GeometryArena &vertexArena = vertexArenas[description.vertexFormat];
+            entry.vertexAllocation = vertexArena.allocate((uint32_t) description.getVertexCount());
+            entry.indexAllocation = indexArena.allocate((uint32_t) description.indices.size());
+            entry.vkVertexBuffer = vertexArena.getBuffer(entry.vertexAllocation.block);
+            entry.vkIndexBuffer = indexArena.getBuffer(entry.indexAllocation.block);
+            entry.vertexOffset = (int32_t) entry.vertexAllocation.offset;
+            entry.firstIndex = entry.indexAllocation.offset;
+            stagedEntries.emplace_back(index, stagingBytes);
+            stagingBytes += vertexBytes + indexBytes;
+        }
+        if (stagedEntries.empty()) {
+            return;
+        }
+
+        AllocatedBuffer stagingBuffer{};
+        VkUtils::createBuffer(allocator, stagingBuffer.allocation, stagingBuffer.vkBuffer, stagingBytes,
+                              VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VMA_MEMORY_USAGE_CPU_ONLY);
+        char *stagingData;
+        vmaMapMemory(allocator, stagingBuffer.allocation, (void **) &stagingData);
+        for (const auto &stagedEntry : stagedEntries) {
+            const MeshDescription &description = entries[stagedEntry.first].description;
+            const size_t vertexBytes = description.getVertexCount() * description.getVertexStride();
+            memcpy(stagingData + stagedEntry.second, description.getVertexData(), vertexBytes);
+            memcpy(stagingData + stagedEntry.second + vertexBytes, description.indices.data(),
+                   description.indices.size() * sizeof(uint32_t));
+        }
+        vmaUnmapMemory(allocator, stagingBuffer.allocation);
+
+        std::vector<UploadCopy> copies;
+        copies.reserve(stagedEntries.size() * 2);
+        for (const auto &stagedEntry : stagedEntries) {
+            const MeshEntry &entry = entries[stagedEntry.first];
+            const size_t vertexBytes = entry.description.getVertexCount() * entry.description.getVertexStride();
+            UploadCopy copy{};
+            copy.vkDstBuffer = entry.vkVertexBuffer;
+            copy.vkBufferCopy.srcOffset = stagedEntry.second;
+            copy.vkBufferCopy.dstOffset = (VkDeviceSize) entry.vertexAllocation.offset * entry.description.getVertexStride();
+            copy.vkBufferCopy.size = vertexBytes;
+            copies.push_back(copy);
+            copy.vkDstBuffer = entry.vkIndexBuffer;
+            copy.vkBufferCopy.srcOffset = stagedEntry.second + vertexBytes;
+            copy.vkBufferCopy.dstOffset = (VkDeviceSize) entry.indexAllocation.offset * sizeof(uint32_t);
+            copy.vkBufferCopy.size = entry.description.indices.size() * sizeof(uint32_t);
+            copies.push_back(copy);
+        }
+        //Doesn't wait, the frame drawing these meshes waits on the upload's semaphore instead
+        uploadEngine->submit(stagingBuffer, copies);
+    }
+
+    void MeshRegistry::destroyEntry(uint32_t index) {
+        MeshEntry &entry = entries[index];
+        if (entry.resident && entry.memory == MESH_MEMORY_HOST_VISIBLE) {
+            //Both are null for empty meshes, which VMA ignores
+            vmaDestroyBuffer(allocator, entry.vertexBuffer.vkBuffer, entry.vertexBuffer.allocation);
+            vmaDestroyBuffer(allocator, entry.indexBuffer.vkBuffer, entry.indexBuffer.allocation);
+        } else if (entry.resident) {
+            //Invalid for empty meshes, which the arenas ignore
+            vertexArenas[entry.description.vertexFormat].free(entry.vertexAllocation);
+            indexArena.free(entry.indexAllocation);
+        }
+        auto range = entriesByHash.equal_range(entry.contentHash);
+        for (auto it = range.first; it != range.second; ++it) {
+            if (it->second == index) {
+                entriesByHash.erase(it);
+                break;
+            }
+        }
+        for (uint32_t alias : entry.aliases) {
+            entries[alias] = MeshEntry();
+            freeIndices.push_back(alias);
+        }
+        entries[index] = MeshEntry();
+        freeIndices.push_back(index);
+    }
+
+    void MeshRegistry::init(UploadEngine* engine, VmaAllocator vmaAllocator) {
+        uploadEngine = engine;
+        allocator = vmaAllocator;
+
+        vertexArenas[VERTEX_FORMAT_FLOAT].init(allocator, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, sizeof(Vertex),
+                                               VERTEX_ARENA_BLOCK_BYTES);
+        vertexArenas[VERTEX_FORMAT_PACKED].init(allocator, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, sizeof(PackedVertex),
+                                                VERTEX_ARENA_BLOCK_BYTES);
+        indexArena.init(allocator, VK_BUFFER_USAGE_INDEX_BUFFER_BIT, sizeof(uint32_t), INDEX_ARENA_BLOCK_BYTES);
+    }
+
+    MeshHandle MeshRegistry::add(Mesh mesh, MeshMemory memory) {
+        //Host visible meshes may be rewritten, so they are never shared
+        uint64_t contentHash = memory == MESH_MEMORY_DEVICE_LOCAL ? hashGeometry(mesh.description) : 0;
+        uint32_t index = memory == MESH_MEMORY_DEVICE_LOCAL ? findDuplicate(mesh.description, contentHash)
+                                                            : MeshHandle::INVALID_INDEX;
+        if (index == MeshHandle::INVALID_INDEX) {
+            index = allocateEntry();
+            MeshEntry &entry = entries[index];
+            entry.description = std::move(mesh.description);
+            entry.memory = memory;
+            entry.contentHash = contentHash;
+            if (memory == MESH_MEMORY_DEVICE_LOCAL) {
+                entriesByHash.emplace(contentHash, index);
+            }
+            pendingEntries.push_back(index);
+        }
+        entries[index].referenceCount++;
+        return {index};
+    }
+
+    MeshHandle MeshRegistry::addAsync(const std::shared_future<Mesh>& mesh, MeshMemory memory) {
+        //The content is only known once loaded, duplicates are resolved in processUploads
+        uint32_t index = allocateEntry();
+        entries[index].pendingMesh = mesh;
+        entries[index].memory = memory;
+        entries[index].referenceCount = 1;
+        pendingEntries.push_back(index);
+        return {index};
+    }
+
+    void MeshRegistry::acquire(MeshHandle handle) {
+        if (!handle.isValid()) {
+            return;
+        }
+        entries[resolve(handle)].referenceCount++;
+    }
+
+    void MeshRegistry::release(MeshHandle handle, uint64_t frame) {
+        if (!handle.isValid()) {
+            return;
+        }
+        uint32_t index = resolve(handle);
+        MeshEntry &entry = entries[index];
+        if (entry.referenceCount == 0) {
+            WARN("Released a mesh without references");
+            return;
+        }
+        if (--entry.referenceCount == 0) {
+            entry.retiredFrame = frame;
+            retiredEntries.emplace_back(index, frame);
+        }
+    }
+
+    bool MeshRegistry::isResident(MeshHandle handle) const {
+        return handle.isValid() && entries[resolve(handle)].resident;
+    }
+
+    const MeshEntry& MeshRegistry::getEntry(MeshHandle handle) const {
+        return entries[resolve(handle)];
+    }
+
+    const MeshDescription& MeshRegistry::getDescription(MeshHandle handle) const {
+        return entries[resolve(handle)].description;
+    }
+
+    GeometryArenaStats MeshRegistry::getVertexArenaStats(VertexFormat vertexFormat) const {
+        return vertexArenas[vertexFormat].getStats();
+    }
+
+    GeometryArenaStats MeshRegistry::getIndexArenaStats() const {
+        return indexArena.getStats();
+    }
+
+    size_t MeshRegistry::getMeshCount() const {
+        size_t meshCount = 0;
+        for (uint32_t i = 0; i < entries.size(); i++) {
+            if (entries[i].used && entries[i].canonicalIndex == i) {
+                meshCount++;
+            }
+        }
+        return meshCount;
+    }
+
+    uint64_t MeshRegistry::processUploads(uint64_t budgetBytes) {
+        uint64_t uploadedBytes = 0;
+        std::vector<uint32_t> batch;
+        while (!pendingEntries.empty()) {
+            const uint32_t index = pendingEntries.front();
+            MeshEntry &entry = entries[index];
+            if (!entry.used || entry.resident || entry.canonicalIndex != index) {
+                //Destroyed or resolved since it was queued
+                pendingEntries.pop_front();
+                continue;
+            }
+            if (entry.pendingMesh.valid()) {
+                if (entry.pendingMesh.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+                    //Keep the registration order, later meshes wait for this one
+                    break;
+                }
+                Mesh mesh;
+                try {
+                    mesh = entry.pendingMesh.get();
+                } catch (const std::exception &exception) {
+                    //Never becomes resident, so it's never drawn. The caller's copy of the future holds the error.
+                    WARN("Failed to load a streamed mesh: " << exception.what());
+                    entry.pendingMesh = std::shared_future<Mesh>();
+                    pendingEntries.pop_front();
+                    continue;
+                }
+                entry.pendingMesh = std::shared_future<Mesh>();
+                const bool shared = entry.memory == MESH_MEMORY_DEVICE_LOCAL;
+                uint64_t contentHash = shared ? hashGeometry(mesh.description) : 0;
+                uint32_t duplicate = shared ? findDuplicate(mesh.description, contentHash) : MeshHandle::INVALID_INDEX;
+                if (duplicate != MeshHandle::INVALID_INDEX) {
+                    //Hand the references over, the handle keeps working through canonicalIndex
+                    entries[duplicate].referenceCount += entry.referenceCount;
+                    entries[duplicate].aliases.push_back(index);
+                    entry.referenceCount = 0;
+                    entry.canonicalIndex = duplicate;
+                    pendingEntries.pop_front();
+                    continue;
+                }
+                entry.description = std::move(mesh.description);
+                entry.contentHash = contentHash;
+                if (shared) {
+                    entriesByHash.emplace(contentHash, index);
+                }
+            }
+
+            const MeshDescription &description = entry.description;
+            uint64_t meshBytes = description.getVertexCount() * description.getVertexStride() +
+                                 description.indices.size() * sizeof(uint32_t);
+            if (uploadedBytes > 0 && uploadedBytes + meshBytes > budgetBytes) {
+                break;
+            }
+            batch.push_back(index);
+            uploadedBytes += meshBytes;
+            pendingEntries.pop_front();
+        }
+        uploadEntries(batch);
+        return uploadedBytes;
+    }
+
+    void MeshRegistry::collectGarbage(uint64_t currentFrame, uint32_t framesInFlight) {
+        while (!retiredEntries.empty() && retiredEntries.front().second + framesInFlight <= currentFrame) {
+            const uint32_t index = retiredEntries.front().first;
+            const uint64_t frame = retiredEntries.front().second;
+            retiredEntries.pop_front();
+            const MeshEntry &entry = entries[index];
+            //Skip entries that got a new reference or were retired again later
+            if (entry.used && entry.canonicalIndex == index && entry.referenceCount == 0 && entry.retiredFrame == frame) {
+                destroyEntry(index);
+            }
+        }
+    }
+
+    void MeshRegistry::destroy() {
+        for (MeshEntry &entry : entries) {
+            if (entry.used && entry.resident && entry.memory == MESH_MEMORY_HOST_VISIBLE) {
+                vmaDestroyBuffer(allocator, entry.vertexBuffer.vkBuffer, entry.vertexBuffer.allocation);
+                vmaDestroyBuffer(allocator, entry.indexBuffer.vkBuffer, entry.indexBuffer.allocation);
+            }
+        }
+        for (GeometryArena &vertexArena : vertexArenas) {
+            vertexArena.destroy();
+        }
+        indexArena.destroy();
+        entries.clear();
+        freeIndices.clear();
+        entriesByHash.clear();
+        pendingEntries.clear();
+        retiredEntries.clear();
+    }
+}
@@ -0,0 +1,402 @@
+#include "MeshSimplifier.h"
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <unordered_set>
+
+namespace tgl {
+    //Weight of the planes that keep open borders in place, relative to the surface planes
+    static const double BORDER_WEIGHT = 10.0;
+    //A collapse is rejected if it turns an adjacent triangle's normal by more than ~75 degrees
+    static const double MIN_NORMAL_DOT = 0.25;
+    //Each pass only takes collapses up to this factor above the cheapest ones needed to reach its goal
+    static const double PASS_ERROR_SLACK = 1.5;
+    //A level of detail has to drop at least this share of the previous level's indices to be kept
+    static const float MIN_LOD_REDUCTION = 0.1F;
+
+    enum VertexKind {
+        VERTEX_KIND_INTERIOR,
+        //On an open border, may only slide along it
+        VERTEX_KIND_BORDER,
+        //Touches a non-manifold edge, never moved
+        VERTEX_KIND_LOCKED
+    };
+
+    //Q(p) = p^T A p + 2 b^T p + c, the weighted sum of squared distances to a set of planes
+    struct Quadric {
+        double a00 = 0, a01 = 0, a02 = 0, a11 = 0, a12 = 0, a22 = 0;
+        double b0 = 0, b1 = 0, b2 = 0;
+        double c = 0;
+        double weight = 0;
+    };
+
+    static void addPlane(Quadric& quadric, glm::vec3 normal, double distance, double weight) {
+        const double x = normal.x, y = normal.y, z = normal.z;
+        quadric.a00 += weight * x * x;
+        quadric.a01 += weight * x * y;
+        quadric.a02 += weight * x * z;
+        quadric.a11 += weight * y * y;
+        quadric.a12 += weight * y * z;
+        quadric.a22 += weight * z * z;
+        quadric.b0 += weight * x * distance;
+        quadric.b1 += weight * y * distance;
+        quadric.b2 += weight * z * distance;
+        quadric.c += weight * distance * distance;
+        quadric.weight += weight;
+    }
+
+    static void addQuadric(Quadric& quadric, const Quadric& other) {
+        quadric.a00 += other.a00;
+        quadric.a01 += other.a01;
+        quadric.a02 += other.a02;
+        quadric.a11 += other.a11;
+        quadric.a12 += other.a12;
+        quadric.a22 += other.a22;
+        quadric.b0 += other.b0;
+        quadric.b1 += other.b1;
+        quadric.b2 += other.b2;
+        quadric.c += other.c;
+        quadric.weight += other.weight;
+    }
+
+    //Weighted mean squared distance of a point to the quadric's planes
+    static double evaluate(const Quadric& quadric, glm::vec3 point) {
+        if (quadric.weight <= 0) {
+            return 0;
+        }
+        const double x = point.x, y = point.y, z = point.z;
+        double result = quadric.a00 * x * x + quadric.a11 * y * y + quadric.a22 * z * z +
+                        2 * (quadric.a01 * x * y + quadric.a02 * x * z + quadric.a12 * y * z) +
+                        2 * (quadric.b0 * x + quadric.b1 * y + quadric.b2 * z) + quadric.c;
+        return std::fabs(result) / quadric.weight;
+    }
+
+    static uint64_t getEdgeKey(uint32_t from, uint32_t to) {
+        return ((uint64_t) from << 32) | to;
+    }
+
+    static float getExtent(const std::vector<Vertex>& vertices) {
+        if (vertices.empty()) {
+            return 0.0F;
+        }
+        glm::vec3 boundsMin = vertices[0].position;
+        glm::vec3 boundsMax = vertices[0].position;
+        for (const Vertex &vertex : vertices) {
+            boundsMin = glm::min(boundsMin, vertex.position);
+            boundsMax = glm::max(boundsMax, vertex.position);
+        }
+        return glm::length(boundsMax - boundsMin);
+    }
+
+    //Vertices that only differ in their attributes are one vertex to the simplifier. Every vertex is mapped to the
+    //first vertex with its position, and nextWedge links all vertices sharing a position in a cycle.
+    static void buildPositionClasses(const std::vector<Vertex>& vertices, std::vector<uint32_t>& positionClass,
+                                     std::vector<uint32_t>& nextWedge) {
+        std::vector<uint32_t> order(vertices.size());
+        std::iota(order.begin(), order.end(), 0);
+        auto positionLess = [&](uint32_t a, uint32_t b) {
+            const glm::vec3 &pa = vertices[a].position;
+            const glm::vec3 &pb = vertices[b].position;
+            if (pa.x != pb.x) return pa.x < pb.x;
+            if (pa.y != pb.y) return pa.y < pb.y;
+            if (pa.z != pb.z) return pa.z < pb.z;
+            return a < b;
+        };
+        std::sort(order.begin(), order.end(), positionLess);
+
+        positionClass.resize(vertices.size());
+        nextWedge.resize(vertices.size());
+        size_t groupStart = 0;
+        for (size_t i = 1; i <= order.size(); i++) {
+            if (i < order.size() && vertices[order[i]].position == vertices[order[groupStart]].position) {
+                continue;
+            }
+            for (size_t j = groupStart; j < i; j++) {
+                positionClass[order[j]] = order[groupStart];
+                nextWedge[order[j]] = order[j + 1 < i ? j + 1 : groupStart];
+            }
+            groupStart = i;
+        }
+    }
+
+    //The wedge of the target position whose attributes are closest to the collapsed vertex
+    static uint32_t findMatchingWedge(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& nextWedge,
+                                      uint32_t vertex, uint32_t target) {
+        uint32_t best = target;
+        float bestScore = -INFINITY;
+        uint32_t wedge = target;
+        do {
+            float score = glm::dot(vertices[vertex].normal, vertices[wedge].normal);
+            if (vertices[vertex].color != vertices[wedge].color) {
+                score -= 2.0F;
+            }
+            if (score > bestScore) {
+                bestScore = score;
+                best = wedge;
+            }
+            wedge = nextWedge[wedge];
+        } while (wedge != target);
+        return best;
+    }
+
+    std::vector<uint32_t> MeshSimplifier::simplify(const std::vector<uint32_t>& indices,
+                                                   const std::vector<Vertex>& vertices, size_t targetIndexCount,
+                                                   float targetError, float* resultError) {
+        const size_t vertexCount = vertices.size();
+        const float extent = getExtent(vertices);
+        double maxCost = 0;
+        std::vector<uint32_t> positionClass;
+        std::vector<uint32_t> nextWedge;
+        buildPositionClasses(vertices, positionClass, nextWedge);
+        auto getPosition = [&](uint32_t positionIndex) -> const glm::vec3 & {
+            return vertices[positionIndex].position;
+        };
+
+        //Triangles that collapse to a line or point at position level can't be drawn anyway
+        std::vector<uint32_t> result;
+        result.reserve(indices.size());
+        for (size_t i = 0; i + 2 < indices.size(); i += 3) {
+            uint32_t a = positionClass[indices[i]], b = positionClass[indices[i + 1]], c = positionClass[indices[i + 2]];
+            if (a != b && b != c && a != c) {
+                result.insert(result.end(), {indices[i], indices[i + 1], indices[i + 2]});
+            }
+        }
+
+        std::unordered_set<uint64_t> edges;
+        edges.reserve(result.size());
+        for (size_t i = 0; i < result.size(); i++) {
+            uint32_t from = positionClass[result[i]];
+            uint32_t to = positionClass[result[i - i % 3 + (i + 1) % 3]];
+            edges.insert(getEdgeKey(from, to));
+        }
+
+        //Area weighted triangle planes, plus planes perpendicular to open borders so they don't shrink
+        std::vector<Quadric> quadrics(vertexCount);
+        for (size_t i = 0; i < result.size(); i += 3) {
+            uint32_t triangle[3] = {positionClass[result[i]], positionClass[result[i + 1]],
+                                    positionClass[result[i + 2]]};
+            glm::vec3 normal = glm::cross(getPosition(triangle[1]) - getPosition(triangle[0]),
+                                          getPosition(triangle[2]) - getPosition(triangle[0]));
+            float doubleArea = glm::length(normal);
+            if (doubleArea <= 0.0F) {
+                continue;
+            }
+            normal /= doubleArea;
+            double distance = -glm::dot(normal, getPosition(triangle[0]));
+            for (uint32_t corner : triangle) {
+                addPlane(quadrics[corner], normal, distance, doubleArea * 0.5);
+            }
+            for (int e = 0; e < 3; e++) {
+                uint32_t from = triangle[e], to = triangle[(e + 1) % 3];
+                if (edges.count(getEdgeKey(to, from)) != 0) {
+                    continue;
+                }
+                glm::vec3 edge = getPosition(to) - getPosition(from);
+                float edgeLength = glm::length(edge);
+                if (edgeLength <= 0.0F) {
+                    continue;
+                }
+                glm::vec3 borderNormal = glm::normalize(glm::cross(edge, normal));
+                double borderDistance = -glm::dot(borderNormal, getPosition(from));
+                addPlane(quadrics[from], borderNormal, borderDistance, edgeLength * edgeLength * BORDER_WEIGHT);
+                addPlane(quadrics[to], borderNormal, borderDistance, edgeLength * edgeLength * BORDER_WEIGHT);
+            }
+        }
+
+        const double errorLimit = (double) targetError * extent * targetError * extent;
+        std::vector<uint8_t> kinds(vertexCount);
+        std::vector<uint32_t> adjacencyOffsets(vertexCount + 1);
+        std::vector<uint32_t> adjacency;
+        std::vector<uint32_t> classRemap(vertexCount);
+        std::vector<uint32_t> vertexRemap(vertexCount);
+        std::vector<bool> collapseLocked(vertexCount);
+
+        struct Collapse {
+            uint32_t from;
+            uint32_t to;
+            double cost;
+        };
+        std::vector<Collapse> collapses;
+
+        while (result.size() > targetIndexCount) {
+            //Classify the current topology
+            edges.clear();
+            std::fill(kinds.begin(), kinds.end(), VERTEX_KIND_INTERIOR);
+            for (size_t i = 0; i < result.size(); i++) {
+                uint32_t from = positionClass[result[i]];
+                uint32_t to = positionClass[result[i - i % 3 + (i + 1) % 3]];
+                if (!edges.insert(getEdgeKey(from, to)).second) {
+                    //The same directed edge twice means more than two triangles meet there
+                    kinds[from] = kinds[to] = VERTEX_KIND_LOCKED;
+                }
+            }
+            for (uint64_t edge : edges) {
+                uint32_t from = (uint32_t) (edge >> 32), to = (uint32_t) edge;
+                if (edges.count(getEdgeKey(to, from)) == 0) {
+                    for (uint32_t vertex : {from, to}) {
+                        if (kinds[vertex] == VERTEX_KIND_INTERIOR) {
+                            kinds[vertex] = VERTEX_KIND_BORDER;
+                        }
+                    }
+                }
+            }
+
+            std::fill(adjacencyOffsets.begin(), adjacencyOffsets.end(), 0);
+            for (uint32_t index : result) {
+                adjacencyOffsets[positionClass[index] + 1]++;
+            }
+            for (size_t v = 0; v < vertexCount; v++) {
+                adjacencyOffsets[v + 1] += adjacencyOffsets[v];
+            }
+            adjacency.resize(result.size());
+            std::vector<uint32_t> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+            for (size_t i = 0; i < result.size(); i++) {
+                adjacency[fill[positionClass[result[i]]]++] = (uint32_t) (i / 3);
+            }
+
+            //Cheapest allowed direction of every edge
+            collapses.clear();
+            for (size_t i = 0; i < result.size(); i++) {
+                uint32_t a = positionClass[result[i]];
+                uint32_t b = positionClass[result[i - i % 3 + (i + 1) % 3]];
+                bool borderEdge = edges.count(getEdgeKey(b, a)) == 0;
+                //Interior edges show up once per direction
+                if (!borderEdge && a > b) {
+                    continue;
+                }
+                Collapse best{0, 0, INFINITY};
+                for (int direction = 0; direction < 2; direction++) {
+                    uint32_t from = direction == 0 ? a : b;
+                    uint32_t to = direction == 0 ? b : a;
+                    bool allowed = kinds[from] == VERTEX_KIND_INTERIOR ||
+                                   (kinds[from] == VERTEX_KIND_BORDER && kinds[to] == VERTEX_KIND_BORDER && borderEdge);
+                    if (!allowed) {
+                        continue;
+                    }
+                    double cost = evaluate(quadrics[from], getPosition(to));
+                    if (cost < best.cost) {
+                        best = {from, to, cost};
+                    }
+                }
+                if (best.cost <= errorLimit) {
+                    collapses.push_back(best);
+                }
+            }
+            if (collapses.empty()) {
+                break;
+            }
+            std::sort(collapses.begin(), collapses.end(), [](const Collapse &a, const Collapse &b) {
+                return a.cost < b.cost;
+            });
+
+            //An interior collapse removes two triangles
+            const size_t collapseGoal = std::max<size_t>((result.size() - targetIndexCount) / 6, 1);
+            double passErrorLimit = errorLimit;
+            if (collapseGoal < collapses.size()) {
+                passErrorLimit = std::min(errorLimit, collapses[collapseGoal].cost * PASS_ERROR_SLACK);
+            }
+
+            std::iota(classRemap.begin(), classRemap.end(), 0);
+            std::iota(vertexRemap.begin(), vertexRemap.end(), 0);
+            std::fill(collapseLocked.begin(), collapseLocked.end(), false);
+            size_t collapseCount = 0;
+            for (const Collapse &collapse : collapses) {
+                if (collapseCount >= collapseGoal || collapse.cost > passErrorLimit) {
+                    break;
+                }
+                if (collapseLocked[collapse.from] || collapseLocked[collapse.to]) {
+                    continue;
+                }
+
+                //Moving the vertex must not fold any of the triangles that survive the collapse
+                bool flips = false;
+                for (uint32_t a = adjacencyOffsets[collapse.from]; a < adjacencyOffsets[collapse.from + 1] && !flips; a++) {
+                    uint32_t t = adjacency[a];
+                    uint32_t corners[3];
+                    for (int k = 0; k < 3; k++) {
+                        corners[k] = classRemap[positionClass[result[t * 3 + k]]];
+                    }
+                    if (corners[0] == collapse.to || corners[1] == collapse.to || corners[2] == collapse.to ||
+                        corners[0] == corners[1] || corners[1] == corners[2] || corners[0] == corners[2]) {
+                        continue;
+                    }
+                    glm::vec3 positions[3] = {getPosition(corners[0]), getPosition(corners[1]), getPosition(corners[2])};
+                    glm::vec3 normalBefore = glm::cross(positions[1] - positions[0], positions[2] - positions[0]);
+                    for (int k = 0; k < 3; k++) {
+                        if (corners[k] == collapse.from) {
+                            positions[k] = getPosition(collapse.to);
+                        }
+                    }
+                    glm::vec3 normalAfter = glm::cross(positions[1] - positions[0], positions[2] - positions[0]);
+                    double lengths = (double) glm::length(normalBefore) * glm::length(normalAfter);
+                    flips = lengths <= 0 || glm::dot(normalBefore, normalAfter) < MIN_NORMAL_DOT * lengths;
+                }
+                if (flips) {
+                    continue;
+                }
+
+                classRemap[collapse.from] = collapse.to;
+                addQuadric(quadrics[collapse.to], quadrics[collapse.from]);
+                maxCost = std::max(maxCost, collapse.cost);
+                uint32_t wedge = collapse.from;
+                do {
+                    vertexRemap[wedge] = findMatchingWedge(vertices, nextWedge, wedge, collapse.to);
+                    wedge = nextWedge[wedge];
+                } while (wedge != collapse.from);
+                collapseLocked[collapse.from] = collapseLocked[collapse.to] = true;
+                collapseCount++;
+            }
+            if (collapseCount == 0) {
+                break;
+            }
+
+            size_t writeIndex = 0;
+            for (size_t i = 0; i < result.size(); i += 3) {
+                uint32_t triangle[3] = {vertexRemap[result[i]], vertexRemap[result[i + 1]], vertexRemap[result[i + 2]]};
+                uint32_t a = positionClass[triangle[0]], b = positionClass[triangle[1]], c = positionClass[triangle[2]];
+                if (a != b && b != c && a != c) {
+                    result[writeIndex++] = triangle[0];
+                    result[writeIndex++] = triangle[1];
+                    result[writeIndex++] = triangle[2];
+                }
+            }
+            result.resize(writeIndex);
+        }
+
+        if (resultError != nullptr) {
+            *resultError = extent > 0.0F ? (float) std::sqrt(maxCost) / extent : 0.0F;
+        }
+        return result;
+    }
+
+    void MeshSimplifier::buildLodChain(MeshDescription& description, const std::vector<float>& ratios,
+                                       float targetError) {
+        description.lods.clear();
+        if (description.indices.empty() || description.vertices.empty()) {
+            return;
+        }
+        //Every level is simplified from LOD 0 so its error is measured against the original surface
+        const std::vector<uint32_t> baseIndices = description.indices;
+        const float extent = getExtent(description.vertices);
+        description.lods.push_back({0, (uint32_t) baseIndices.size(), 0.0F});
+
+        for (float ratio : ratios) {
+            size_t targetIndexCount = (size_t) ((float) (baseIndices.size() / 3) * ratio) * 3;
+            float error = 0.0F;
+            std::vector<uint32_t> lodIndices = MeshSimplifier::simplify(baseIndices, description.vertices,
+                                                                        targetIndexCount, targetError, &error);
+            const MeshLod &previous = description.lods.back();
+            if (lodIndices.empty() ||
+                (float) lodIndices.size() > (float) previous.indexCount * (1.0F - MIN_LOD_REDUCTION)) {
+                //The error bound is reached, coarser ratios won't get any further
+                break;
+            }
+            description.lods.push_back({(uint32_t) description.indices.size(), (uint32_t) lodIndices.size(),
+                                        error * extent});
+            description.indices.insert(description.indices.end(), lodIndices.begin(), lodIndices.end());
+        }
+        if (description.lods.size() == 1) {
+            description.lods.clear();
+        }
+    }
+}
@@ -0,0 +1,374 @@
+#include "ObjParser.h"
+#include <fstream>
+#include <cstring>
+#include <algorithm>
+#include <future>
+#include <memory>
+
+namespace tgl {
+    //Chunks smaller than this aren't worth a task of their own
+    static const size_t MIN_CHUNK_SIZE = 64 * 1024;
+
+    struct ObjChunk {
+        const char* begin;
+        const char* end;
+        std::vector<glm::vec3> positions;
+        std::vector<glm::vec3> normals;
+        std::vector<ObjCorner> corners;
+        //Corners that used negative (relative) indices. Those were resolved against the chunk local counts
+        //and still need the amount of positions/normals declared by the previous chunks added to them.
+        std::vector<uint32_t> relativeVertexCorners;
+        std::vector<uint32_t> relativeNormalCorners;
+        uint32_t lineCount = 0;
+        bool failed = false;
+        uint32_t errorLine = 0;
+        std::string error;
+    };
+
+    static inline bool isSpace(char c) {
+        return c == ' ' || c == '\t';
+    }
+
+    static inline bool isDigit(char c) {
+        return c >= '0' && c <= '9';
+    }
+
+    static inline void skipSpaces(const char*& p, const char* end) {
+        while (p < end && isSpace(*p)) {
+            p++;
+        }
+    }
+
+    static bool parseFloat(const char*& p, const char* end, float& value) {
+        static const double POWERS_OF_TEN[] = {
+                1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10,
+                1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+        };
+        skipSpaces(p, end);
+        bool negative = false;
+        if (p < end && (*p == '-' || *p == '+')) {
+            negative = *p == '-';
+            p++;
+        }
+        uint64_t mantissa = 0;
+        int32_t exponent = 0;
+        int32_t digits = 0;
+        bool anyDigit = false;
+        for (; p < end && isDigit(*p); p++) {
+            anyDigit = true;
+            //A float can't represent more significant digits than this anyway
+            if (digits < 18) {
+                mantissa = mantissa * 10 + (*p - '0');
+                if (mantissa != 0) {
+                    digits++;
+                }
+            } else {
+                exponent++;
+            }
+        }
+        if (p < end && *p == '.') {
+            p++;
+            for (; p < end && isDigit(*p); p++) {
+                anyDigit = true;
+                if (digits < 18) {
+                    mantissa = mantissa * 10 + (*p - '0');
+                    if (mantissa != 0) {
+                        digits++;
+                    }
+                    exponent--;
+                }
+            }
+        }
+        if (!anyDigit) {
+            return false;
+        }
+        if (p < end && (*p == 'e' || *p == 'E')) {
+            p++;
+            bool negativeExponent = false;
+            if (p < end && (*p == '-' || *p == '+')) {
+                negativeExponent = *p == '-';
+                p++;
+            }
+            if (p >= end || !isDigit(*p)) {
+                return false;
+            }
+            int32_t explicitExponent = 0;
+            for (; p < end && isDigit(*p); p++) {
+                if (explicitExponent < 1000) {
+                    explicitExponent = explicitExponent * 10 + (*p - '0');
+                }
+            }
+            exponent += negativeExponent ? -explicitExponent : explicitExponent;
+        }
+        double result = (double) mantissa;
+        if (exponent < 0) {
+            while (exponent < -22) {
+                result /= 1e22;
+                exponent += 22;
+            }
+            result /= POWERS_OF_TEN[-exponent];
+        } else {
+            while (exponent > 22) {
+                result *= 1e22;
+                exponent -= 22;
+            }
+            result *= POWERS_OF_TEN[exponent];
+        }
+        value = (float) (negative ? -result : result);
+        return true;
+    }
+
+    static bool parseInt(const char*& p, const char* end, int32_t& value) {
+        bool negative = false;
+        if (p < end && (*p == '-' || *p == '+')) {
+            negative = *p == '-';
+            p++;
+        }
+        if (p >= end || !isDigit(*p)) {
+            return false;
+        }
+        int64_t result = 0;
+        for (; p < end && isDigit(*p); p++) {
+            result = result * 10 + (*p - '0');
+            if (result > INT32_MAX) {
+                return false;
+            }
+        }
+        value = (int32_t) (negative ? -result : result);
+        return true;
+    }
+
+    static bool parseVec3(const char* p, const char* end, glm::vec3& value) {
+        return parseFloat(p, end, value.x) && parseFloat(p, end, value.y) && parseFloat(p, end, value.z);
+    }
+
+    //Resolves a one based (or negative, relative) OBJ index against the amount of elements declared so far in this chunk.
+    static bool resolveIndex(int32_t index, size_t localCount, int32_t& resolved, bool& relative) {
+        if (index > 0) {
+            resolved = index - 1;
+            relative = false;
+            return true;
+        } else if (index < 0) {
+            //May become negative here, the previous chunks' counts are added while merging
+            resolved = (int32_t) localCount + index;
+            relative = true;
+            return true;
+        }
+        return false;
+    }
+
+    static bool parseFace(const char* p, const char* end, ObjChunk& chunk) {
+        ObjCorner first{}, previous{};
+        bool firstRelativeVertex = false, firstRelativeNormal = false;
+        bool previousRelativeVertex = false, previousRelativeNormal = false;
+        uint32_t cornerCount = 0;
+        while (true) {
+            skipSpaces(p, end);
+            if (p >= end) {
+                break;
+            }
+            int32_t vertexIndex, normalIndex = 0, unusedTexcoordIndex;
+            if (!parseInt(p, end, vertexIndex)) {
+                return false;
+            }
+            if (p < end && *p == '/') {
+                p++;
+                //Texture coordinates aren't used by our vertex format yet
+                if (p < end && *p != '/' && !parseInt(p, end, unusedTexcoordIndex)) {
+                    return false;
+                }
+                if (p < end && *p == '/') {
+                    p++;
+                    if (!parseInt(p, end, normalIndex)) {
+                        return false;
+                    }
+                }
+            }
+            if (p < end && !isSpace(*p)) {
+                return false;
+            }
+
+            ObjCorner corner{};
+            bool relativeVertex = false, relativeNormal = false;
+            if (!resolveIndex(vertexIndex, chunk.positions.size(), corner.vertexIndex, relativeVertex)) {
+                return false;
+            }
+            if (normalIndex == 0) {
+                corner.normalIndex = -1;
+            } else if (!resolveIndex(normalIndex, chunk.normals.size(), corner.normalIndex, relativeNormal)) {
+                return false;
+            }
+
+            if (cornerCount == 0) {
+                first = corner;
+                firstRelativeVertex = relativeVertex;
+                firstRelativeNormal = relativeNormal;
+            } else if (cornerCount >= 2) {
+                //Triangulate polygons as a fan around the first corner
+                const ObjCorner triangle[3] = {first, previous, corner};
+                const bool triangleRelativeVertex[3] = {firstRelativeVertex, previousRelativeVertex, relativeVertex};
+                const bool triangleRelativeNormal[3] = {firstRelativeNormal, previousRelativeNormal, relativeNormal};
+                for (int i = 0; i < 3; i++) {
+                    if (triangleRelativeVertex[i]) {
+                        chunk.relativeVertexCorners.push_back(chunk.corners.size());
+                    }
+                    if (triangleRelativeNormal[i]) {
+                        chunk.relativeNormalCorners.push_back(chunk.corners.size());
+                    }
+                    chunk.corners.push_back(triangle[i]);
+                }
+            }
+            previous = corner;
+            previousRelativeVertex = relativeVertex;
+            previousRelativeNormal = relativeNormal;
+            cornerCount++;
+        }
+        return cornerCount >= 3;
+    }
+
+    static void parseChunk(ObjChunk& chunk) {
+        const char* p = chunk.begin;
+        while (p < chunk.end) {
+            const char* lineEnd = (const char*) memchr(p, '\n', chunk.end - p);
+            if (lineEnd == nullptr) {
+                lineEnd = chunk.end;
+            }
+            const char* next = lineEnd < chunk.end ? lineEnd + 1 : chunk.end;
+            if (lineEnd > p && lineEnd[-1] == '\r') {
+                lineEnd--;
+            }
+            chunk.lineCount++;
+
+            skipSpaces(p, lineEnd);
+            bool valid = true;
+            if (lineEnd - p >= 2 && p[0] == 'v' && isSpace(p[1])) {
+                glm::vec3 position;
+                valid = parseVec3(p + 2, lineEnd, position);
+                chunk.positions.push_back(position);
+            } else if (lineEnd - p >= 3 && p[0] == 'v' && p[1] == 'n' && isSpace(p[2])) {
+                glm::vec3 normal;
+                valid = parseVec3(p + 3, lineEnd, normal);
+                chunk.normals.push_back(normal);
+            } else if (lineEnd - p >= 2 && p[0] == 'f' && isSpace(p[1])) {
+                valid = parseFace(p + 2, lineEnd, chunk);
+            }
+            //Everything else (comments, texture coordinates, groups, materials...) is ignored
+
+            if (!valid) {
+                chunk.failed = true;
+                chunk.errorLine = chunk.lineCount;
+                chunk.error = std::string(p, lineEnd);
+                return;
+            }
+            p = next;
+        }
+    }
+
+    bool ObjParser::parse(const char* data, size_t size, ObjData& result, std::string& error,
+                          ThreadPool* threadPool) {
+        size_t chunkCount = 1;
+        if (threadPool != nullptr) {
+            chunkCount = std::max<size_t>(1, std::min<size_t>(threadPool->getThreadCount(), size / MIN_CHUNK_SIZE));
+        }
+
+        //Split on line boundaries so no record straddles two chunks
+        std::vector<ObjChunk> chunks(chunkCount);
+        const char* dataEnd = data + size;
+        const char* chunkBegin = data;
+        for (size_t i = 0; i < chunkCount; i++) {
+            const char* chunkEnd = i + 1 == chunkCount ? dataEnd : data + (size * (i + 1)) / chunkCount;
+            if (chunkEnd < chunkBegin) {
+                chunkEnd = chunkBegin;
+            }
+            const char* newline = (const char*) memchr(chunkEnd, '\n', dataEnd - chunkEnd);
+            chunkEnd = newline == nullptr ? dataEnd : newline + 1;
+            chunks[i].begin = chunkBegin;
+            chunks[i].end = chunkEnd;
+            //Rough preallocation, most lines of a mesh are either positions, normals or faces
+            size_t estimatedLines = (chunkEnd - chunkBegin) / 32;
+            chunks[i].positions.reserve(estimatedLines / 2);
+            chunks[i].corners.reserve(estimatedLines);
+            chunkBegin = chunkEnd;
+        }
+
+        if (chunkCount == 1) {
+            parseChunk(chunks[0]);
+        } else {
+            //Not finishTasks, concurrent parses share the pool and shouldn't wait for each other's chunks
+            std::vector<std::future<void>> finished;
+            finished.reserve(chunkCount);
+            for (size_t i = 0; i < chunkCount; i++) {
+                ObjChunk* chunk = &chunks[i];
+                auto promise = std::make_shared<std::promise<void>>();
+                finished.push_back(promise->get_future());
+                threadPool->sendTask(i, [chunk, promise]() {
+                    parseChunk(*chunk);
+                    promise->set_value();
+                });
+            }
+            for (std::future<void> &future : finished) {
+                future.wait();
+            }
+        }
+
+        //Merge in file order
+        size_t positionCount = 0, normalCount = 0, cornerCount = 0;
+        uint32_t lineOffset = 0;
+        for (const ObjChunk& chunk : chunks) {
+            if (chunk.failed) {
+                error = "Malformed OBJ record at line " + std::to_string(lineOffset + chunk.errorLine) + ": " +
+                        chunk.error;
+                return false;
+            }
+            positionCount += chunk.positions.size();
+            normalCount += chunk.normals.size();
+            cornerCount += chunk.corners.size();
+            lineOffset += chunk.lineCount;
+        }
+        result.positions.clear();
+        result.normals.clear();
+        result.corners.clear();
+        result.positions.reserve(positionCount);
+        result.normals.reserve(normalCount);
+        result.corners.reserve(cornerCount);
+        for (ObjChunk& chunk : chunks) {
+            const int32_t positionBase = (int32_t) result.positions.size();
+            const int32_t normalBase = (int32_t) result.normals.size();
+            for (uint32_t corner : chunk.relativeVertexCorners) {
+                chunk.corners[corner].vertexIndex += positionBase;
+            }
+            for (uint32_t corner : chunk.relativeNormalCorners) {
+                chunk.corners[corner].normalIndex += normalBase;
+            }
+            result.positions.insert(result.positions.end(), chunk.positions.begin(), chunk.positions.end());
+            result.normals.insert(result.normals.end(), chunk.normals.begin(), chunk.normals.end());
+            result.corners.insert(result.corners.end(), chunk.corners.begin(), chunk.corners.end());
+        }
+
+        for (const ObjCorner& corner : result.corners) {
+            if (corner.vertexIndex < 0 || (size_t) corner.vertexIndex >= positionCount ||
+                corner.normalIndex < -1 || (corner.normalIndex >= 0 && (size_t) corner.normalIndex >= normalCount)) {
+                error = "Face references a vertex or normal that doesn't exist";
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool ObjParser::parseFile(const char* filePath, ObjData& result, std::string& error, ThreadPool* threadPool) {
+        std::ifstream file(filePath, std::ios::binary | std::ios::ate);
+        if (!file) {
+            error = std::string("Failed to open ") + filePath;
+            return false;
+        }
+        size_t fileSize = (size_t) file.tellg();
+        std::vector<char> data(fileSize);
+        file.seekg(0);
+        file.read(data.data(), fileSize);
+        if (!file) {
+            error = std::string("Failed to read ") + filePath;
+            return false;
+        }
+        return parse(data.data(), data.size(), result, error, threadPool);
+    }
+}
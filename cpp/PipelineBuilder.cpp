@@ -1,8 +1,37 @@
 #include "PipelineBuilder.h"
+#include "CullData.h"
 
 namespace tgl {
+    void PipelineBuilder::createDescriptorSetLayout(VkDevice &vkLogicalDevice) {
+        if (vkDescriptorSetLayout != VK_NULL_HANDLE) {
+            return;
+        }
+        //Bindings we specified in the shaders, all storage buffers:
+        //0 per entity object data, 1 entity indices of the visible instances (both read by the vertex shaders),
+        //2 per entity culling input and 3 the indirect draw commands (only used by the culling compute shader)
+        VkDescriptorSetLayoutBinding vkDescriptorSetLayoutBindings[4];
+        for (uint32_t i = 0; i < 4; i++) {
+            vkDescriptorSetLayoutBindings[i].binding = i;
+            vkDescriptorSetLayoutBindings[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+            vkDescriptorSetLayoutBindings[i].descriptorCount = 1;
+            vkDescriptorSetLayoutBindings[i].stageFlags =
+                    i < 2 ? VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_COMPUTE_BIT : VK_SHADER_STAGE_COMPUTE_BIT;
+            vkDescriptorSetLayoutBindings[i].pImmutableSamplers = nullptr;
+        }
+
+        VkDescriptorSetLayoutCreateInfo vkDescriptorSetLayoutCreateInfo;
+        vkDescriptorSetLayoutCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+        vkDescriptorSetLayoutCreateInfo.pNext = nullptr;
+        vkDescriptorSetLayoutCreateInfo.flags = 0;
+        vkDescriptorSetLayoutCreateInfo.bindingCount = 4;
+        vkDescriptorSetLayoutCreateInfo.pBindings = vkDescriptorSetLayoutBindings;
+
+        VK_HANDLE_ERROR(vkCreateDescriptorSetLayout(vkLogicalDevice, &vkDescriptorSetLayoutCreateInfo, nullptr, &vkDescriptorSetLayout),
+                        "Failed to create a descriptor set layout!");
+    }
+
     VkPipeline PipelineBuilder::build(VkDevice &vkLogicalDevice, GPU& gpu, VkRenderPass &vkRenderPass, VkShaderModule &vkVertexShaderModule,
-            VkShaderModule &vkFragmentShaderModule, VkViewport& vkViewport, VkRect2D& vkScissor, VkPrimitiveTopology vkTopology,
+            VkShaderModule &vkFragmentShaderModule, const VertexInputDescription& vertexInputDescription, VkPrimitiveTopology vkTopology,
     VkPolygonMode vkPolygonMode,
             VkCullModeFlags vkCullModeFlags, VkFrontFace vkFrontFace, bool depthTestEnable, bool depthWriteEnable) {
         VkPipelineShaderStageCreateInfo vkPipelineShaderStageVertexCreateInfo{};
@@ -17,12 +46,13 @@ namespace tgl {
         vkPipelineShaderStageFragmentCreateInfo.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
         vkPipelineShaderStageFragmentCreateInfo.module = vkFragmentShaderModule;
 
+        vkShaderStages.clear();
         vkShaderStages.push_back(vkPipelineShaderStageVertexCreateInfo);
         vkShaderStages.push_back(vkPipelineShaderStageFragmentCreateInfo);
 
         vkPipelineVertexInputStateCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-        auto vertexBindingDescriptions = Vertex::getVertexDescription().bindings;
-        auto vertexAttributeDescriptions = Vertex::getVertexDescription().attributes;
+        const auto &vertexBindingDescriptions = vertexInputDescription.bindings;
+        const auto &vertexAttributeDescriptions = vertexInputDescription.attributes;
         vkPipelineVertexInputStateCreateInfo.vertexBindingDescriptionCount = vertexBindingDescriptions.size();
         vkPipelineVertexInputStateCreateInfo.pVertexBindingDescriptions = vertexBindingDescriptions.data();
         vkPipelineVertexInputStateCreateInfo.vertexAttributeDescriptionCount = vertexAttributeDescriptions.size();
@@ -56,12 +86,19 @@ namespace tgl {
                                                              VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
         vkPipelineColorBlendAttachmentState.blendEnable = VK_FALSE;
 
+        //Only the counts, the viewport and scissor themselves are dynamic
         VkPipelineViewportStateCreateInfo vkPipelineViewportStateCreateInfo{};
         vkPipelineViewportStateCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
         vkPipelineViewportStateCreateInfo.scissorCount = 1;
-        vkPipelineViewportStateCreateInfo.pScissors = &vkScissor;
+        vkPipelineViewportStateCreateInfo.pScissors = nullptr;
         vkPipelineViewportStateCreateInfo.viewportCount = 1;
-        vkPipelineViewportStateCreateInfo.pViewports = &vkViewport;
+        vkPipelineViewportStateCreateInfo.pViewports = nullptr;
+
+        const VkDynamicState vkDynamicStates[2] = {VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR};
+        VkPipelineDynamicStateCreateInfo vkPipelineDynamicStateCreateInfo{};
+        vkPipelineDynamicStateCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+        vkPipelineDynamicStateCreateInfo.dynamicStateCount = 2;
+        vkPipelineDynamicStateCreateInfo.pDynamicStates = vkDynamicStates;
 
         VkPipelineColorBlendStateCreateInfo vkPipelineColorBlendStateCreateInfo = {};
         vkPipelineColorBlendStateCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
@@ -77,57 +114,18 @@ namespace tgl {
         vkPushConstantRange.size = sizeof(CameraData);
         vkPushConstantRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;//only accessible in the vertex shader
 
-        VkDescriptorSetLayoutBinding vkDescriptorSetLayoutBinding;
-        vkDescriptorSetLayoutBinding.binding = 0; //Binding we specified in the shader
-        vkDescriptorSetLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-        vkDescriptorSetLayoutBinding.descriptorCount = 1;
-        vkDescriptorSetLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT; //Use in our vertex shader
-        vkDescriptorSetLayoutBinding.pImmutableSamplers = nullptr;
-
-
-        VkDescriptorPoolSize vkDescriptorPoolSize;
-        //TODO Adjust the descriptor count
-        vkDescriptorPoolSize.descriptorCount = 2;
-        vkDescriptorPoolSize.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-
-        VkDescriptorPoolSize vkSamplerPoolSize;
-        vkSamplerPoolSize.type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-        vkSamplerPoolSize.descriptorCount = 1;
+        if (vkPipelineLayout == VK_NULL_HANDLE) {
+            createDescriptorSetLayout(vkLogicalDevice);
 
-        std::vector<VkDescriptorPoolSize> vkDescriptorPoolSizes;
-        vkDescriptorPoolSizes.push_back(vkDescriptorPoolSize);
-        vkDescriptorPoolSizes.push_back(vkSamplerPoolSize);
+            VkPipelineLayoutCreateInfo vkPipelineLayoutCreateInfo{};
+            vkPipelineLayoutCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+            vkPipelineLayoutCreateInfo.pushConstantRangeCount = 1;
+            vkPipelineLayoutCreateInfo.pPushConstantRanges = &vkPushConstantRange;
+            vkPipelineLayoutCreateInfo.setLayoutCount = 1;
+            vkPipelineLayoutCreateInfo.pSetLayouts = &vkDescriptorSetLayout;
 
-        VkDescriptorPoolCreateInfo vkDescriptorPoolCreateInfo;
-        vkDescriptorPoolCreateInfo.pNext = nullptr;
-        vkDescriptorPoolCreateInfo.flags = 0;
-        vkDescriptorPoolCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
-        vkDescriptorPoolCreateInfo.maxSets = 2; //One set
-        vkDescriptorPoolCreateInfo.poolSizeCount = vkDescriptorPoolSizes.size();
-        vkDescriptorPoolCreateInfo.pPoolSizes = vkDescriptorPoolSizes.data();
-
-        VK_HANDLE_ERROR(
-                vkCreateDescriptorPool(vkLogicalDevice, &vkDescriptorPoolCreateInfo, nullptr, &vkDescriptorPool),
-                "Failed to create a descriptor pool!");
-
-        VkDescriptorSetLayoutCreateInfo vkDescriptorSetLayoutCreateInfo;
-        vkDescriptorSetLayoutCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
-        vkDescriptorSetLayoutCreateInfo.pNext = nullptr;
-        vkDescriptorSetLayoutCreateInfo.flags = 0;
-        vkDescriptorSetLayoutCreateInfo.bindingCount = 1;
-        vkDescriptorSetLayoutCreateInfo.pBindings = &vkDescriptorSetLayoutBinding;
-
-        VK_HANDLE_ERROR(vkCreateDescriptorSetLayout(vkLogicalDevice, &vkDescriptorSetLayoutCreateInfo, nullptr, &vkDescriptorSetLayout),
-                        "Failed to create a descriptor set layout!");
-
-        VkPipelineLayoutCreateInfo vkPipelineLayoutCreateInfo{};
-        vkPipelineLayoutCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-        vkPipelineLayoutCreateInfo.pushConstantRangeCount = 1;
-        vkPipelineLayoutCreateInfo.pPushConstantRanges = &vkPushConstantRange;
-        vkPipelineLayoutCreateInfo.setLayoutCount = 1;
-        vkPipelineLayoutCreateInfo.pSetLayouts = &vkDescriptorSetLayout;
-
-        VK_HANDLE_ERROR(vkCreatePipelineLayout(vkLogicalDevice, &vkPipelineLayoutCreateInfo, nullptr, &vkPipelineLayout), "Failed to create a pipeline layout!");
+            VK_HANDLE_ERROR(vkCreatePipelineLayout(vkLogicalDevice, &vkPipelineLayoutCreateInfo, nullptr, &vkPipelineLayout), "Failed to create a pipeline layout!");
+        }
 
 
 
@@ -155,21 +153,43 @@ namespace tgl {
         vkGraphicsPipelineCreateInfo.pColorBlendState = &vkPipelineColorBlendStateCreateInfo;
         vkGraphicsPipelineCreateInfo.layout = vkPipelineLayout;
         vkGraphicsPipelineCreateInfo.pDepthStencilState = &vkPipelineDepthStencilStateCreateInfo;
+        vkGraphicsPipelineCreateInfo.pDynamicState = &vkPipelineDynamicStateCreateInfo;
 
         VkPipeline vkPipeline;
-        VK_HANDLE_ERROR(vkCreateGraphicsPipelines(vkLogicalDevice, VK_NULL_HANDLE, 1, &vkGraphicsPipelineCreateInfo, nullptr, &vkPipeline), "Failed to create the graphics pipeline!");
+        VK_HANDLE_ERROR(vkCreateGraphicsPipelines(vkLogicalDevice, vkPipelineCache, 1, &vkGraphicsPipelineCreateInfo, nullptr, &vkPipeline), "Failed to create the graphics pipeline!");
         return vkPipeline;
     }
 
-    void PipelineBuilder::allocateDescriptorSets(VkDevice& vkLogicalDevice, VkDescriptorSet *vkDescriptorSet) {
-        VkDescriptorSetAllocateInfo  vkDescriptorSetAllocateInfo{};
-        vkDescriptorSetAllocateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
-        vkDescriptorSetAllocateInfo.pNext = nullptr;
-        vkDescriptorSetAllocateInfo.descriptorPool = vkDescriptorPool;
-        vkDescriptorSetAllocateInfo.descriptorSetCount = 1;
-        vkDescriptorSetAllocateInfo.pSetLayouts = &vkDescriptorSetLayout;
-        VK_HANDLE_ERROR(
-                vkAllocateDescriptorSets(vkLogicalDevice, &vkDescriptorSetAllocateInfo, vkDescriptorSet),
-                "Failed to allocate a descriptor set!");
+    VkPipeline PipelineBuilder::buildCompute(VkDevice &vkLogicalDevice, VkShaderModule &vkComputeShaderModule) {
+        createDescriptorSetLayout(vkLogicalDevice);
+        if (vkComputePipelineLayout == VK_NULL_HANDLE) {
+            VkPushConstantRange vkPushConstantRange{};
+            vkPushConstantRange.offset = 0;
+            vkPushConstantRange.size = sizeof(CullConstants);
+            vkPushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+            VkPipelineLayoutCreateInfo vkPipelineLayoutCreateInfo{};
+            vkPipelineLayoutCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+            vkPipelineLayoutCreateInfo.pushConstantRangeCount = 1;
+            vkPipelineLayoutCreateInfo.pPushConstantRanges = &vkPushConstantRange;
+            vkPipelineLayoutCreateInfo.setLayoutCount = 1;
+            vkPipelineLayoutCreateInfo.pSetLayouts = &vkDescriptorSetLayout;
+
+            VK_HANDLE_ERROR(vkCreatePipelineLayout(vkLogicalDevice, &vkPipelineLayoutCreateInfo, nullptr, &vkComputePipelineLayout),
+                            "Failed to create a compute pipeline layout!");
+        }
+
+        VkComputePipelineCreateInfo vkComputePipelineCreateInfo{};
+        vkComputePipelineCreateInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+        vkComputePipelineCreateInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+        vkComputePipelineCreateInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+        vkComputePipelineCreateInfo.stage.module = vkComputeShaderModule;
+        vkComputePipelineCreateInfo.stage.pName = "main"; //Entry point
+        vkComputePipelineCreateInfo.layout = vkComputePipelineLayout;
+
+        VkPipeline vkPipeline;
+        VK_HANDLE_ERROR(vkCreateComputePipelines(vkLogicalDevice, vkPipelineCache, 1, &vkComputePipelineCreateInfo, nullptr, &vkPipeline),
+                        "Failed to create a compute pipeline!");
+        return vkPipeline;
     }
 }
\ No newline at end of file
@@ -0,0 +1,115 @@
+#include "PipelineCache.h"
+#include <cstring>
+#include <cstdio>
+#include <fstream>
+#include <thread>
+#include <vector>
+#include <unistd.h>
+
+namespace tgl {
+    //Drivers are only required to reject blobs of another device gracefully, some crash on them instead. Checking
+    //the header first also gives a log line saying why the cache went cold, e.g. after a driver update.
+    static bool isCompatible(const std::vector<uint8_t>& data, const VkPhysicalDeviceProperties& vkPhysicalDeviceProperties,
+                             const std::string& cachePath) {
+        if (data.size() < PipelineCache::HEADER_SIZE) {
+            WARN("Ignoring the truncated pipeline cache " << cachePath);
+            return false;
+        }
+        uint32_t headerSize;
+        uint32_t headerVersion;
+        uint32_t vendorID;
+        uint32_t deviceID;
+        memcpy(&headerSize, data.data(), sizeof(uint32_t));
+        memcpy(&headerVersion, data.data() + 4, sizeof(uint32_t));
+        memcpy(&vendorID, data.data() + 8, sizeof(uint32_t));
+        memcpy(&deviceID, data.data() + 12, sizeof(uint32_t));
+        if (headerSize < PipelineCache::HEADER_SIZE || headerSize > data.size() ||
+            headerVersion != VK_PIPELINE_CACHE_HEADER_VERSION_ONE) {
+            WARN("Ignoring the pipeline cache " << cachePath << " with an unknown header");
+            return false;
+        }
+        if (vendorID != vkPhysicalDeviceProperties.vendorID || deviceID != vkPhysicalDeviceProperties.deviceID) {
+            INFO("Ignoring the pipeline cache " << cachePath << " of another GPU");
+            return false;
+        }
+        if (memcmp(data.data() + 16, vkPhysicalDeviceProperties.pipelineCacheUUID, VK_UUID_SIZE) != 0) {
+            INFO("Ignoring the pipeline cache " << cachePath << " of another driver version");
+            return false;
+        }
+        return true;
+    }
+
+    VkPipelineCache PipelineCache::load(VkDevice vkLogicalDevice, const VkPhysicalDeviceProperties& vkPhysicalDeviceProperties,
+                                        const std::string& cachePath, bool& warm) {
+        std::vector<uint8_t> data;
+        std::ifstream input(cachePath, std::ios::binary | std::ios::ate);
+        if (input) {
+            std::streamsize size = input.tellg();
+            input.seekg(0);
+            data.resize(size > 0 ? (size_t) size : 0);
+            if (!input.read((char*) data.data(), (std::streamsize) data.size())) {
+                WARN("Failed to read the pipeline cache " << cachePath);
+                data.clear();
+            } else if (!isCompatible(data, vkPhysicalDeviceProperties, cachePath)) {
+                data.clear();
+            }
+        }
+        warm = !data.empty();
+
+        VkPipelineCacheCreateInfo vkPipelineCacheCreateInfo{};
+        vkPipelineCacheCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+        vkPipelineCacheCreateInfo.initialDataSize = data.size();
+        vkPipelineCacheCreateInfo.pInitialData = data.empty() ? nullptr : data.data();
+        VkPipelineCache vkPipelineCache = VK_NULL_HANDLE;
+        VkResult result = vkCreatePipelineCache(vkLogicalDevice, &vkPipelineCacheCreateInfo, nullptr, &vkPipelineCache);
+        if (result != VK_SUCCESS && warm) {
+            //The driver refused the blob after all, start cold rather than without a cache
+            WARN("The driver rejected the pipeline cache " << cachePath);
+            warm = false;
+            vkPipelineCacheCreateInfo.initialDataSize = 0;
+            vkPipelineCacheCreateInfo.pInitialData = nullptr;
+            result = vkCreatePipelineCache(vkLogicalDevice, &vkPipelineCacheCreateInfo, nullptr, &vkPipelineCache);
+        }
+        VK_HANDLE_ERROR(result, "Failed to create the pipeline cache!");
+        return vkPipelineCache;
+    }
+
+    bool PipelineCache::store(VkDevice vkLogicalDevice, VkPipelineCache vkPipelineCache, const std::string& cachePath) {
+        size_t size = 0;
+        if (vkGetPipelineCacheData(vkLogicalDevice, vkPipelineCache, &size, nullptr) != VK_SUCCESS || size == 0) {
+            WARN("Failed to retrieve the pipeline cache data");
+            return false;
+        }
+        std::vector<uint8_t> data(size);
+        //VK_INCOMPLETE would mean a truncated blob, which is not worth storing
+        if (vkGetPipelineCacheData(vkLogicalDevice, vkPipelineCache, &size, data.data()) != VK_SUCCESS) {
+            WARN("Failed to retrieve the pipeline cache data");
+            return false;
+        }
+        data.resize(size);
+
+        //Write to a temporary file first so a crash or a concurrent run never leaves a half written cache
+        std::string temporaryPath = cachePath + ".tmp" + std::to_string(getpid()) + "." +
+                                    std::to_string(std::hash<std::thread::id>()(std::this_thread::get_id()));
+        {
+            std::ofstream output(temporaryPath, std::ios::binary | std::ios::trunc);
+            if (!output) {
+                WARN("Failed to write the pipeline cache " << cachePath);
+                return false;
+            }
+            output.write((const char*) data.data(), (std::streamsize) data.size());
+            if (!output) {
+                output.close();
+                remove(temporaryPath.c_str());
+                WARN("Failed to write the pipeline cache " << cachePath);
+                return false;
+            }
+        }
+        if (rename(temporaryPath.c_str(), cachePath.c_str()) != 0) {
+            remove(temporaryPath.c_str());
+            WARN("Failed to write the pipeline cache " << cachePath);
+            return false;
+        }
+        return true;
+    }
+}
@@ -0,0 +1,98 @@
+#include "RenderQueue.h"
+#include <algorithm>
+#include <cstring>
+
+namespace tgl {
+    uint32_t BindCounters::getIssued() const {
+        return pipelineBinds + descriptorSetBinds + vertexBufferBinds + indexBufferBinds;
+    }
+
+    uint32_t BindCounters::getSkipped() const {
+        return pipelineBindsSkipped + descriptorSetBindsSkipped + vertexBufferBindsSkipped + indexBufferBindsSkipped;
+    }
+
+    BindCounters &BindCounters::operator+=(const BindCounters &other) {
+        pipelineBinds += other.pipelineBinds;
+        pipelineBindsSkipped += other.pipelineBindsSkipped;
+        descriptorSetBinds += other.descriptorSetBinds;
+        descriptorSetBindsSkipped += other.descriptorSetBindsSkipped;
+        vertexBufferBinds += other.vertexBufferBinds;
+        vertexBufferBindsSkipped += other.vertexBufferBindsSkipped;
+        indexBufferBinds += other.indexBufferBinds;
+        indexBufferBindsSkipped += other.indexBufferBindsSkipped;
+        return *this;
+    }
+
+    uint64_t RenderQueue::makeKey(uint32_t pass, uint32_t pipeline, uint32_t material, uint32_t mesh, uint32_t lod,
+                                  float depth) {
+        const uint32_t depthMax = (1U << DEPTH_BITS) - 1;
+        const uint32_t quantizedDepth = (uint32_t) (std::min(std::max(depth, 0.0F), 1.0F) * (float) depthMax);
+        uint64_t key = pass & ((1U << PASS_BITS) - 1);
+        key = (key << PIPELINE_BITS) | (pipeline & ((1U << PIPELINE_BITS) - 1));
+        key = (key << MATERIAL_BITS) | (material & ((1U << MATERIAL_BITS) - 1));
+        key = (key << MESH_BITS) | (mesh & ((1U << MESH_BITS) - 1));
+        key = (key << LOD_BITS) | (lod & ((1U << LOD_BITS) - 1));
+        return (key << DEPTH_BITS) | quantizedDepth;
+    }
+
+    void RenderQueue::clear() {
+        packets.clear();
+    }
+
+    void RenderQueue::reserve(size_t count) {
+        packets.reserve(count);
+    }
+
+    void RenderQueue::push(uint64_t key, uint32_t entityIndex) {
+        packets.push_back({key, entityIndex});
+    }
+
+    void RenderQueue::sort() {
+        const size_t count = packets.size();
+        if (count < 2) {
+            return;
+        }
+        //Histograms of all eight bytes in a single read of the keys
+        uint32_t histograms[8][256];
+        memset(histograms, 0, sizeof(histograms));
+        for (const DrawPacket &packet : packets) {
+            for (uint32_t byte = 0; byte < 8; byte++) {
+                histograms[byte][(packet.key >> (byte * 8)) & 0xFF]++;
+            }
+        }
+
+        sortBuffer.resize(count);
+        DrawPacket *source = packets.data();
+        DrawPacket *destination = sortBuffer.data();
+        for (uint32_t byte = 0; byte < 8; byte++) {
+            uint32_t *histogram = histograms[byte];
+            const uint32_t shift = byte * 8;
+            //All keys share this byte, the pass wouldn't move anything
+            if (histogram[(source[0].key >> shift) & 0xFF] == count) {
+                continue;
+            }
+            uint32_t offset = 0;
+            for (uint32_t bucket = 0; bucket < 256; bucket++) {
+                const uint32_t bucketCount = histogram[bucket];
+                histogram[bucket] = offset;
+                offset += bucketCount;
+            }
+            for (size_t i = 0; i < count; i++) {
+                destination[histogram[(source[i].key >> shift) & 0xFF]++] = source[i];
+            }
+            std::swap(source, destination);
+        }
+        //An odd number of passes left the result in the sort buffer
+        if (source != packets.data()) {
+            packets.swap(sortBuffer);
+        }
+    }
+
+    size_t RenderQueue::size() const {
+        return packets.size();
+    }
+
+    const DrawPacket &RenderQueue::operator[](size_t index) const {
+        return packets[index];
+    }
+}
@@ -7,24 +7,36 @@ namespace tgl {
         this->frames = new FrameData[bufferingAmount];
     }
 
+    Renderer::Renderer(uint32_t width, uint32_t height, unsigned int bufferingAmount)
+            : headlessWindow("TGL Headless", (int) width, (int) height) {
+        this->window = &headlessWindow;
+        this->headless = true;
+        this->bufferingAmount = bufferingAmount;
+        this->frames = new FrameData[bufferingAmount];
+    }
+
     Renderer::~Renderer() {
         delete[] frames;
     }
 
     void Renderer::prepareVulkan() {
-        if (!window->hasCreated()) {
-            window->create();
+        uint32_t glfwExtensionCount = 0;
+        const char **glfwExtensions = nullptr;
+        //Headless instances need neither a window nor the surface extensions
+        if (!headless) {
+            if (!window->hasCreated()) {
+                window->create();
+            }
+            glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
         }
 
-        uint32_t glfwExtensionCount;
-        auto glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
-
         vkb::InstanceBuilder builder;
 
         //make the Vulkan instance, with basic debug features
         builder = builder.set_app_name("TGL Application")
                 .request_validation_layers(true)
                 .require_api_version(1, 0, 0)
+                .set_headless(headless)
                 .use_default_debug_messenger();
         std::cout << "COUNT: " << glfwExtensionCount << std::endl;
         for (int i = 0; i < glfwExtensionCount; i++) {
@@ -41,15 +53,17 @@ namespace tgl {
             //store the debug messenger
             vkDebugUtilsMessenger = vkb_inst.debug_messenger;
 
-            VK_HANDLE_ERROR(glfwCreateWindowSurface(vkInstance, window->glfwWindow, nullptr, &vkSurface),
-                            "Failed to create a window surface!");
-
             VkPhysicalDeviceFeatures vkPhysicalDeviceFeatures{};
             vkPhysicalDeviceFeatures.samplerAnisotropy = VK_TRUE;
             vkPhysicalDeviceFeatures.sampleRateShading = VK_TRUE;
             vkb::PhysicalDeviceSelector physicalDeviceSelector(vkb_inst);
+            //Without a surface the selector doesn't require presentation support, so CPU drivers like lavapipe qualify
+            if (!headless) {
+                VK_HANDLE_ERROR(glfwCreateWindowSurface(vkInstance, window->glfwWindow, nullptr, &vkSurface),
+                                "Failed to create a window surface!");
+                physicalDeviceSelector.set_surface(vkSurface);
+            }
             auto phys_ret = physicalDeviceSelector
-                    .set_surface(vkSurface)
                     .set_desired_version(1, 0)
                     .set_required_features(vkPhysicalDeviceFeatures)
                     .select();
@@ -59,13 +73,29 @@ namespace tgl {
                 ERROR("Failed to find a supported GPU!");
             }
 
+            //Optional features of GPU culling, enabled if supported
+            vkb::PhysicalDevice vkbPhysicalDevice = phys_ret.value();
+            drawIndirectFirstInstanceSupported = gpu.vkPhysicalDeviceFeatures.drawIndirectFirstInstance == VK_TRUE;
+            multiDrawIndirectSupported = gpu.vkPhysicalDeviceFeatures.multiDrawIndirect == VK_TRUE;
+            vkbPhysicalDevice.features.drawIndirectFirstInstance = gpu.vkPhysicalDeviceFeatures.drawIndirectFirstInstance;
+            vkbPhysicalDevice.features.multiDrawIndirect = gpu.vkPhysicalDeviceFeatures.multiDrawIndirect;
+
             //Create logical device
-            vkb::DeviceBuilder vkbLogicalDeviceBuilder(phys_ret.value());
+            vkb::DeviceBuilder vkbLogicalDeviceBuilder(vkbPhysicalDevice);
             vkb::Device vkbLogicalDevice = vkbLogicalDeviceBuilder
                     .build().value();
             vkLogicalDevice = vkbLogicalDevice.device;
             vkGraphicsQueue = vkbLogicalDevice.get_queue(vkb::QueueType::graphics).value();
             vkGraphicsQueueFamilyIndex = vkbLogicalDevice.get_queue_index(vkb::QueueType::graphics).value();
+            //Uploads overlap rendering on a transfer only queue family, if there is none they share the graphics queue
+            auto transferQueue = vkbLogicalDevice.get_dedicated_queue(vkb::QueueType::transfer);
+            if (transferQueue.has_value()) {
+                vkTransferQueue = transferQueue.value();
+                vkTransferQueueFamilyIndex = vkbLogicalDevice.get_dedicated_queue_index(vkb::QueueType::transfer).value();
+            } else {
+                vkTransferQueue = vkGraphicsQueue;
+                vkTransferQueueFamilyIndex = vkGraphicsQueueFamilyIndex;
+            }
             VmaAllocatorCreateInfo vmaAllocatorCreateInfo{};
             vmaAllocatorCreateInfo.instance = vkInstance;
             vmaAllocatorCreateInfo.device = vkLogicalDevice;
@@ -77,11 +107,22 @@ namespace tgl {
     }
 
     void Renderer::initSwapchain() {
+        uint32_t vkPresentModeCount;
+        vkGetPhysicalDeviceSurfacePresentModesKHR(gpu.vkPhysicalDevice, vkSurface, &vkPresentModeCount, nullptr);
+        std::vector<VkPresentModeKHR> vkPresentModes(vkPresentModeCount);
+        vkGetPhysicalDeviceSurfacePresentModesKHR(gpu.vkPhysicalDevice, vkSurface, &vkPresentModeCount,
+                                                  vkPresentModes.data());
+        vkPresentMode = VkUtils::getOptimalPresentMode(vkPresentModes, presentMode);
+        if (vkPresentMode != presentMode) {
+            WARN("Present mode " << presentMode << " is not supported, using " << vkPresentMode << " instead");
+        }
+
         vkb::SwapchainBuilder vkbSwapchainBuilder{gpu.vkPhysicalDevice, vkLogicalDevice, vkSurface};
         auto vkbSwapchainOpt = vkbSwapchainBuilder
                 .use_default_format_selection()
-                .set_desired_present_mode(VK_PRESENT_MODE_MAILBOX_KHR)
+                .set_desired_present_mode(vkPresentMode)
                 .set_desired_extent(window->width, window->height)
+                .set_old_swapchain(vkSwapchain)
                 .build();
         if (vkbSwapchainOpt.has_value()) {
             auto vkbSwapchain = vkbSwapchainOpt.value();
@@ -90,35 +131,115 @@ namespace tgl {
             vkSwapchainImageViews = vkbSwapchain.get_image_views().value();
             vkSwapchainImageFormat = vkbSwapchain.image_format;
             vkWindowExtent = vkbSwapchain.extent;
+            vkImagesInFlight.assign(vkSwapchainImages.size(), VK_NULL_HANDLE);
+        } else {
+            ERROR("Failed to create a swapchain! Error: " << vkbSwapchainOpt.error());
+        }
+    }
 
-            VkImageCreateInfo vkImageCreateInfo{};
-            vkImageCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
-            vkImageCreateInfo.imageType = VK_IMAGE_TYPE_2D;
-            vkImageCreateInfo.format = VK_FORMAT_D32_SFLOAT;
-            vkImageCreateInfo.extent = {vkWindowExtent.width, vkWindowExtent.height, 1};
-            vkImageCreateInfo.mipLevels = 1;
-            vkImageCreateInfo.arrayLayers = 1;
-            vkImageCreateInfo.samples = VkUtils::getMaxUsableSampleCount(gpu);
-            vkImageCreateInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
-            vkImageCreateInfo.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
-
-            VmaAllocationCreateInfo depthImageAllocationCreateInfo{};
-            depthImageAllocationCreateInfo.usage = VMA_MEMORY_USAGE_GPU_ONLY;
-            depthImageAllocationCreateInfo.flags = VkMemoryPropertyFlags(VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-            VK_HANDLE_ERROR(
-                    vmaCreateImage(allocator, &vkImageCreateInfo, &depthImageAllocationCreateInfo, &depthImage.image,
-                                   &depthImage.allocation, nullptr),
-                    "Failed to create the depth image!");
-
-            VkUtils::createImageView(vkLogicalDevice, depthImage.image, VK_FORMAT_D32_SFLOAT, VK_IMAGE_ASPECT_DEPTH_BIT,
-                                     &depthImageView);
+    void Renderer::initOffscreenTargets() {
+        //One color image per frame in flight takes the place of the swapchain images, frame i always renders to image
+        //i. RGBA so read back pixels don't need swizzling.
+        vkSwapchainImageFormat = VK_FORMAT_R8G8B8A8_UNORM;
+        vkWindowExtent = {(uint32_t) window->width, (uint32_t) window->height};
+        VkImageCreateInfo vkImageCreateInfo{};
+        vkImageCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+        vkImageCreateInfo.imageType = VK_IMAGE_TYPE_2D;
+        vkImageCreateInfo.format = vkSwapchainImageFormat;
+        vkImageCreateInfo.extent = {vkWindowExtent.width, vkWindowExtent.height, 1};
+        vkImageCreateInfo.mipLevels = 1;
+        vkImageCreateInfo.arrayLayers = 1;
+        vkImageCreateInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+        vkImageCreateInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+        vkImageCreateInfo.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
 
+        VmaAllocationCreateInfo vmaAllocationCreateInfo{};
+        vmaAllocationCreateInfo.usage = VMA_MEMORY_USAGE_GPU_ONLY;
+        const VkDeviceSize readbackSize = (VkDeviceSize) vkWindowExtent.width * vkWindowExtent.height * 4;
+        offscreenImages.resize(bufferingAmount);
+        vkSwapchainImages.resize(bufferingAmount);
+        vkSwapchainImageViews.resize(bufferingAmount);
+        for (uint32_t i = 0; i < bufferingAmount; i++) {
+            VK_HANDLE_ERROR(vmaCreateImage(allocator, &vkImageCreateInfo, &vmaAllocationCreateInfo,
+                                           &offscreenImages[i].image, &offscreenImages[i].allocation, nullptr),
+                            "Failed to create an offscreen color image!");
+            vkSwapchainImages[i] = offscreenImages[i].image;
+            VkUtils::createImageView(vkLogicalDevice, vkSwapchainImages[i], vkSwapchainImageFormat,
+                                     VK_IMAGE_ASPECT_COLOR_BIT, &vkSwapchainImageViews[i]);
+
+            //The frame's staging slot, the GPU copies the frame into it and the CPU reads it once the fence signaled
+            VkUtils::createBuffer(allocator, frames[i].readbackBuffer.allocation, frames[i].readbackBuffer.vkBuffer,
+                                  readbackSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT, VMA_MEMORY_USAGE_GPU_TO_CPU);
             DeletionQueue::queue([=]() {
-                vkDestroyImageView(vkLogicalDevice, depthImageView, nullptr);
-                vmaDestroyImage(allocator, depthImage.image, depthImage.allocation);
+                vmaDestroyBuffer(allocator, frames[i].readbackBuffer.vkBuffer, frames[i].readbackBuffer.allocation);
             });
-        } else {
-            ERROR("Failed to create a swapchain! Error: " << vkbSwapchainOpt.error());
+        }
+        vkImagesInFlight.assign(vkSwapchainImages.size(), VK_NULL_HANDLE);
+    }
+
+    void Renderer::initDepthImage() {
+        VkImageCreateInfo vkImageCreateInfo{};
+        vkImageCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+        vkImageCreateInfo.imageType = VK_IMAGE_TYPE_2D;
+        vkImageCreateInfo.format = VK_FORMAT_D32_SFLOAT;
+        vkImageCreateInfo.extent = {vkWindowExtent.width, vkWindowExtent.height, 1};
+        vkImageCreateInfo.mipLevels = 1;
+        vkImageCreateInfo.arrayLayers = 1;
+        vkImageCreateInfo.samples = VkUtils::getMaxUsableSampleCount(gpu);
+        vkImageCreateInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+        vkImageCreateInfo.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+
+        VmaAllocationCreateInfo depthImageAllocationCreateInfo{};
+        depthImageAllocationCreateInfo.usage = VMA_MEMORY_USAGE_GPU_ONLY;
+        depthImageAllocationCreateInfo.flags = VkMemoryPropertyFlags(VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+        VK_HANDLE_ERROR(
+                vmaCreateImage(allocator, &vkImageCreateInfo, &depthImageAllocationCreateInfo, &depthImage.image,
+                               &depthImage.allocation, nullptr),
+                "Failed to create the depth image!");
+
+        VkUtils::createImageView(vkLogicalDevice, depthImage.image, VK_FORMAT_D32_SFLOAT, VK_IMAGE_ASPECT_DEPTH_BIT,
+                                 &depthImageView);
+    }
+
+    bool Renderer::updateSwapchain() {
+        int width, height;
+        glfwGetFramebufferSize(window->glfwWindow, &width, &height);
+        //Minimized, there is no swapchain with an empty extent
+        if (width == 0 || height == 0) {
+            return false;
+        }
+        if (swapchainOutdated || (uint32_t) width != vkWindowExtent.width ||
+            (uint32_t) height != vkWindowExtent.height) {
+            window->width = width;
+            window->height = height;
+            recreateSwapchain();
+        }
+        return true;
+    }
+
+    void Renderer::recreateSwapchain() {
+        //Frames in flight may still render to or present the old images, so the old resources are retired instead of
+        //waiting for the device to become idle. The render pass and pipelines don't depend on the size.
+        retiredSwapchains.push_back({vkSwapchain, vkSwapchainImageViews, vkFramebuffers, depthImage, depthImageView,
+                                     frameCount});
+        initSwapchain();
+        initDepthImage();
+        initFramebuffers();
+        swapchainOutdated = false;
+    }
+
+    void Renderer::destroySwapchainResources(const RetiredSwapchain &swapchain) {
+        for (VkFramebuffer vkFramebuffer : swapchain.vkFramebuffers) {
+            vkDestroyFramebuffer(vkLogicalDevice, vkFramebuffer, nullptr);
+        }
+        for (VkImageView vkImageView : swapchain.vkImageViews) {
+            vkDestroyImageView(vkLogicalDevice, vkImageView, nullptr);
+        }
+        vkDestroyImageView(vkLogicalDevice, swapchain.depthImageView, nullptr);
+        vmaDestroyImage(allocator, swapchain.depthImage.image, swapchain.depthImage.allocation);
+        //Headless renderers have none
+        if (swapchain.vkSwapchain != VK_NULL_HANDLE) {
+            vkDestroySwapchainKHR(vkLogicalDevice, swapchain.vkSwapchain, nullptr);
         }
     }
 
@@ -170,8 +291,9 @@ namespace tgl {
 
         //we don't know or care about the starting layout of the attachment
         vkColorAttachmentDescription.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-        //after the renderpass ends, the image has to be on a layout ready for display
-        vkColorAttachmentDescription.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+        //after the renderpass ends, the image has to be on a layout ready for display, or for the readback copy
+        vkColorAttachmentDescription.finalLayout =
+                headless ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
 
         VkAttachmentReference vkColorAttachmentRef{};
         vkColorAttachmentRef.attachment = 0;
@@ -202,12 +324,41 @@ namespace tgl {
         attachments.push_back(vkColorAttachmentDescription);
         attachments.push_back(vkDepthAttachmentDescription);
 
+        //The submit waits for the acquired image at the color attachment output stage, the image's layout transition
+        //has to wait for that stage as well
+        VkSubpassDependency vkSubpassDependencies[3]{};
+        vkSubpassDependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
+        vkSubpassDependencies[0].dstSubpass = 0;
+        vkSubpassDependencies[0].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+        vkSubpassDependencies[0].srcAccessMask = 0;
+        vkSubpassDependencies[0].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+        vkSubpassDependencies[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+        //Every frame in flight renders to the same depth image, a frame's clear waits for the previous frame's tests
+        vkSubpassDependencies[1].srcSubpass = VK_SUBPASS_EXTERNAL;
+        vkSubpassDependencies[1].dstSubpass = 0;
+        vkSubpassDependencies[1].srcStageMask =
+                VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+        vkSubpassDependencies[1].srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+        vkSubpassDependencies[1].dstStageMask =
+                VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+        vkSubpassDependencies[1].dstAccessMask =
+                VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+        //Headless frames are copied out for readback after the render pass
+        vkSubpassDependencies[2].srcSubpass = 0;
+        vkSubpassDependencies[2].dstSubpass = VK_SUBPASS_EXTERNAL;
+        vkSubpassDependencies[2].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+        vkSubpassDependencies[2].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+        vkSubpassDependencies[2].dstStageMask = VK_PIPELINE_STAGE_TRANSFER_BIT;
+        vkSubpassDependencies[2].dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+
         VkRenderPassCreateInfo vkRenderPassCreateInfo{};
         vkRenderPassCreateInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
         vkRenderPassCreateInfo.attachmentCount = attachments.size();
         vkRenderPassCreateInfo.pAttachments = attachments.data();
         vkRenderPassCreateInfo.subpassCount = 1;
         vkRenderPassCreateInfo.pSubpasses = &subpassDescription;
+        vkRenderPassCreateInfo.dependencyCount = headless ? 3 : 2;
+        vkRenderPassCreateInfo.pDependencies = vkSubpassDependencies;
         VK_HANDLE_ERROR(vkCreateRenderPass(vkLogicalDevice, &vkRenderPassCreateInfo, nullptr, &vkRenderPass),
                         "Failed to create a renderpass!");
     }
@@ -264,42 +415,61 @@ namespace tgl {
     }
 
     void Renderer::initPipeline() {
-        VkViewport vkViewport{};
-        vkViewport.x = 0;
-        vkViewport.y = 0;
-        vkViewport.width = vkWindowExtent.width;
-        vkViewport.height = vkWindowExtent.height;
-        vkViewport.minDepth = 0.0F;
-        vkViewport.maxDepth = 1.0F;
-        VkRect2D vkScissor{};
-        vkScissor.extent = vkWindowExtent;
-        vkScissor.offset.x = 0;
-        vkScissor.offset.y = 0;
+        auto start = std::chrono::steady_clock::now();
+        if (!pipelineCachePath.empty()) {
+            vkPipelineCache = PipelineCache::load(vkLogicalDevice, gpu.vkPhysicalDeviceProperties, pipelineCachePath,
+                                                  pipelineCacheWarm);
+        }
+        pipelineBuilder.vkPipelineCache = vkPipelineCache;
 
         std::vector<uint32_t> vertexShaderCode = VkUtils::readFile("../resources/shaders/vert.spv");
         vkVertexShaderModule = VkUtils::createShaderModule(vkLogicalDevice, vertexShaderCode);
 
+        std::vector<uint32_t> packedVertexShaderCode = VkUtils::readFile("../resources/shaders/packedVert.spv");
+        vkPackedVertexShaderModule = VkUtils::createShaderModule(vkLogicalDevice, packedVertexShaderCode);
+
         std::vector<uint32_t> fragmentShaderCode = VkUtils::readFile("../resources/shaders/frag.spv");
         vkFragmentShaderModule = VkUtils::createShaderModule(vkLogicalDevice, fragmentShaderCode);
 
         vkPipeline = pipelineBuilder.build(vkLogicalDevice, gpu, vkRenderPass,
                                            vkVertexShaderModule,
                                            vkFragmentShaderModule,
-                                           vkViewport, vkScissor,
+                                           Vertex::getVertexDescription(VERTEX_FORMAT_FLOAT),
                                            VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST,
                                            VK_POLYGON_MODE_FILL,
                                            VK_CULL_MODE_BACK_BIT,
                                            VK_FRONT_FACE_CLOCKWISE, true, true);
 
+        vkPackedPipeline = pipelineBuilder.build(vkLogicalDevice, gpu, vkRenderPass,
+                                                 vkPackedVertexShaderModule,
+                                                 vkFragmentShaderModule,
+                                                 Vertex::getVertexDescription(VERTEX_FORMAT_PACKED),
+                                                 VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST,
+                                                 VK_POLYGON_MODE_FILL,
+                                                 VK_CULL_MODE_BACK_BIT,
+                                                 VK_FRONT_FACE_CLOCKWISE, true, true);
+
+        std::vector<uint32_t> cullShaderCode = VkUtils::readFile("../resources/shaders/cull.spv");
+        vkCullShaderModule = VkUtils::createShaderModule(vkLogicalDevice, cullShaderCode);
+        vkCullPipeline = pipelineBuilder.buildCompute(vkLogicalDevice, vkCullShaderModule);
+
         vkDestroyShaderModule(vkLogicalDevice, vkVertexShaderModule, nullptr);
+        vkDestroyShaderModule(vkLogicalDevice, vkPackedVertexShaderModule, nullptr);
         vkDestroyShaderModule(vkLogicalDevice, vkFragmentShaderModule, nullptr);
+        vkDestroyShaderModule(vkLogicalDevice, vkCullShaderModule, nullptr);
+
+        pipelineBuildMilliseconds = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+        INFO("Created the pipelines in " << pipelineBuildMilliseconds << " ms, " << (pipelineCacheWarm ? "warm" : "cold")
+             << " pipeline cache");
 
         DeletionQueue::queue([=]() {
             vkDestroyPipelineLayout(vkLogicalDevice, pipelineBuilder.vkPipelineLayout, nullptr);
             vkDestroyPipeline(vkLogicalDevice, vkPipeline, nullptr);
+            vkDestroyPipeline(vkLogicalDevice, vkPackedPipeline, nullptr);
+            vkDestroyPipelineLayout(vkLogicalDevice, pipelineBuilder.vkComputePipelineLayout, nullptr);
+            vkDestroyPipeline(vkLogicalDevice, vkCullPipeline, nullptr);
             vkDestroyDescriptorSetLayout(vkLogicalDevice, pipelineBuilder.vkDescriptorSetLayout,
                                          nullptr);
-            vkDestroyDescriptorPool(vkLogicalDevice, pipelineBuilder.vkDescriptorPool, nullptr);
         });
 
     }
@@ -321,9 +491,30 @@ namespace tgl {
         camMatrix = cameraTranslation * rotationY;
         camera.forwardLinear = camMatrix[2];
         //camera projection
-        camera.data.projection = glm::perspectiveLH((camera.fov / 100.0F), window->aspect,
+        //The swapchain's aspect ratio, which follows the window through resizes
+        const float aspect = (float) vkWindowExtent.width / (float) std::max<uint32_t>(vkWindowExtent.height, 1);
+        camera.data.projection = glm::perspectiveLH((camera.fov / 100.0F), aspect,
                                                     camera.nearClipPlane, camera.farClipPlane);
-        for (Entity &entity : entities) {
+
+        if (entities.size() > entityCapacity) {
+            growEntityBuffers();
+        }
+        //Every entity's object data holds the light, so moving it rewrites all of them
+        if (light.position != lightPosition) {
+            lightPosition = light.position;
+            for (uint32_t i = 0; i < entities.size(); i++) {
+                markEntityDirty(i);
+            }
+        }
+        entityWrites.clear();
+        size_t waiting = 0;
+        for (uint32_t i : dirtyEntities) {
+            Entity &entity = entities[i];
+            //Written once the mesh is resident, it isn't drawn before
+            if (!entity.resident || !meshRegistry.isResident(entity.mesh)) {
+                dirtyEntities[waiting++] = i;
+                continue;
+            }
             glm::mat4 translationMatrix = glm::translate(entity.position);
             glm::mat4 entityRotationX = glm::rotate(entity.pitch + M_PI_2f32, rotAxisX);
             //glm::mat4 entityRotationX = glm::rotate(entity.pitch, rotAxisX);
@@ -331,9 +522,183 @@ namespace tgl {
             glm::mat4 entityRotationZ = glm::rotate(entity.roll, rotAxisZ);
             glm::mat4 rotationMatrix = entityRotationX * entityRotationY * entityRotationZ;
             glm::mat4 scaleMatrix = glm::scale(glm::mat4(1.0f), entity.scale);
-            entity.mesh.description.renderData.model = translationMatrix * rotationMatrix * scaleMatrix;
-            entity.mesh.description.renderData.lightPos = light.position;
+            entity.renderData.model = translationMatrix * rotationMatrix * scaleMatrix;
+            entity.renderData.lightPos = lightPosition;
+            const MeshDescription &description = meshRegistry.getDescription(entity.mesh);
+            //Packed positions are stored relative to the bounding box
+            entity.renderData.positionScale = glm::vec4(description.boundsMax - description.boundsMin, 0);
+            entity.renderData.positionOffset = glm::vec4(description.boundsMin, 1);
+            //World space bounding sphere, non uniform scale stretches it by the largest axis
+            const glm::vec3 center = glm::vec3(entity.renderData.model *
+                                               glm::vec4((description.boundsMin + description.boundsMax) * 0.5F, 1));
+            const float scale = std::max(std::max(std::fabs(entity.scale.x), std::fabs(entity.scale.y)),
+                                         std::fabs(entity.scale.z));
+            entity.bounds = glm::vec4(center,
+                                      glm::length(description.boundsMax - description.boundsMin) * 0.5F * scale);
+            //An entity drawn for the first time needs a place in the culled batches
+            if (!(entityFlags[i] & ENTITY_DRAWN)) {
+                culledBatchesOutdated = true;
+            }
+            entityFlags[i] = ENTITY_DRAWN;
+            entityWrites.push_back(i);
         }
+        dirtyEntities.resize(waiting);
+    }
+
+    void Renderer::selectLod(const Camera &camera, const MeshDescription &description, Entity &entity) const {
+        const uint32_t lodCount = description.getLodCount();
+        if (lodCount == 1) {
+            entity.lod = 0;
+            return;
+        }
+        const float scale = std::max(std::max(std::fabs(entity.scale.x), std::fabs(entity.scale.y)),
+                                     std::fabs(entity.scale.z));
+        const float distance = std::max(glm::length(glm::vec3(entity.bounds) - camera.position) - entity.bounds.w,
+                                        camera.nearClipPlane);
+        //Pixels per world unit at that distance, using the same vertical fov as the projection matrix
+        const float pixelsPerUnit = (float) vkWindowExtent.height * 0.5F / (distance * std::tan(camera.fov / 100.0F * 0.5F));
+
+        //Coarsest level whose error stays below the threshold, entering it needs the hysteresis margin
+        uint32_t lod = std::min(entity.lod, lodCount - 1);
+        while (lod > 0 && description.getLod(lod).error * scale * pixelsPerUnit > lodErrorThreshold) {
+            lod--;
+        }
+        while (lod + 1 < lodCount && description.getLod(lod + 1).error * scale * pixelsPerUnit <=
+                                     lodErrorThreshold * (1.0F - lodHysteresis)) {
+            lod++;
+        }
+        entity.lod = lod;
+    }
+
+    uint64_t Renderer::makeDrawKey(const MeshEntry &meshEntry, const Entity &entity, const Camera &camera) {
+        //The vertex format selects the pipeline, which comes before the mesh so each pipeline is bound once per frame.
+        //Aliases of a deduplicated mesh resolve to the same entry and share its draws. There are no materials yet,
+        //every entity uses material 0.
+        const float viewDepth = getViewDepth(camera, entity.position);
+        return RenderQueue::makeKey(DRAW_PASS_OPAQUE, meshEntry.description.vertexFormat, 0,
+                                    meshEntry.canonicalIndex, entity.lod, viewDepth / camera.farClipPlane);
+    }
+
+    void Renderer::buildBatches(const Camera &camera) {
+        //Entities outside the frustum are dropped before they are batched. With CPU culling off every drawn entity is
+        //in the list.
+        visibleEntities.clear();
+        if (cpuCulling) {
+            frustumCuller.clear();
+            frustumCuller.reserve(entities.size());
+            for (uint32_t i = 0; i < entities.size(); i++) {
+                if (entityFlags[i] & ENTITY_DRAWN) {
+                    frustumCuller.add(glm::vec3(entities[i].bounds), entities[i].bounds.w, i);
+                }
+            }
+            glm::vec4 planes[6];
+            FrustumCuller::extractPlanes(camera.data.projection * camera.data.view, planes);
+            frustumCuller.cull(planes, visibleEntities);
+        } else {
+            for (uint32_t i = 0; i < entities.size(); i++) {
+                if (entityFlags[i] & ENTITY_DRAWN) {
+                    visibleEntities.push_back(i);
+                }
+            }
+        }
+
+        //Group the entities to draw by what they are drawn with
+        renderQueue.clear();
+        renderQueue.reserve(visibleEntities.size());
+        for (uint32_t i : visibleEntities) {
+            Entity &entity = entities[i];
+            const MeshEntry &meshEntry = meshRegistry.getEntry(entity.mesh);
+            selectLod(camera, meshEntry.description, entity);
+            if (meshEntry.description.getLod(entity.lod).indexCount == 0) {
+                continue;
+            }
+            renderQueue.push(makeDrawKey(meshEntry, entity, camera), i);
+        }
+        renderQueue.sort();
+
+        //Entities sharing the key up to depth are contiguous after sorting, each run becomes one instanced draw whose
+        //instances are ordered front to back
+        drawBatches.clear();
+        for (size_t first = 0, last = 0; first < renderQueue.size(); first = last) {
+            const uint64_t batchKey = renderQueue[first].key & RenderQueue::BATCH_MASK;
+            while (last < renderQueue.size() && (renderQueue[last].key & RenderQueue::BATCH_MASK) == batchKey) {
+                last++;
+            }
+            const Entity &entity = entities[renderQueue[first].entityIndex];
+            const MeshEntry &meshEntry = meshRegistry.getEntry(entity.mesh);
+            const MeshLod lod = meshEntry.description.getLod(entity.lod);
+            DrawBatch drawBatch{};
+            drawBatch.vkPipeline =
+                    meshEntry.description.vertexFormat == VERTEX_FORMAT_PACKED ? vkPackedPipeline : vkPipeline;
+            drawBatch.vkVertexBuffer = meshEntry.vkVertexBuffer;
+            drawBatch.vkIndexBuffer = meshEntry.vkIndexBuffer;
+            drawBatch.command.indexCount = lod.indexCount;
+            drawBatch.command.instanceCount = (uint32_t) (last - first);
+            drawBatch.command.firstIndex = meshEntry.firstIndex + lod.indexOffset;
+            drawBatch.command.vertexOffset = meshEntry.vertexOffset;
+            drawBatch.command.firstInstance = (uint32_t) first;
+            drawBatch.lodError = lod.error;
+            drawBatches.push_back(drawBatch);
+        }
+        //They no longer are the culled batches
+        culledBatchesOutdated = true;
+    }
+
+    void Renderer::buildCulledBatches() {
+        //Sorting by mesh alone groups the drawn entities of each mesh, in an order that keeps the binds down
+        renderQueue.clear();
+        renderQueue.reserve(entities.size());
+        for (uint32_t i = 0; i < entities.size(); i++) {
+            if (entityFlags[i] & ENTITY_DRAWN) {
+                const MeshEntry &meshEntry = meshRegistry.getEntry(entities[i].mesh);
+                renderQueue.push(RenderQueue::makeKey(DRAW_PASS_OPAQUE, meshEntry.description.vertexFormat, 0,
+                                                      meshEntry.canonicalIndex, 0, 0), i);
+            }
+        }
+        renderQueue.sort();
+
+        //Entities that aren't drawn keep a zero lodCount, the culling pass skips them
+        cullObjects.assign(entities.size(), CullObject{});
+        drawBatches.clear();
+        culledInstanceCapacity = 0;
+        for (size_t first = 0, last = 0; first < renderQueue.size(); first = last) {
+            while (last < renderQueue.size() && renderQueue[last].key == renderQueue[first].key) {
+                last++;
+            }
+            const MeshEntry &meshEntry = meshRegistry.getEntry(entities[renderQueue[first].entityIndex].mesh);
+            const MeshDescription &description = meshEntry.description;
+            const uint32_t firstBatch = (uint32_t) drawBatches.size();
+            const uint32_t lodCount = description.getLodCount();
+            const uint32_t entityCount = (uint32_t) (last - first);
+            //Each level has room for all of the mesh's entities, the culling pass picks one per entity
+            for (uint32_t level = 0; level < lodCount; level++) {
+                const MeshLod lod = description.getLod(level);
+                DrawBatch drawBatch{};
+                drawBatch.vkPipeline = description.vertexFormat == VERTEX_FORMAT_PACKED ? vkPackedPipeline : vkPipeline;
+                drawBatch.vkVertexBuffer = meshEntry.vkVertexBuffer;
+                drawBatch.vkIndexBuffer = meshEntry.vkIndexBuffer;
+                drawBatch.command.indexCount = lod.indexCount;
+                drawBatch.command.instanceCount = 0;
+                drawBatch.command.firstIndex = meshEntry.firstIndex + lod.indexOffset;
+                drawBatch.command.vertexOffset = meshEntry.vertexOffset;
+                drawBatch.command.firstInstance = culledInstanceCapacity;
+                drawBatch.lodError = lod.error;
+                drawBatches.push_back(drawBatch);
+                culledInstanceCapacity += entityCount;
+            }
+            const glm::vec4 sphere((description.boundsMin + description.boundsMax) * 0.5F,
+                                   glm::length(description.boundsMax - description.boundsMin) * 0.5F);
+            for (size_t i = first; i < last; i++) {
+                const uint32_t entityIndex = renderQueue[i].entityIndex;
+                CullObject &cullObject = cullObjects[entityIndex];
+                cullObject.sphere = sphere;
+                cullObject.firstBatch = firstBatch;
+                cullObject.lodCount = lodCount;
+                cullObject.lod = std::min(entities[entityIndex].lod, lodCount - 1);
+            }
+        }
+        cullObjectsPending = true;
+        culledBatchesOutdated = false;
     }
 
     FrameData &Renderer::getCurrentFrame() {
@@ -342,92 +707,121 @@ namespace tgl {
 
     void Renderer::init() {
         prepareVulkan();
-        initSwapchain();
+        if (headless) {
+            initOffscreenTargets();
+        } else {
+            initSwapchain();
+        }
+        initDepthImage();
         initCommands();
         initRenderpass();
         initFramebuffers();
         initSynchronizationStructures();
         initPipeline();
+        initFrameAllocators();
+        initSecondaryCommandBuffers();
+        DeletionQueue::queue([=]() {
+            destroySecondaryCommandBuffers();
+        });
+        uploadEngine.init(vkLogicalDevice, allocator, vkTransferQueue, vkTransferQueueFamilyIndex,
+                          vkGraphicsQueueFamilyIndex);
+        meshRegistry.init(&uploadEngine, allocator);
+    }
+
+    void Renderer::initFrameAllocators() {
+        //A frame's set points at four storage buffers, two ranges of its object allocator and the persistent entity
+        //buffers, see PipelineBuilder. The pools keep room for the uniform buffers and samplers to come.
+        const std::vector<DescriptorPoolRatio> poolRatios = {
+                {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,         4},
+                {VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,         1},
+                {VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1}
+        };
+        const VkDeviceSize alignment = gpu.vkPhysicalDeviceProperties.limits.minStorageBufferOffsetAlignment;
+        for (uint32_t i = 0; i < bufferingAmount; i++) {
+            frames[i].objectAllocator.init(allocator,
+                                           VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT |
+                                           VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                                           FRAME_OBJECT_BYTES, alignment);
+            frames[i].transientDescriptors.init(vkLogicalDevice, 16, poolRatios);
+            DeletionQueue::queue([=]() {
+                frames[i].transientDescriptors.destroy();
+                frames[i].objectAllocator.destroy();
+            });
+        }
     }
 
     void Renderer::uploadEntity(Entity &entity) {
-        pipelineBuilder.allocateDescriptorSets(vkLogicalDevice, &entity.mesh.description.vkDescriptorSet);
-        VkBufferCreateInfo vkBufferCreateInfo{};
-        vkBufferCreateInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-        vkBufferCreateInfo.size = entity.mesh.description.vertices.size() * sizeof(Vertex);
-        vkBufferCreateInfo.usage = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT;
+        //The geometry lives in the mesh registry and the object data in the renderer's persistent object buffer, so
+        //there is nothing left to create per entity
+        entity.resident = true;
+    }
 
-        VmaAllocationCreateInfo vmaAllocationCreateInfo{};
-        //Allocated by the CPU, visible/readable by the GPU.
-        vmaAllocationCreateInfo.usage = VMA_MEMORY_USAGE_CPU_TO_GPU;
+    MeshHandle Renderer::addMesh(Mesh mesh, MeshMemory memory) {
+        return meshRegistry.add(std::move(mesh), memory);
+    }
 
-        VkUtils::createBuffer(allocator, entity.mesh.description.vertexBuffer.allocation,
-                              entity.mesh.description.vertexBuffer.vkBuffer,
-                              entity.mesh.description.vertices.size() * sizeof(Vertex),
-                              VK_BUFFER_USAGE_VERTEX_BUFFER_BIT);
+    MeshHandle Renderer::addMeshAsync(const std::shared_future<Mesh> &mesh, MeshMemory memory) {
+        return meshRegistry.addAsync(mesh, memory);
+    }
 
-        VkUtils::createBuffer(allocator, entity.mesh.description.indexBuffer.allocation,
-                              entity.mesh.description.indexBuffer.vkBuffer,
-                              entity.mesh.description.indices.size() * sizeof(uint32_t),
-                              VK_BUFFER_USAGE_INDEX_BUFFER_BIT);
+    void Renderer::releaseMesh(MeshHandle mesh) {
+        meshRegistry.release(mesh, frameCount);
+    }
 
-        VkUtils::createBuffer(allocator, entity.mesh.description.renderDataBuffer.allocation,
-                              entity.mesh.description.renderDataBuffer.vkBuffer, sizeof(MeshRenderData),
-                              VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT);
+    uint32_t Renderer::registerEntity(Entity &entity) {
+        meshRegistry.acquire(entity.mesh);
+        entities.push_back(entity);
+        entityFlags.push_back(0);
+        const uint32_t entityIndex = (uint32_t) entities.size() - 1;
+        markEntityDirty(entityIndex);
+        //The culling pass covers every entity, so even one that isn't drawn yet needs its culling input
+        culledBatchesOutdated = true;
+        return entityIndex;
+    }
 
-        // vkBufferCreateInfo.size = mesh.description.indices.size() * sizeof(MeshRenderData);
+    void Renderer::setEntityTransform(uint32_t entityIndex, const glm::vec3 &position, float pitch, float yaw,
+                                      float roll, const glm::vec3 &scale) {
+        Entity &entity = entities[entityIndex];
+        entity.position = position;
+        entity.pitch = pitch;
+        entity.yaw = yaw;
+        entity.roll = roll;
+        entity.scale = scale;
+        markEntityDirty(entityIndex);
+    }
 
-        DeletionQueue::queue([=]() {
-            vmaDestroyBuffer(allocator, entity.mesh.description.vertexBuffer.vkBuffer,
-                             entity.mesh.description.vertexBuffer.allocation);
-            vmaDestroyBuffer(allocator, entity.mesh.description.indexBuffer.vkBuffer,
-                             entity.mesh.description.indexBuffer.allocation);
-            vmaUnmapMemory(allocator, entity.mesh.description.renderDataBuffer.allocation);
-            vmaDestroyBuffer(allocator, entity.mesh.description.renderDataBuffer.vkBuffer,
-                             entity.mesh.description.renderDataBuffer.allocation);
-        });
+    void Renderer::markEntityDirty(uint32_t entityIndex) {
+        if (!(entityFlags[entityIndex] & ENTITY_DIRTY)) {
+            entityFlags[entityIndex] |= ENTITY_DIRTY;
+            dirtyEntities.push_back(entityIndex);
+        }
+    }
 
-        vmaMapMemory(allocator, entity.mesh.description.renderDataBuffer.allocation,
-                     &entity.mesh.description.renderDataMappedDestination);
-        memcpy(entity.mesh.description.renderDataMappedDestination, &entity.mesh.description.renderData,
-               sizeof(MeshRenderData));
-
-        void *data;
-        vmaMapMemory(allocator, entity.mesh.description.vertexBuffer.allocation, &data);
-        memcpy(data, entity.mesh.description.vertices.data(), entity.mesh.description.vertices.size() * sizeof(Vertex));
-        vmaUnmapMemory(allocator, entity.mesh.description.vertexBuffer.allocation);
-
-        vmaMapMemory(allocator, entity.mesh.description.indexBuffer.allocation, &data);
-        memcpy(data, entity.mesh.description.indices.data(), entity.mesh.description.indices.size() * sizeof(uint32_t));
-        vmaUnmapMemory(allocator, entity.mesh.description.indexBuffer.allocation);
-
-        VkDescriptorBufferInfo vkDescriptorBufferInfo;
-        vkDescriptorBufferInfo.buffer = entity.mesh.description.renderDataBuffer.vkBuffer;
-        vkDescriptorBufferInfo.offset = 0; //Whole buffer
-        vkDescriptorBufferInfo.range = sizeof(entity.mesh.description.renderData);
-
-        VkWriteDescriptorSet vkWriteDescriptorSet;
-        vkWriteDescriptorSet.pNext = nullptr;
-        vkWriteDescriptorSet.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-        vkWriteDescriptorSet.dstSet = entity.mesh.description.vkDescriptorSet;
-        vkWriteDescriptorSet.dstBinding = 0;//Binding to update
-        vkWriteDescriptorSet.dstArrayElement = 0;
-        vkWriteDescriptorSet.descriptorCount = 1;
-        vkWriteDescriptorSet.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-        vkWriteDescriptorSet.pImageInfo = nullptr;
-        vkWriteDescriptorSet.pBufferInfo = &vkDescriptorBufferInfo;
-        vkWriteDescriptorSet.pTexelBufferView = nullptr;
-        std::vector<VkWriteDescriptorSet> vkWriteDescriptorSets;
-        vkWriteDescriptorSets.reserve(1);
-        vkWriteDescriptorSets.push_back(vkWriteDescriptorSet);
-
-        vkUpdateDescriptorSets(vkLogicalDevice, vkWriteDescriptorSets.size(), vkWriteDescriptorSets.data(), 0,
-                               nullptr);
-    }
-
-    void Renderer::registerEntity(Entity &entity) {
-        entity.registered = false;
-        entities.push_back(entity);
+    void Renderer::growEntityBuffers() {
+        uint32_t newCapacity = std::max(entityCapacity, INITIAL_ENTITY_CAPACITY);
+        while (newCapacity < entities.size()) {
+            newCapacity *= 2;
+        }
+        //Frames in flight may still read the old buffers
+        if (entityCapacity > 0) {
+            retiredBuffers.push_back({objectBuffer, frameCount});
+            retiredBuffers.push_back({cullBuffer, frameCount});
+        }
+        entityCapacity = newCapacity;
+        VkUtils::createBuffer(allocator, objectBuffer.allocation, objectBuffer.vkBuffer,
+                              entityCapacity * sizeof(MeshRenderData),
+                              VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                              VMA_MEMORY_USAGE_GPU_ONLY);
+        VkUtils::createBuffer(allocator, cullBuffer.allocation, cullBuffer.vkBuffer,
+                              entityCapacity * sizeof(CullObject),
+                              VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                              VMA_MEMORY_USAGE_GPU_ONLY);
+        //Nothing is copied over, the new buffers are filled like the ones of freshly registered entities. Doubling
+        //keeps that rare.
+        for (uint32_t i = 0; i < entities.size(); i++) {
+            markEntityDirty(i);
+        }
+        culledBatchesOutdated = true;
     }
 
     void Renderer::registerEntities(std::vector<Entity> &list) {
@@ -437,32 +831,183 @@ namespace tgl {
     }
 
     void Renderer::clearEntities() {
+        for (Entity &entity : entities) {
+            meshRegistry.release(entity.mesh, frameCount);
+        }
         entities.clear();
+        entityFlags.clear();
+        dirtyEntities.clear();
+        culledBatchesOutdated = true;
     }
 
     void Renderer::render(Camera &camera, Light &light) {
-        FrameData frameData = getCurrentFrame();
+        FrameData &frameData = getCurrentFrame();
+        const auto waitStart = std::chrono::high_resolution_clock::now();
 
-        //wait until the GPU has finished rendering the last frame.
-        uint32_t vkSwapchainImageIndex;
-        VK_HANDLE_ERROR(
-                vkAcquireNextImageKHR(vkLogicalDevice, vkSwapchain, 1000000000, frameData.vkPresentSemaphore, nullptr,
-                                      &vkSwapchainImageIndex), "Failed to acquire the next image!");
+        //Wait until the GPU finished the last frame that used this frame data, the other frames in flight keep it busy
+        //in the meantime. Its present semaphore is unsignaled again afterwards, so it can be handed to the acquire.
         VK_HANDLE_ERROR(vkWaitForFences(vkLogicalDevice, 1, &frameData.vkRenderFence, true, 1000000000),
                         "Failed to wait for render fence!");
+        //Every frame that could use a retired swapchain finished by now
+        while (!retiredSwapchains.empty() && retiredSwapchains.front().frame + bufferingAmount <= frameCount) {
+            destroySwapchainResources(retiredSwapchains.front());
+            retiredSwapchains.pop_front();
+        }
+        while (!retiredBuffers.empty() && retiredBuffers.front().frame + bufferingAmount <= frameCount) {
+            const AllocatedBuffer &retiredBuffer = retiredBuffers.front().buffer;
+            vmaDestroyBuffer(allocator, retiredBuffer.vkBuffer, retiredBuffer.allocation);
+            retiredBuffers.pop_front();
+        }
+        uint32_t vkSwapchainImageIndex;
+        if (headless) {
+            vkSwapchainImageIndex = frameCount % bufferingAmount;
+        } else {
+            //The frame is skipped while minimized, input is still polled so the window can come back
+            if (!updateSwapchain()) {
+                frameLimiter.wait(frameRateLimit);
+                if (inputCallback) {
+                    inputCallback();
+                }
+                return;
+            }
+            VkResult vkResult = vkAcquireNextImageKHR(vkLogicalDevice, vkSwapchain, 1000000000,
+                                                      frameData.vkPresentSemaphore, nullptr, &vkSwapchainImageIndex);
+            //Nothing was acquired and the fence is still signaled, the next call starts over with a new swapchain
+            if (vkResult == VK_ERROR_OUT_OF_DATE_KHR) {
+                swapchainOutdated = true;
+                return;
+            }
+            //A suboptimal image can still be presented, the swapchain is recreated for the next frame
+            if (vkResult == VK_SUBOPTIMAL_KHR) {
+                swapchainOutdated = true;
+            } else {
+                VK_HANDLE_ERROR(vkResult, "Failed to acquire the next image!");
+            }
+        }
+        //The number of frames in flight doesn't depend on the number of swapchain images, so the acquired image may
+        //still be rendered to by another frame
+        VkFence &vkImageInFlight = vkImagesInFlight[vkSwapchainImageIndex];
+        if (vkImageInFlight != VK_NULL_HANDLE && vkImageInFlight != frameData.vkRenderFence) {
+            VK_HANDLE_ERROR(vkWaitForFences(vkLogicalDevice, 1, &vkImageInFlight, true, 1000000000),
+                            "Failed to wait for the fence of a swapchain image!");
+        }
+        vkImageInFlight = frameData.vkRenderFence;
+        cpuWaitMilliseconds = std::chrono::duration<float, std::milli>(
+                std::chrono::high_resolution_clock::now() - waitStart).count();
+        //Reset only once an image was acquired, so the fence is always signaled again by this frame's submit
         VK_HANDLE_ERROR(vkResetFences(vkLogicalDevice, 1, &frameData.vkRenderFence),
                         "Failed to reset the render fence!");
+        //Count what the GPU drew the last time it used this frame, before the allocator hands the memory out again.
+        //The culling pass wrote the instance counts, like readbacks they may sit in non coherent memory.
+        frameData.objectAllocator.invalidate(frameData.drawCommandsOffset,
+                                             frameData.drawCommandCount * sizeof(CullDrawCommand));
+        const auto *drawCommands = (const CullDrawCommand *) frameData.objectAllocator.getMappedData(
+                frameData.drawCommandsOffset);
+        visibleInstanceCount = 0;
+        for (uint32_t i = 0; i < frameData.drawCommandCount; i++) {
+            visibleInstanceCount += drawCommands[i].command.instanceCount;
+        }
+        if (frameData.readbackPending) {
+            deliverReadback(frameData);
+        }
+        //The GPU is done with this frame's object data and transient descriptor sets
+        frameData.objectAllocator.reset();
+        frameData.transientDescriptors.reset();
+        frameData.drawCommandCount = 0;
+
+        //Meshes released at least bufferingAmount frames ago are no longer used by any frame in flight
+        meshRegistry.collectGarbage(frameCount, bufferingAmount);
+        uploadEngine.collect(frameCount, bufferingAmount);
+        meshRegistry.processUploads(uploadBudgetBytes);
+        //The meshes uploaded above are drawn this frame, so it waits on their copies
+        std::vector<VkSemaphore> vkWaitSemaphores = uploadEngine.takeWaitSemaphores(frameCount);
+
+        //Paced only once the GPU and the swapchain let the frame start, so the limiter's sleep isn't spent on top of
+        //their blocking and the input sampled right after it has to wait for nothing but this frame's own work before
+        //it's on screen
+        frameLimiter.wait(frameRateLimit);
+        if (inputCallback) {
+            inputCallback();
+        }
 
         /**
          * UPDATE BUFFERS
          */
         updateBuffers(camera, light);
 
+        //With GPU culling the batches only change along with the entities, and the CPU never looks at the entities one
+        //by one. Otherwise they are culled, sorted and batched every frame.
+        const bool culling = gpuCulling && drawIndirectFirstInstanceSupported;
+        if (!culling) {
+            buildBatches(camera);
+        } else if (culledBatchesOutdated) {
+            buildCulledBatches();
+        }
+
+        //Entities written this frame are staged here and copied into the persistent buffers. Instance i of the batches
+        //reads the object of the entity at visible index i, the visible instances of a draw start at its firstInstance.
+        const size_t drawBatchCount = drawBatches.size();
+        const size_t visibleCount = culling ? culledInstanceCapacity : renderQueue.size();
+        const size_t cullWriteCount = culling && cullObjectsPending ? cullObjects.size() : 0;
+        FrameAllocator &objectAllocator = frameData.objectAllocator;
+        //Grown before anything is allocated, so a frame with more entities than ever before is still drawn. The GPU
+        //finished with this frame's buffer, see reset above.
+        objectAllocator.reserve(entityWrites.size() * sizeof(MeshRenderData) + cullWriteCount * sizeof(CullObject) +
+                                visibleCount * sizeof(uint32_t) + drawBatchCount * sizeof(CullDrawCommand), 4);
+        const VkDeviceSize objectWritesOffset = objectAllocator.allocate(entityWrites.size() * sizeof(MeshRenderData));
+        const VkDeviceSize cullWritesOffset = objectAllocator.allocate(cullWriteCount * sizeof(CullObject));
+        const VkDeviceSize visibleOffset = objectAllocator.allocate(visibleCount * sizeof(uint32_t));
+        const VkDeviceSize commandsOffset = objectAllocator.allocate(drawBatchCount * sizeof(CullDrawCommand));
+        auto *objectWrites = (MeshRenderData *) objectAllocator.getMappedData(objectWritesOffset);
+        for (size_t i = 0; i < entityWrites.size(); i++) {
+            objectWrites[i] = entities[entityWrites[i]].renderData;
+        }
+        if (cullWriteCount > 0) {
+            memcpy(objectAllocator.getMappedData(cullWritesOffset), cullObjects.data(),
+                   cullWriteCount * sizeof(CullObject));
+            cullObjectsPending = false;
+        }
+        VkDescriptorSet vkDescriptorSet = VK_NULL_HANDLE;
+        if (drawBatchCount > 0) {
+            //The culling pass fills the visible instances itself
+            if (!culling) {
+                auto *visible = (uint32_t *) objectAllocator.getMappedData(visibleOffset);
+                for (size_t i = 0; i < visibleCount; i++) {
+                    visible[i] = renderQueue[i].entityIndex;
+                }
+            }
+            auto *commands = (CullDrawCommand *) objectAllocator.getMappedData(commandsOffset);
+            for (size_t batch = 0; batch < drawBatchCount; batch++) {
+                commands[batch].command = drawBatches[batch].command;
+                commands[batch].lodError = drawBatches[batch].lodError;
+            }
+            frameData.drawCommandsOffset = commandsOffset;
+            frameData.drawCommandCount = (uint32_t) drawBatchCount;
+
+            frameData.transientDescriptors.allocate(pipelineBuilder.vkDescriptorSetLayout, &vkDescriptorSet);
+            DescriptorWriter descriptorWriter;
+            descriptorWriter.writeBuffer(vkDescriptorSet, 0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                                         objectBuffer.vkBuffer, 0, entityCapacity * sizeof(MeshRenderData));
+            descriptorWriter.writeBuffer(vkDescriptorSet, 1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                                         objectAllocator.getBuffer(), visibleOffset, visibleCount * sizeof(uint32_t));
+            descriptorWriter.writeBuffer(vkDescriptorSet, 2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                                         cullBuffer.vkBuffer, 0, entityCapacity * sizeof(CullObject));
+            descriptorWriter.writeBuffer(vkDescriptorSet, 3, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                                         objectAllocator.getBuffer(), commandsOffset,
+                                         drawBatchCount * sizeof(CullDrawCommand));
+            descriptorWriter.update(vkLogicalDevice);
+        }
+
         VK_HANDLE_ERROR(vkResetCommandBuffer(frameData.vkMainCommandBuffer, 0),
                         "Failed to reset the main command buffer!");
 
         VkUtils::beginCommandBuffer(frameData.vkCommandPool, VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
                                     &frameData.vkMainCommandBuffer);
+        uploadEngine.recordAcquireBarriers(frameData.vkMainCommandBuffer);
+        recordEntityWrites(frameData, objectWritesOffset, cullWritesOffset, cullWriteCount);
+        if (culling && drawBatchCount > 0) {
+            recordCulling(frameData, vkDescriptorSet, camera, (uint32_t) entities.size());
+        }
         //background color
         VkClearValue vkClearValueDefault{};
         VkClearValue vkClearValues[2] = {vkClearValueDefault, vkClearValueDefault};
@@ -480,37 +1025,61 @@ namespace tgl {
         vkRenderPassBeginInfo.renderArea.offset.y = 0;
         vkRenderPassBeginInfo.renderArea.extent = vkWindowExtent;
 
-        //We don't care about the image layout yet
-        vkCmdBeginRenderPass(frameData.vkMainCommandBuffer, &vkRenderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
-        vkCmdBindPipeline(frameData.vkMainCommandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
-                          vkPipeline);
-        vkCmdPushConstants(frameData.vkMainCommandBuffer,
-                           pipelineBuilder.vkPipelineLayout, VK_SHADER_STAGE_VERTEX_BIT,
-                           0,
-                           sizeof(CameraData), &camera.data);
-        for (Entity &entity : entities) {
-            VkDeviceSize offset = 0;
-            vkCmdBindDescriptorSets(frameData.vkMainCommandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
-                                    pipelineBuilder.vkPipelineLayout,
-                                    0, 1,
-                                    &entity.mesh.description.vkDescriptorSet, 0, nullptr);
-            vkCmdBindVertexBuffers(frameData.vkMainCommandBuffer, 0, 1, &entity.mesh.description.vertexBuffer.vkBuffer,
-                                   &offset);
-            vkCmdBindIndexBuffer(frameData.vkMainCommandBuffer, entity.mesh.description.indexBuffer.vkBuffer, offset,
-                                 VK_INDEX_TYPE_UINT32);
-
-
-            uint32_t indexSize = entity.mesh.description.indices.size();
-            if (!entity.registered) {
-                memcpy(entity.mesh.description.renderDataMappedDestination, &entity.mesh.description.renderData,
-                       sizeof(MeshRenderData));
-                entity.registered = true;
+        //Large draw lists are split into contiguous ranges recorded into secondary command buffers in parallel
+        const uint32_t recordingThreads = (uint32_t) std::min<size_t>(frameData.vkSecondaryCommandBuffers.size(),
+                                                                      drawBatchCount / MIN_BATCHES_PER_RECORDING_THREAD);
+        if (recordingThreads > 1) {
+            //We don't care about the image layout yet
+            vkCmdBeginRenderPass(frameData.vkMainCommandBuffer, &vkRenderPassBeginInfo,
+                                 VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+            VkCommandBufferInheritanceInfo vkCommandBufferInheritanceInfo{};
+            vkCommandBufferInheritanceInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+            vkCommandBufferInheritanceInfo.renderPass = vkRenderPass;
+            vkCommandBufferInheritanceInfo.subpass = 0;
+            vkCommandBufferInheritanceInfo.framebuffer = vkFramebuffers[vkSwapchainImageIndex];
+            std::vector<uint32_t> threadDrawCallCounts(recordingThreads, 0);
+            std::vector<BindCounters> threadBindCounters(recordingThreads);
+            for (uint32_t thread = 0; thread < recordingThreads; thread++) {
+                const size_t first = drawBatchCount * thread / recordingThreads;
+                const size_t last = drawBatchCount * (thread + 1) / recordingThreads;
+                recordingThreadPool->sendTask(thread, [&, thread, first, last]() {
+                    //The GPU finished with the frame, so the thread's pool can be reset without synchronization
+                    VK_HANDLE_ERROR(vkResetCommandPool(vkLogicalDevice, frameData.vkSecondaryCommandPools[thread], 0),
+                                    "Failed to reset a secondary command pool!");
+                    VkCommandBuffer vkCommandBuffer = frameData.vkSecondaryCommandBuffers[thread];
+                    VkCommandBufferBeginInfo vkCommandBufferBeginInfo{};
+                    vkCommandBufferBeginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+                    vkCommandBufferBeginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT |
+                                                     VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+                    vkCommandBufferBeginInfo.pInheritanceInfo = &vkCommandBufferInheritanceInfo;
+                    VK_HANDLE_ERROR(vkBeginCommandBuffer(vkCommandBuffer, &vkCommandBufferBeginInfo),
+                                    "Failed to begin a secondary command buffer!");
+                    threadDrawCallCounts[thread] = recordBatches(vkCommandBuffer, frameData, camera, vkDescriptorSet,
+                                                                 first, last, culling, threadBindCounters[thread]);
+                    VK_HANDLE_ERROR(vkEndCommandBuffer(vkCommandBuffer), "Failed to end a secondary command buffer!");
+                });
+            }
+            recordingThreadPool->finishTasks();
+            vkCmdExecuteCommands(frameData.vkMainCommandBuffer, recordingThreads,
+                                 frameData.vkSecondaryCommandBuffers.data());
+            drawCallCount = 0;
+            bindCounters = BindCounters();
+            for (uint32_t thread = 0; thread < recordingThreads; thread++) {
+                drawCallCount += threadDrawCallCounts[thread];
+                bindCounters += threadBindCounters[thread];
             }
-            //we can now draw the entity
-            vkCmdDrawIndexed(frameData.vkMainCommandBuffer, indexSize, 1, 0, 0, 0);
+        } else {
+            //We don't care about the image layout yet
+            vkCmdBeginRenderPass(frameData.vkMainCommandBuffer, &vkRenderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+            bindCounters = BindCounters();
+            drawCallCount = recordBatches(frameData.vkMainCommandBuffer, frameData, camera, vkDescriptorSet, 0,
+                                          drawBatchCount, culling, bindCounters);
         }
         //The render pass transitions the image into the format ready for display.
         vkCmdEndRenderPass(frameData.vkMainCommandBuffer);
+        if (headless && readbackCallback) {
+            recordReadback(frameData, vkSwapchainImages[vkSwapchainImageIndex]);
+        }
         vkEndCommandBuffer(frameData.vkMainCommandBuffer);
 
         //We can submit the command buffer to the GPU
@@ -522,18 +1091,31 @@ namespace tgl {
         vkSubmitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
         vkSubmitInfo.commandBufferCount = 1;
         vkSubmitInfo.pCommandBuffers = &frameData.vkMainCommandBuffer;
-        vkSubmitInfo.waitSemaphoreCount = 1;
-        vkSubmitInfo.pWaitSemaphores = &frameData.vkPresentSemaphore;
-        vkSubmitInfo.signalSemaphoreCount = 1;
-        vkSubmitInfo.pSignalSemaphores = &frameData.vkRenderSemaphore;
-        VkPipelineStageFlags vkPipelineStageFlags = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-        vkSubmitInfo.pWaitDstStageMask = &vkPipelineStageFlags;
+        //Uploads only have to be done before the vertex input reads them
+        std::vector<VkPipelineStageFlags> vkWaitStageFlags(vkWaitSemaphores.size(), VK_PIPELINE_STAGE_VERTEX_INPUT_BIT);
+        //Offscreen images are neither acquired nor presented
+        if (!headless) {
+            vkWaitSemaphores.push_back(frameData.vkPresentSemaphore);
+            vkWaitStageFlags.push_back(VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT);
+            vkSubmitInfo.signalSemaphoreCount = 1;
+            vkSubmitInfo.pSignalSemaphores = &frameData.vkRenderSemaphore;
+        }
+        vkSubmitInfo.waitSemaphoreCount = (uint32_t) vkWaitSemaphores.size();
+        vkSubmitInfo.pWaitSemaphores = vkWaitSemaphores.data();
+        vkSubmitInfo.pWaitDstStageMask = vkWaitStageFlags.data();
 
+        //Entity writes, visible instances and draw commands were written through the mapping
+        frameData.objectAllocator.flush();
         //submit command buffer to the queue and execute it.
         // _renderFence will now block until the graphic commands finish execution
         VK_HANDLE_ERROR(vkQueueSubmit(vkGraphicsQueue, 1, &vkSubmitInfo, frameData.vkRenderFence),
                         "Failed to submit a command buffer to the queue for execution!");
 
+        if (headless) {
+            frameCount++;
+            return;
+        }
+
         //Now display the image to the screen
         VkPresentInfoKHR vkPresentInfo{};
         vkPresentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
@@ -544,24 +1126,372 @@ namespace tgl {
         vkPresentInfo.pSwapchains = &vkSwapchain;
         vkPresentInfo.pImageIndices = &vkSwapchainImageIndex;
 
-        VK_HANDLE_ERROR(vkQueuePresentKHR(vkGraphicsQueue, &vkPresentInfo),
-                        "Failed to present an image to the screen!");
+        VkResult vkResult = vkQueuePresentKHR(vkGraphicsQueue, &vkPresentInfo);
+        if (vkResult == VK_ERROR_OUT_OF_DATE_KHR || vkResult == VK_SUBOPTIMAL_KHR) {
+            swapchainOutdated = true;
+        } else {
+            VK_HANDLE_ERROR(vkResult, "Failed to present an image to the screen!");
+        }
         frameCount++;
     }
 
+    void Renderer::recordEntityWrites(FrameData &frameData, VkDeviceSize objectWritesOffset,
+                                      VkDeviceSize cullWritesOffset, size_t cullWriteCount) {
+        if (entityWrites.empty() && cullWriteCount == 0) {
+            return;
+        }
+        //Earlier frames may still read the object data and write the levels of detail
+        VkMemoryBarrier vkMemoryBarrier{};
+        vkMemoryBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        vkMemoryBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+        vkMemoryBarrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        vkCmdPipelineBarrier(frameData.vkMainCommandBuffer,
+                             VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT,
+                             VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &vkMemoryBarrier, 0, nullptr, 0, nullptr);
+        //Entities registered together are written together, so runs of consecutive indices become one copy
+        vkEntityCopies.clear();
+        for (size_t i = 0; i < entityWrites.size(); i++) {
+            const VkDeviceSize dstOffset = entityWrites[i] * sizeof(MeshRenderData);
+            if (!vkEntityCopies.empty() &&
+                vkEntityCopies.back().dstOffset + vkEntityCopies.back().size == dstOffset) {
+                vkEntityCopies.back().size += sizeof(MeshRenderData);
+            } else {
+                vkEntityCopies.push_back({objectWritesOffset + i * sizeof(MeshRenderData), dstOffset,
+                                          sizeof(MeshRenderData)});
+            }
+        }
+        if (!vkEntityCopies.empty()) {
+            vkCmdCopyBuffer(frameData.vkMainCommandBuffer, frameData.objectAllocator.getBuffer(), objectBuffer.vkBuffer,
+                            (uint32_t) vkEntityCopies.size(), vkEntityCopies.data());
+        }
+        if (cullWriteCount > 0) {
+            VkBufferCopy vkBufferCopy{cullWritesOffset, 0, cullWriteCount * sizeof(CullObject)};
+            vkCmdCopyBuffer(frameData.vkMainCommandBuffer, frameData.objectAllocator.getBuffer(), cullBuffer.vkBuffer,
+                            1, &vkBufferCopy);
+        }
+        vkMemoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        vkMemoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+        vkCmdPipelineBarrier(frameData.vkMainCommandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                             VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT, 0, 1,
+                             &vkMemoryBarrier, 0, nullptr, 0, nullptr);
+    }
+
+    void Renderer::recordCulling(FrameData &frameData, VkDescriptorSet vkDescriptorSet, const Camera &camera,
+                                 uint32_t objectCount) {
+        CullConstants cullConstants{};
+        FrustumCuller::extractPlanes(camera.data.projection * camera.data.view, cullConstants.planes);
+        //The same projected size selectLod uses
+        cullConstants.cameraPosition = glm::vec4(camera.position, (float) vkWindowExtent.height * 0.5F /
+                                                                  std::tan(camera.fov / 100.0F * 0.5F));
+        cullConstants.objectCount = objectCount;
+        cullConstants.lodErrorThreshold = lodErrorThreshold;
+        cullConstants.lodHysteresis = lodHysteresis;
+        cullConstants.nearClipPlane = camera.nearClipPlane;
+
+        vkCmdBindPipeline(frameData.vkMainCommandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, vkCullPipeline);
+        vkCmdBindDescriptorSets(frameData.vkMainCommandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE,
+                                pipelineBuilder.vkComputePipelineLayout, 0, 1, &vkDescriptorSet, 0, nullptr);
+        vkCmdPushConstants(frameData.vkMainCommandBuffer, pipelineBuilder.vkComputePipelineLayout,
+                           VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(CullConstants), &cullConstants);
+        //64 invocations per workgroup, see cull.comp
+        vkCmdDispatch(frameData.vkMainCommandBuffer, (objectCount + 63) / 64, 1, 1);
+
+        //The draws read the commands and visible instances, the host reads the commands back once the fence signaled
+        VkMemoryBarrier vkMemoryBarrier{};
+        vkMemoryBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        vkMemoryBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+        vkMemoryBarrier.dstAccessMask =
+                VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_HOST_READ_BIT;
+        vkCmdPipelineBarrier(frameData.vkMainCommandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                             VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT |
+                             VK_PIPELINE_STAGE_HOST_BIT, 0, 1, &vkMemoryBarrier, 0, nullptr, 0, nullptr);
+    }
+
+    void Renderer::recordReadback(FrameData &frameData, VkImage vkImage) {
+        //The render pass left the image in VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, its outgoing dependency makes the
+        //copy wait for the color writes
+        VkBufferImageCopy vkBufferImageCopy{};
+        vkBufferImageCopy.bufferOffset = 0;
+        //Tightly packed rows
+        vkBufferImageCopy.bufferRowLength = 0;
+        vkBufferImageCopy.bufferImageHeight = 0;
+        vkBufferImageCopy.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        vkBufferImageCopy.imageSubresource.mipLevel = 0;
+        vkBufferImageCopy.imageSubresource.baseArrayLayer = 0;
+        vkBufferImageCopy.imageSubresource.layerCount = 1;
+        vkBufferImageCopy.imageExtent = {vkWindowExtent.width, vkWindowExtent.height, 1};
+        vkCmdCopyImageToBuffer(frameData.vkMainCommandBuffer, vkImage, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                               frameData.readbackBuffer.vkBuffer, 1, &vkBufferImageCopy);
+
+        //The host reads the buffer once the frame's fence signaled
+        VkMemoryBarrier vkMemoryBarrier{};
+        vkMemoryBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        vkMemoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        vkMemoryBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+        vkCmdPipelineBarrier(frameData.vkMainCommandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT,
+                             0, 1, &vkMemoryBarrier, 0, nullptr, 0, nullptr);
+        frameData.readbackPending = true;
+        frameData.readbackFrame = frameCount;
+    }
+
+    void Renderer::deliverReadback(FrameData &frameData) {
+        frameData.readbackPending = false;
+        if (!readbackCallback) {
+            return;
+        }
+        const VkDeviceSize size = (VkDeviceSize) vkWindowExtent.width * vkWindowExtent.height * 4;
+        void *pixels;
+        VK_HANDLE_ERROR(vmaMapMemory(allocator, frameData.readbackBuffer.allocation, &pixels),
+                        "Failed to map a readback buffer!");
+        //GPU_TO_CPU memory may be cached without being coherent
+        vmaInvalidateAllocation(allocator, frameData.readbackBuffer.allocation, 0, size);
+        readbackCallback(frameData.readbackFrame, (const uint8_t *) pixels);
+        vmaUnmapMemory(allocator, frameData.readbackBuffer.allocation);
+    }
+
+    void Renderer::flushReadbacks() {
+        //The frame rendered next is the oldest one in flight, the callback sees the frames in the order they were
+        //rendered
+        for (uint32_t i = 0; i < bufferingAmount; i++) {
+            FrameData &frameData = frames[(frameCount + i) % bufferingAmount];
+            if (frameData.readbackPending) {
+                VK_HANDLE_ERROR(vkWaitForFences(vkLogicalDevice, 1, &frameData.vkRenderFence, true, UINT64_MAX),
+                                "Failed to wait for render fence!");
+                deliverReadback(frameData);
+            }
+        }
+    }
+
+    uint32_t Renderer::recordBatches(VkCommandBuffer vkCommandBuffer, const FrameData &frameData, const Camera &camera,
+                                     VkDescriptorSet vkDescriptorSet, size_t first, size_t last, bool culling,
+                                     BindCounters &counters) const {
+        if (first == last) {
+            return 0;
+        }
+        //Secondary command buffers start without any state, so everything is bound again. Push constants and
+        //descriptor sets only need the layout, which every graphics pipeline shares.
+        vkCmdPushConstants(vkCommandBuffer, pipelineBuilder.vkPipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0,
+                           sizeof(CameraData), &camera.data);
+        vkCmdBindDescriptorSets(vkCommandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineBuilder.vkPipelineLayout,
+                                0, 1, &vkDescriptorSet, 0, nullptr);
+        //Dynamic in every pipeline, so a resize doesn't rebuild them
+        VkViewport vkViewport{};
+        vkViewport.x = 0;
+        vkViewport.y = 0;
+        vkViewport.width = (float) vkWindowExtent.width;
+        vkViewport.height = (float) vkWindowExtent.height;
+        vkViewport.minDepth = 0.0F;
+        vkViewport.maxDepth = 1.0F;
+        VkRect2D vkScissor{};
+        vkScissor.offset = {0, 0};
+        vkScissor.extent = vkWindowExtent;
+        vkCmdSetViewport(vkCommandBuffer, 0, 1, &vkViewport);
+        vkCmdSetScissor(vkCommandBuffer, 0, 1, &vkScissor);
+        counters.descriptorSetBinds++;
+        counters.descriptorSetBindsSkipped += (uint32_t) (last - first - 1);
+        VkPipeline vkBoundPipeline = VK_NULL_HANDLE;
+        VkBuffer vkBoundVertexBuffer = VK_NULL_HANDLE;
+        VkBuffer vkBoundIndexBuffer = VK_NULL_HANDLE;
+        uint32_t drawCalls = 0;
+        for (size_t runFirst = first, runLast = first; runFirst < last; runFirst = runLast) {
+            const DrawBatch &drawBatch = drawBatches[runFirst];
+            //Batches with the same state are drawn together, the key's sort order keeps them next to each other
+            while (runLast < last && drawBatches[runLast].vkPipeline == drawBatch.vkPipeline &&
+                   drawBatches[runLast].vkVertexBuffer == drawBatch.vkVertexBuffer &&
+                   drawBatches[runLast].vkIndexBuffer == drawBatch.vkIndexBuffer) {
+                runLast++;
+            }
+            //Every batch after the run's first one reuses all of its state
+            const uint32_t sharedBatches = (uint32_t) (runLast - runFirst - 1);
+            if (drawBatch.vkPipeline != vkBoundPipeline) {
+                vkBoundPipeline = drawBatch.vkPipeline;
+                vkCmdBindPipeline(vkCommandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, vkBoundPipeline);
+                counters.pipelineBinds++;
+            } else {
+                counters.pipelineBindsSkipped++;
+            }
+            counters.pipelineBindsSkipped += sharedBatches;
+            //Device local meshes share the arena buffers, so these only change with the vertex format
+            if (drawBatch.vkVertexBuffer != vkBoundVertexBuffer) {
+                VkDeviceSize offset = 0;
+                vkBoundVertexBuffer = drawBatch.vkVertexBuffer;
+                vkCmdBindVertexBuffers(vkCommandBuffer, 0, 1, &vkBoundVertexBuffer, &offset);
+                counters.vertexBufferBinds++;
+            } else {
+                counters.vertexBufferBindsSkipped++;
+            }
+            counters.vertexBufferBindsSkipped += sharedBatches;
+            if (drawBatch.vkIndexBuffer != vkBoundIndexBuffer) {
+                vkBoundIndexBuffer = drawBatch.vkIndexBuffer;
+                vkCmdBindIndexBuffer(vkCommandBuffer, vkBoundIndexBuffer, 0, VK_INDEX_TYPE_UINT32);
+                counters.indexBufferBinds++;
+            } else {
+                counters.indexBufferBindsSkipped++;
+            }
+            counters.indexBufferBindsSkipped += sharedBatches;
+            if (culling) {
+                drawCalls += recordIndirectDraws(vkCommandBuffer, frameData, runFirst, runLast);
+            } else {
+                for (size_t batch = runFirst; batch < runLast; batch++) {
+                    const VkDrawIndexedIndirectCommand &command = drawBatches[batch].command;
+                    vkCmdDrawIndexed(vkCommandBuffer, command.indexCount, command.instanceCount,
+                                     command.firstIndex, command.vertexOffset, command.firstInstance);
+                    drawCalls++;
+                }
+            }
+        }
+        return drawCalls;
+    }
+
+    uint32_t Renderer::recordIndirectDraws(VkCommandBuffer vkCommandBuffer, const FrameData &frameData, size_t first,
+                                           size_t last) const {
+        //The culling pass's error of each level follows its command
+        const uint32_t stride = sizeof(CullDrawCommand);
+        //One command per draw without multi draw indirect
+        const size_t maxDrawCount = multiDrawIndirectSupported
+                                    ? gpu.vkPhysicalDeviceProperties.limits.maxDrawIndirectCount : 1;
+        uint32_t drawCalls = 0;
+        while (first < last) {
+            const uint32_t drawCount = (uint32_t) std::min(last - first, maxDrawCount);
+            vkCmdDrawIndexedIndirect(vkCommandBuffer, frameData.objectAllocator.getBuffer(),
+                                     frameData.drawCommandsOffset + first * stride, drawCount, stride);
+            drawCalls++;
+            first += drawCount;
+        }
+        return drawCalls;
+    }
+
+    void Renderer::initSecondaryCommandBuffers() {
+        if (recordingThreadCount <= 1) {
+            return;
+        }
+        recordingThreadPool = std::make_unique<ThreadPool>(recordingThreadCount);
+        VkCommandPoolCreateInfo vkCommandPoolCreateInfo{};
+        vkCommandPoolCreateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+        //Reset as a whole every frame
+        vkCommandPoolCreateInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+        vkCommandPoolCreateInfo.queueFamilyIndex = vkGraphicsQueueFamilyIndex;
+        for (uint32_t i = 0; i < bufferingAmount; i++) {
+            //Command pools can't be used by two threads at once, so each thread records from its own
+            frames[i].vkSecondaryCommandPools.resize(recordingThreadCount);
+            frames[i].vkSecondaryCommandBuffers.resize(recordingThreadCount);
+            for (uint32_t thread = 0; thread < recordingThreadCount; thread++) {
+                VK_HANDLE_ERROR(vkCreateCommandPool(vkLogicalDevice, &vkCommandPoolCreateInfo, nullptr,
+                                                    &frames[i].vkSecondaryCommandPools[thread]),
+                                "Failed to create a secondary command pool!");
+                VkCommandBufferAllocateInfo vkCommandBufferAllocateInfo{};
+                vkCommandBufferAllocateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+                vkCommandBufferAllocateInfo.commandPool = frames[i].vkSecondaryCommandPools[thread];
+                vkCommandBufferAllocateInfo.commandBufferCount = 1;
+                vkCommandBufferAllocateInfo.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+                VK_HANDLE_ERROR(vkAllocateCommandBuffers(vkLogicalDevice, &vkCommandBufferAllocateInfo,
+                                                         &frames[i].vkSecondaryCommandBuffers[thread]),
+                                "Failed to allocate a secondary command buffer!");
+            }
+        }
+    }
+
+    void Renderer::destroySecondaryCommandBuffers() {
+        //Joins the workers
+        recordingThreadPool.reset();
+        for (uint32_t i = 0; i < bufferingAmount; i++) {
+            for (VkCommandPool vkCommandPool : frames[i].vkSecondaryCommandPools) {
+                vkDestroyCommandPool(vkLogicalDevice, vkCommandPool, nullptr);
+            }
+            frames[i].vkSecondaryCommandPools.clear();
+            frames[i].vkSecondaryCommandBuffers.clear();
+        }
+    }
+
+    void Renderer::setRecordingThreadCount(uint32_t threadCount) {
+        threadCount = std::max<uint32_t>(threadCount, 1);
+        if (threadCount == recordingThreadCount) {
+            return;
+        }
+        recordingThreadCount = threadCount;
+        //Before init the buffers are created by init itself
+        if (vkLogicalDevice != VK_NULL_HANDLE) {
+            VK_HANDLE_ERROR(vkDeviceWaitIdle(vkLogicalDevice), "Failed to wait for the device to become idle!");
+            destroySecondaryCommandBuffers();
+            initSecondaryCommandBuffers();
+        }
+    }
+
+    uint32_t Renderer::getRecordingThreadCount() const {
+        return recordingThreadCount;
+    }
+
+    uint32_t Renderer::getVisibleInstanceCount() const {
+        return visibleInstanceCount;
+    }
+
+    uint32_t Renderer::getDrawCallCount() const {
+        return drawCallCount;
+    }
+
+    const BindCounters &Renderer::getBindCounters() const {
+        return bindCounters;
+    }
+
+    float Renderer::getCpuWaitMilliseconds() const {
+        return cpuWaitMilliseconds;
+    }
+
+    VkPresentModeKHR Renderer::getPresentMode() const {
+        return vkPresentMode;
+    }
+
+    bool Renderer::isHeadless() const {
+        return headless;
+    }
+
+    float Renderer::getPipelineBuildMilliseconds() const {
+        return pipelineBuildMilliseconds;
+    }
+
+    bool Renderer::isPipelineCacheWarm() const {
+        return pipelineCacheWarm;
+    }
+
+    float Renderer::getViewDepth(const Camera &camera, const glm::vec3 &position) {
+        //Not negated like in right handed conventions, perspectiveLH maps +z to the depth range
+        return (camera.data.view * glm::vec4(position, 1)).z;
+    }
+
     void Renderer::destroy() {
         vkQueueWaitIdle(vkGraphicsQueue);
         DeletionQueue::flush();
-        vkDestroySwapchainKHR(vkLogicalDevice, vkSwapchain, nullptr);
+        if (vkPipelineCache != VK_NULL_HANDLE) {
+            PipelineCache::store(vkLogicalDevice, vkPipelineCache, pipelineCachePath);
+            vkDestroyPipelineCache(vkLogicalDevice, vkPipelineCache, nullptr);
+        }
+        uploadEngine.destroy();
+        meshRegistry.destroy();
+        if (entityCapacity > 0) {
+            retiredBuffers.push_back({objectBuffer, frameCount});
+            retiredBuffers.push_back({cullBuffer, frameCount});
+        }
+        for (const RetiredBuffer &retiredBuffer : retiredBuffers) {
+            vmaDestroyBuffer(allocator, retiredBuffer.buffer.vkBuffer, retiredBuffer.buffer.allocation);
+        }
+        retiredBuffers.clear();
+        //The current swapchain resources go the same way as the retired ones
+        retiredSwapchains.push_back({vkSwapchain, vkSwapchainImageViews, vkFramebuffers, depthImage, depthImageView,
+                                     frameCount});
+        for (const RetiredSwapchain &retiredSwapchain : retiredSwapchains) {
+            destroySwapchainResources(retiredSwapchain);
+        }
+        retiredSwapchains.clear();
         vkDestroyRenderPass(vkLogicalDevice, vkRenderPass, nullptr);
-        for (int i = 0; i < vkSwapchainImageViews.size(); i++) {
-            vkDestroyFramebuffer(vkLogicalDevice, vkFramebuffers[i], nullptr);
-            vkDestroyImageView(vkLogicalDevice, vkSwapchainImageViews[i], nullptr);
+        for (AllocatedImage &offscreenImage : offscreenImages) {
+            vmaDestroyImage(allocator, offscreenImage.image, offscreenImage.allocation);
         }
 
         vmaDestroyAllocator(allocator);
         vkDestroyDevice(vkLogicalDevice, nullptr);
-        vkDestroySurfaceKHR(vkInstance, vkSurface, nullptr);
+        if (!headless) {
+            vkDestroySurfaceKHR(vkInstance, vkSurface, nullptr);
+        }
         vkb::destroy_debug_utils_messenger(vkInstance, vkDebugUtilsMessenger, nullptr);
         vkDestroyInstance(vkInstance, nullptr);
     }
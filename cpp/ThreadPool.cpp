@@ -2,43 +2,75 @@
 #include <iostream>
 namespace tgl {
     ThreadPool::ThreadPool() :
-    ThreadPool::ThreadPool(std::thread::hardware_concurrency())
+    ThreadPool(std::thread::hardware_concurrency())
     {}
 
     ThreadPool::ThreadPool(uint32_t threadCount) {
         this->threadCount = threadCount = (threadCount == 0 ? 1 : threadCount);
+        tasks.resize(threadCount);
+        threads.reserve(threadCount);
         for (uint32_t i = 0; i < threadCount; i++) {
-            threads.emplace_back([this]() {
-                while (true) {
-                    taskMutex.lock();
-                    if (tasks.find(std::this_thread::get_id()) != tasks.end()) {
-                        for (const auto& task : tasks[std::this_thread::get_id()]) {
-                            task();
-                        }
-                        tasks[std::this_thread::get_id()].clear();
-                    }
-                    taskMutex.unlock();
-                }
+            threads.emplace_back([this, i]() {
+                work(i);
             });
         }
-        threads.reserve(threadCount);
     }
 
-    void ThreadPool::sendTask(uint32_t threadIndex, const std::function<void()>& task) {
-        std::thread::id threadID = threads[threadIndex].get_id();
-        taskMutex.lock();
-        tasks[threadID].push_back(task);
-        taskMutex.unlock();
+    ThreadPool::~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> lock(taskMutex);
+            stopping = true;
+        }
+        taskCondition.notify_all();
+        for (std::thread& t : threads) {
+            t.join();
+        }
     }
 
-    void ThreadPool::finishTasks() {
-        taskMutex.lock();
-        for (std::thread& t : threads) {
-            for (const auto& task : tasks[t.get_id()]) {
-                task();
+    void ThreadPool::work(uint32_t threadIndex) {
+        std::deque<std::function<void()>>& queue = tasks[threadIndex];
+        while (true) {
+            std::function<void()> task;
+            {
+                std::unique_lock<std::mutex> lock(taskMutex);
+                taskCondition.wait(lock, [&]() {
+                    return stopping || !queue.empty();
+                });
+                if (queue.empty()) {
+                    //Only reachable once we are stopping and have drained our queue
+                    return;
+                }
+                task = std::move(queue.front());
+                queue.pop_front();
             }
-            tasks[t.get_id()].clear();
+            //Run the task without holding the lock so the workers actually execute in parallel
+            task();
+            {
+                std::lock_guard<std::mutex> lock(taskMutex);
+                if (--pendingTasks == 0) {
+                    finishedCondition.notify_all();
+                }
+            }
+        }
+    }
+
+    uint32_t ThreadPool::getThreadCount() const {
+        return threadCount;
+    }
+
+    void ThreadPool::sendTask(uint32_t threadIndex, const std::function<void()>& task) {
+        {
+            std::lock_guard<std::mutex> lock(taskMutex);
+            tasks[threadIndex % threadCount].push_back(task);
+            pendingTasks++;
         }
-        taskMutex.unlock();
+        taskCondition.notify_all();
+    }
+
+    void ThreadPool::finishTasks() {
+        std::unique_lock<std::mutex> lock(taskMutex);
+        finishedCondition.wait(lock, [this]() {
+            return pendingTasks == 0;
+        });
     }
 }
\ No newline at end of file
@@ -0,0 +1,170 @@
+#include "UploadEngine.h"
+#include "VkUtils.h"
+
+namespace tgl {
+    void UploadEngine::init(VkDevice device, VmaAllocator vmaAllocator, VkQueue transferQueue,
+                            uint32_t transferFamilyIndex, uint32_t graphicsFamilyIndex) {
+        vkLogicalDevice = device;
+        allocator = vmaAllocator;
+        vkTransferQueue = transferQueue;
+        transferQueueFamilyIndex = transferFamilyIndex;
+        graphicsQueueFamilyIndex = graphicsFamilyIndex;
+
+        VkCommandPoolCreateInfo vkCommandPoolCreateInfo{};
+        vkCommandPoolCreateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+        //Every upload command buffer is recorded once and freed once its copies are done
+        vkCommandPoolCreateInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+        vkCommandPoolCreateInfo.queueFamilyIndex = transferQueueFamilyIndex;
+        VK_HANDLE_ERROR(vkCreateCommandPool(vkLogicalDevice, &vkCommandPoolCreateInfo, nullptr, &vkCommandPool),
+                        "Failed to create the upload command pool!");
+        INFO((hasDedicatedTransferQueue() ? "Uploading on the dedicated transfer queue family "
+                                          : "No dedicated transfer queue, uploading on the graphics queue family ")
+                     << transferQueueFamilyIndex);
+    }
+
+    bool UploadEngine::hasDedicatedTransferQueue() const {
+        return transferQueueFamilyIndex != graphicsQueueFamilyIndex;
+    }
+
+    VkBufferMemoryBarrier UploadEngine::createOwnershipBarrier(const UploadCopy &copy) const {
+        VkBufferMemoryBarrier vkBufferMemoryBarrier{};
+        vkBufferMemoryBarrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+        vkBufferMemoryBarrier.srcQueueFamilyIndex = transferQueueFamilyIndex;
+        vkBufferMemoryBarrier.dstQueueFamilyIndex = graphicsQueueFamilyIndex;
+        vkBufferMemoryBarrier.buffer = copy.vkDstBuffer;
+        vkBufferMemoryBarrier.offset = copy.vkBufferCopy.dstOffset;
+        vkBufferMemoryBarrier.size = copy.vkBufferCopy.size;
+        return vkBufferMemoryBarrier;
+    }
+
+    void UploadEngine::submit(const AllocatedBuffer &stagingBuffer, const std::vector<UploadCopy> &copies) {
+        Submission submission;
+        submission.stagingBuffer = stagingBuffer;
+
+        VkCommandBufferAllocateInfo vkCommandBufferAllocateInfo{};
+        vkCommandBufferAllocateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        vkCommandBufferAllocateInfo.commandPool = vkCommandPool;
+        vkCommandBufferAllocateInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        vkCommandBufferAllocateInfo.commandBufferCount = 1;
+        VK_HANDLE_ERROR(vkAllocateCommandBuffers(vkLogicalDevice, &vkCommandBufferAllocateInfo,
+                                                 &submission.vkCommandBuffer),
+                        "Failed to allocate an upload command buffer!");
+        VkUtils::beginCommandBuffer(vkCommandPool, VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+                                    &submission.vkCommandBuffer);
+        for (const UploadCopy &copy : copies) {
+            vkCmdCopyBuffer(submission.vkCommandBuffer, stagingBuffer.vkBuffer, copy.vkDstBuffer, 1,
+                            &copy.vkBufferCopy);
+        }
+        if (hasDedicatedTransferQueue()) {
+            //Release half of the ownership transfer, the destination access happens on the graphics queue
+            std::vector<VkBufferMemoryBarrier> releases;
+            releases.reserve(copies.size());
+            for (const UploadCopy &copy : copies) {
+                VkBufferMemoryBarrier release = createOwnershipBarrier(copy);
+                release.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+                releases.push_back(release);
+
+                VkBufferMemoryBarrier acquire = createOwnershipBarrier(copy);
+                acquire.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT;
+                pendingAcquires.push_back(acquire);
+            }
+            vkCmdPipelineBarrier(submission.vkCommandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                                 VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr,
+                                 (uint32_t) releases.size(), releases.data(), 0, nullptr);
+        }
+        VK_HANDLE_ERROR(vkEndCommandBuffer(submission.vkCommandBuffer), "Failed to record an upload command buffer!");
+
+        if (!freeFences.empty()) {
+            submission.vkFence = freeFences.back();
+            freeFences.pop_back();
+        } else {
+            VkFenceCreateInfo vkFenceCreateInfo{};
+            vkFenceCreateInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+            VK_HANDLE_ERROR(vkCreateFence(vkLogicalDevice, &vkFenceCreateInfo, nullptr, &submission.vkFence),
+                            "Failed to create an upload fence!");
+        }
+        if (!freeSemaphores.empty()) {
+            submission.vkSemaphore = freeSemaphores.back();
+            freeSemaphores.pop_back();
+        } else {
+            VkSemaphoreCreateInfo vkSemaphoreCreateInfo{};
+            vkSemaphoreCreateInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+            VK_HANDLE_ERROR(vkCreateSemaphore(vkLogicalDevice, &vkSemaphoreCreateInfo, nullptr, &submission.vkSemaphore),
+                            "Failed to create an upload semaphore!");
+        }
+
+        VkSubmitInfo vkSubmitInfo{};
+        vkSubmitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        vkSubmitInfo.commandBufferCount = 1;
+        vkSubmitInfo.pCommandBuffers = &submission.vkCommandBuffer;
+        vkSubmitInfo.signalSemaphoreCount = 1;
+        vkSubmitInfo.pSignalSemaphores = &submission.vkSemaphore;
+        VK_HANDLE_ERROR(vkQueueSubmit(vkTransferQueue, 1, &vkSubmitInfo, submission.vkFence),
+                        "Failed to submit an upload!");
+        pendingSemaphores.push_back(submission.vkSemaphore);
+        submissions.push_back(submission);
+    }
+
+    std::vector<VkSemaphore> UploadEngine::takeWaitSemaphores(uint64_t frame) {
+        for (Submission &submission : submissions) {
+            if (submission.consumingFrame == UINT64_MAX) {
+                submission.consumingFrame = frame;
+            }
+        }
+        std::vector<VkSemaphore> semaphores;
+        semaphores.swap(pendingSemaphores);
+        return semaphores;
+    }
+
+    void UploadEngine::recordAcquireBarriers(VkCommandBuffer vkCommandBuffer) {
+        if (pendingAcquires.empty()) {
+            return;
+        }
+        //The source stage matches the semaphore wait stage, so the acquire is ordered after the transfer queue's release
+        vkCmdPipelineBarrier(vkCommandBuffer, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, 0,
+                             0, nullptr, (uint32_t) pendingAcquires.size(), pendingAcquires.data(), 0, nullptr);
+        pendingAcquires.clear();
+    }
+
+    void UploadEngine::collect(uint64_t currentFrame, uint32_t framesInFlight) {
+        for (Submission &submission : submissions) {
+            if (!submission.finished && vkGetFenceStatus(vkLogicalDevice, submission.vkFence) == VK_SUCCESS) {
+                vmaDestroyBuffer(allocator, submission.stagingBuffer.vkBuffer, submission.stagingBuffer.allocation);
+                vkFreeCommandBuffers(vkLogicalDevice, vkCommandPool, 1, &submission.vkCommandBuffer);
+                vkResetFences(vkLogicalDevice, 1, &submission.vkFence);
+                freeFences.push_back(submission.vkFence);
+                submission.finished = true;
+            }
+        }
+        while (!submissions.empty() && submissions.front().finished &&
+               submissions.front().consumingFrame != UINT64_MAX &&
+               submissions.front().consumingFrame + framesInFlight <= currentFrame) {
+            freeSemaphores.push_back(submissions.front().vkSemaphore);
+            submissions.pop_front();
+        }
+    }
+
+    void UploadEngine::destroy() {
+        vkQueueWaitIdle(vkTransferQueue);
+        for (Submission &submission : submissions) {
+            if (!submission.finished) {
+                vmaDestroyBuffer(allocator, submission.stagingBuffer.vkBuffer, submission.stagingBuffer.allocation);
+                vkDestroyFence(vkLogicalDevice, submission.vkFence, nullptr);
+            }
+            vkDestroySemaphore(vkLogicalDevice, submission.vkSemaphore, nullptr);
+        }
+        for (VkFence vkFence : freeFences) {
+            vkDestroyFence(vkLogicalDevice, vkFence, nullptr);
+        }
+        for (VkSemaphore vkSemaphore : freeSemaphores) {
+            vkDestroySemaphore(vkLogicalDevice, vkSemaphore, nullptr);
+        }
+        //Frees the remaining command buffers with it
+        vkDestroyCommandPool(vkLogicalDevice, vkCommandPool, nullptr);
+        submissions.clear();
+        pendingSemaphores.clear();
+        pendingAcquires.clear();
+        freeFences.clear();
+        freeSemaphores.clear();
+    }
+}
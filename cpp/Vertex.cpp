@@ -1,4 +1,5 @@
 #include "Vertex.h"
+#include <cmath>
 
 namespace tgl {
     VertexInputDescription Vertex::getVertexDescription() {
@@ -31,6 +32,72 @@ namespace tgl {
         return vertexInputDescription;
     }
 
+    VertexInputDescription Vertex::getVertexDescription(VertexFormat vertexFormat) {
+        return vertexFormat == VERTEX_FORMAT_PACKED ? PackedVertex::getVertexDescription() : getVertexDescription();
+    }
+
+    VertexInputDescription PackedVertex::getVertexDescription() {
+        //Same locations as tgl::Vertex, the shader decodes position and normal
+        VertexInputDescription vertexInputDescription;
+        VkVertexInputBindingDescription mainBinding = {};
+        mainBinding.binding = 0;
+        mainBinding.stride = sizeof(PackedVertex);
+        mainBinding.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+        vertexInputDescription.bindings.push_back(mainBinding);
+        VkVertexInputAttributeDescription positionAttribute = {};
+        positionAttribute.binding = 0;
+        positionAttribute.location = 0;
+        positionAttribute.format = VK_FORMAT_R16G16B16A16_UNORM;
+        positionAttribute.offset = offsetof(PackedVertex, position);
+        VkVertexInputAttributeDescription normalAttribute = {};
+        normalAttribute.binding = 0;
+        normalAttribute.location = 1;
+        normalAttribute.format = VK_FORMAT_R16G16_SNORM;
+        normalAttribute.offset = offsetof(PackedVertex, normal);
+        VkVertexInputAttributeDescription colorAttribute = {};
+        colorAttribute.binding = 0;
+        colorAttribute.location = 2;
+        colorAttribute.format = VK_FORMAT_R8G8B8A8_UNORM;
+        colorAttribute.offset = offsetof(PackedVertex, color);
+        vertexInputDescription.attributes.push_back(positionAttribute);
+        vertexInputDescription.attributes.push_back(normalAttribute);
+        vertexInputDescription.attributes.push_back(colorAttribute);
+
+        return vertexInputDescription;
+    }
+
+    static float signNotZero(float value) {
+        return value >= 0.0F ? 1.0F : -1.0F;
+    }
+
+    PackedVertex PackedVertex::pack(const Vertex& vertex, glm::vec3 boundsMin, glm::vec3 boundsMax) {
+        PackedVertex packed{};
+        for (int i = 0; i < 3; i++) {
+            const float extent = boundsMax[i] - boundsMin[i];
+            const float normalized = extent > 0.0F ? (vertex.position[i] - boundsMin[i]) / extent : 0.0F;
+            packed.position[i] = (uint16_t) std::lround(glm::clamp(normalized, 0.0F, 1.0F) * 65535.0F);
+        }
+
+        //Octahedral encoding: project onto the octahedron |x| + |y| + |z| = 1 and fold the lower half over the upper
+        const glm::vec3 &normal = vertex.normal;
+        const float sum = std::fabs(normal.x) + std::fabs(normal.y) + std::fabs(normal.z);
+        float x = sum > 0.0F ? normal.x / sum : 0.0F;
+        float y = sum > 0.0F ? normal.y / sum : 0.0F;
+        if (normal.z < 0.0F) {
+            const float foldedX = (1.0F - std::fabs(y)) * signNotZero(x);
+            const float foldedY = (1.0F - std::fabs(x)) * signNotZero(y);
+            x = foldedX;
+            y = foldedY;
+        }
+        packed.normal[0] = (int16_t) std::lround(glm::clamp(x, -1.0F, 1.0F) * 32767.0F);
+        packed.normal[1] = (int16_t) std::lround(glm::clamp(y, -1.0F, 1.0F) * 32767.0F);
+
+        for (int i = 0; i < 4; i++) {
+            packed.color[i] = (uint8_t) std::lround(glm::clamp(vertex.color[i], 0.0F, 1.0F) * 255.0F);
+        }
+        return packed;
+    }
+
     Vertex::Vertex(glm::vec3 position, glm::vec3 normal, glm::vec4 color) {
         this->position = position;
         this->normal = normal;
@@ -44,4 +111,17 @@ namespace tgl {
     bool Vertex::operator!=(const Vertex &b) const {
         return position != b.position || normal != b.normal || color != b.color;
     }
+
+    uint64_t Vertex::hash() const {
+        //Adding zero turns -0.0 into 0.0, which compare equal but differ bytewise
+        Vertex canonical = *this;
+        for (int i = 0; i < 3; i++) {
+            canonical.position[i] += 0.0F;
+            canonical.normal[i] += 0.0F;
+        }
+        for (int i = 0; i < 4; i++) {
+            canonical.color[i] += 0.0F;
+        }
+        return Hash::hash64(&canonical, sizeof(Vertex));
+    }
 }
\ No newline at end of file
@@ -0,0 +1,62 @@
+#include "VertexHashTable.h"
+
+namespace tgl {
+    static uint64_t nextPowerOfTwo(uint64_t value) {
+        uint64_t result = 16;
+        while (result < value) {
+            result <<= 1;
+        }
+        return result;
+    }
+
+    VertexHashTable::VertexHashTable(size_t maxVertexCount) {
+        //Keep the load factor at or below one half so probe sequences stay short
+        slots.resize(nextPowerOfTwo(maxVertexCount * 2), {EMPTY_SLOT, 0});
+        mask = slots.size() - 1;
+    }
+
+    void VertexHashTable::grow(const std::vector<Vertex>& vertices) {
+        std::vector<Slot> oldSlots(slots.size() * 2, {EMPTY_SLOT, 0});
+        oldSlots.swap(slots);
+        mask = slots.size() - 1;
+        for (const Slot& slot : oldSlots) {
+            if (slot.vertexIndex == EMPTY_SLOT) {
+                continue;
+            }
+            uint64_t position = vertices[slot.vertexIndex].hash() & mask;
+            while (slots[position].vertexIndex != EMPTY_SLOT) {
+                position = (position + 1) & mask;
+            }
+            slots[position] = slot;
+        }
+    }
+
+    uint32_t VertexHashTable::insert(const Vertex& vertex, std::vector<Vertex>& vertices) {
+        if ((size + 1) * 2 > slots.size()) {
+            grow(vertices);
+        }
+        lookupCount++;
+        const uint64_t hash = vertex.hash();
+        const uint32_t fingerprint = (uint32_t) (hash >> 32);
+        uint64_t position = hash & mask;
+        while (true) {
+            Slot& slot = slots[position];
+            if (slot.vertexIndex == EMPTY_SLOT) {
+                slot.vertexIndex = (uint32_t) vertices.size();
+                slot.fingerprint = fingerprint;
+                vertices.push_back(vertex);
+                size++;
+                return slot.vertexIndex;
+            }
+            if (slot.fingerprint == fingerprint && vertices[slot.vertexIndex] == vertex) {
+                return slot.vertexIndex;
+            }
+            probeCount++;
+            position = (position + 1) & mask;
+        }
+    }
+
+    double VertexHashTable::getAverageProbeLength() const {
+        return lookupCount == 0 ? 0.0 : (double) probeCount / (double) lookupCount;
+    }
+}
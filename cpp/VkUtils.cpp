@@ -65,25 +65,20 @@ namespace tgl {
         return VK_FORMAT_B8G8R8A8_UNORM;
     }
 
-    VkPresentModeKHR VkUtils::getOptimalPresentMode(std::vector<VkPresentModeKHR>& vkPresentModes) {
+    VkPresentModeKHR VkUtils::getOptimalPresentMode(const std::vector<VkPresentModeKHR>& vkPresentModes,
+                                                    VkPresentModeKHR vkDesiredPresentMode) {
         auto begin = vkPresentModes.begin();
         auto end = vkPresentModes.end();
-        //Search for the most efficient
-        if (std::find(begin, end, VK_PRESENT_MODE_MAILBOX_KHR) != end) { //immidiate is best but has tearing
-            return VK_PRESENT_MODE_MAILBOX_KHR;
-        }
-            //Search for the second most efficient
-        else if (std::find(begin, end, VK_PRESENT_MODE_FIFO_RELAXED_KHR) != end) {
-            return VK_PRESENT_MODE_FIFO_RELAXED_KHR;
+        if (std::find(begin, end, vkDesiredPresentMode) != end) {
+            return vkDesiredPresentMode;
         }
-            //Search for the third most efficient.
-            //This one actually should always be valid...
-        else if (std::find(begin, end, VK_PRESENT_MODE_FIFO_KHR) != end) {
-            return VK_PRESENT_MODE_FIFO_KHR;
-        } else {
-            //Pick the first present mode(random).
-            return vkPresentModes[0];
+        //Without tearing mailbox is the lowest latency mode, so immediate falls back to it
+        if (vkDesiredPresentMode == VK_PRESENT_MODE_IMMEDIATE_KHR &&
+            std::find(begin, end, VK_PRESENT_MODE_MAILBOX_KHR) != end) {
+            return VK_PRESENT_MODE_MAILBOX_KHR;
         }
+        //Every device has to support FIFO
+        return VK_PRESENT_MODE_FIFO_KHR;
     }
 
     void VkUtils::createImageView(VkDevice &vkLogicalDevice, VkImage &vkImage, VkFormat vkFormat,
@@ -170,15 +165,15 @@ namespace tgl {
     }
 
     void
-    VkUtils::createBuffer(VmaAllocator& allocator, VmaAllocation& allocation, VkBuffer &vkBuffer, VkDeviceSize size, VkBufferUsageFlagBits usage) {
+    VkUtils::createBuffer(VmaAllocator& allocator, VmaAllocation& allocation, VkBuffer &vkBuffer, VkDeviceSize size,
+                          VkBufferUsageFlags usage, VmaMemoryUsage memoryUsage) {
         VkBufferCreateInfo vkBufferCreateInfo{};
         vkBufferCreateInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
         vkBufferCreateInfo.size = size;
         vkBufferCreateInfo.usage = usage;
 
         VmaAllocationCreateInfo vmaAllocationCreateInfo{};
-        //Allocated by the CPU, visible/readable by the GPU.
-        vmaAllocationCreateInfo.usage = VMA_MEMORY_USAGE_CPU_TO_GPU;
+        vmaAllocationCreateInfo.usage = memoryUsage;
         VK_HANDLE_ERROR(
                 vmaCreateBuffer(allocator, &vkBufferCreateInfo,
                                 &vmaAllocationCreateInfo,
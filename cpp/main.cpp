@@ -101,7 +101,7 @@ int main() {
     //Initialize TGL
     TGL::init();
     //Create window
-    window = Window("Test Window", 1280, 720, false, {0, 0, 1, 1});
+    window = Window("Test Window", 1280, 720, true, {0, 0, 1, 1});
     //Display the window and create a surface to render on
     window.create();
     glfwSetKeyCallback(window.glfwWindow, keyCallback);
@@ -110,15 +110,20 @@ int main() {
     Renderer renderer(&window, 3);
     renderer.init();
 
-    std::vector<Entity> entities;
+    //Loads in the background, the entities show up once the mesh is uploaded. All of them share its GPU buffers.
+    MeshLoadOptions loadOptions;
+    loadOptions.lodRatios = {0.5F, 0.25F, 0.125F};
+    MeshHandle ironManMesh = renderer.addMeshAsync(
+            MeshLoader::loadObjAsync("../resources/models/IronMan.obj", {1, 0, 0, 1}, loadOptions));
     for (uint32_t i = 0; i < 2; i++) {
-        Entity entity;
+        Entity entity(ironManMesh);
         entity.scale = {0.05, 0.05, 0.05};
-        entity.mesh = MeshLoader::loadObj("../resources/models/IronMan.obj", {1, 0, 0, 1});
         entity.position = {i * 4, 1, i * 4};
         renderer.uploadEntity(entity);
-        entities.push_back(entity);
+        renderer.registerEntity(entity);
     }
+    //The entities hold their own references now
+    renderer.releaseMesh(ironManMesh);
     GPU gpu = renderer.gpu;
     std::cout << "GPU NAME: " << gpu.name << std::endl;
     std::cout << "GPU TYPE: " << gpu.type << std::endl;
@@ -132,23 +137,24 @@ int main() {
     camera.position = {0, 0, 0};
 
     camera.sensitivity = 1;
-    double deltaTime, lastFrameTime;
+    double lastFrameTime = glfwGetTime();
     Light light{};
     light.position = {0, -6, 0};
-    renderer.registerEntities(entities);
-    while (!window.hasRequestedClose()) {
+    //Input is read by the renderer right before it uses the camera, after it waited for the GPU and the swapchain
+    renderer.inputCallback = [&]() {
         //Update the window events. We need this to detect if they requested to close the window for example.
         window.updateEvents();
-        renderer.render(camera, light);
-        updateCamera(camera, window, renderer, deltaTime);
-        double now = glfwGetTime() * 1000;
-        deltaTime = (now - lastFrameTime) / 1000.0;
+        double now = glfwGetTime();
+        updateCamera(camera, window, renderer, now - lastFrameTime);
         lastFrameTime = now;
+    };
+    while (!window.hasRequestedClose()) {
+        renderer.render(camera, light);
     }
 
-    //Destroy the renderer
-    renderer.destroy();
+    //Release the entities' meshes, then destroy the renderer
     renderer.clearEntities();
+    renderer.destroy();
     //Destroy the window
     window.destroy();
     //Terminate TGL
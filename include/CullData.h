@@ -0,0 +1,44 @@
+#pragma once
+#include "VMAIncluder.h"
+#include <glm/glm.hpp>
+#include <cstdint>
+
+namespace tgl {
+    //Culling input of one entity, one element of the CullBuffer storage buffer array in cull.comp. Kept in a
+    //persistent buffer indexed like the entities and only rewritten when the draw commands are rebuilt.
+    struct CullObject {
+        //Bounding sphere in model space, xyz is the center and w the radius. The shader transforms it with the
+        //model matrix of the entity's MeshRenderData.
+        glm::vec4 sphere;
+        //Draw command of the mesh's first level of detail, the levels follow it
+        uint32_t firstBatch;
+        //0 while the entity isn't drawn, e.g. because its mesh is still loading
+        uint32_t lodCount;
+        //Level of detail picked last time the entity was visible, cull.comp updates it
+        uint32_t lod;
+        uint32_t padding;
+    };
+    static_assert(sizeof(CullObject) == 32, "tgl::CullObject must match the std430 layout of cull.comp");
+
+    //Draw command as cull.comp sees it, the indirect draws read the command at its start with this stride
+    struct CullDrawCommand {
+        VkDrawIndexedIndirectCommand command;
+        //Simplification error of the command's level of detail, see MeshLod
+        float lodError;
+        uint32_t padding[2];
+    };
+    static_assert(sizeof(CullDrawCommand) == 32, "tgl::CullDrawCommand must match the std430 layout of cull.comp");
+
+    //Push constants of cull.comp
+    struct CullConstants {
+        //Frustum planes pointing inwards, xyz is the normal and w the distance
+        glm::vec4 planes[6];
+        //xyz is the camera position and w the pixels per world unit at a distance of 1, see Renderer::selectLod
+        glm::vec4 cameraPosition;
+        uint32_t objectCount;
+        float lodErrorThreshold;
+        float lodHysteresis;
+        float nearClipPlane;
+    };
+    static_assert(sizeof(CullConstants) <= 128, "tgl::CullConstants must fit the guaranteed push constant size");
+}
@@ -0,0 +1,59 @@
+#pragma once
+#include "VkUtils.h"
+#include <vector>
+#include <deque>
+#include <cstdint>
+
+namespace tgl {
+    //Descriptors of one type a pool reserves per set it can hold
+    struct DescriptorPoolRatio {
+        VkDescriptorType type;
+        float ratio;
+    };
+
+    //Allocates descriptor sets from a chain of pools. When the current pool runs out, the next free pool is used or a
+    //larger one is created, so the number of sets is only limited by memory. reset hands every set back at once,
+    //which makes a per-frame instance suited for transient sets: reset it once the frame's fence signaled.
+    class DescriptorAllocator {
+    private:
+        static constexpr uint32_t MAX_SETS_PER_POOL = 4096;
+
+        VkDevice vkLogicalDevice{};
+        std::vector<DescriptorPoolRatio> poolRatios;
+        //Sets the next created pool holds, grows with every pool
+        uint32_t setsPerPool = 0;
+        //Pools that may still have room, the last one is allocated from
+        std::vector<VkDescriptorPool> readyPools;
+        //Pools that ran out, reused after reset
+        std::vector<VkDescriptorPool> fullPools;
+
+        //Sets created to true if the returned pool is new, so a set that doesn't even fit in it can be detected
+        VkDescriptorPool getPool(bool& created);
+        VkDescriptorPool createPool(uint32_t setCount);
+
+    public:
+        void init(VkDevice vkLogicalDevice, uint32_t initialSetsPerPool, const std::vector<DescriptorPoolRatio>& ratios);
+
+        void allocate(VkDescriptorSetLayout vkDescriptorSetLayout, VkDescriptorSet* vkDescriptorSet);
+        //Allocates count sets with the same layout, from as few pools as possible. Throws std::runtime_error if a set
+        //doesn't even fit in a new pool or allocation fails for another reason than a full pool.
+        void allocate(VkDescriptorSetLayout vkDescriptorSetLayout, uint32_t count, VkDescriptorSet* vkDescriptorSets);
+
+        //Frees every set allocated so far, the pools are kept for the next allocations
+        void reset();
+        void destroy();
+    };
+
+    //Collects descriptor writes so they go to the driver in a single vkUpdateDescriptorSets call
+    class DescriptorWriter {
+    private:
+        //A deque so the pointers held by the writes stay valid as it grows
+        std::deque<VkDescriptorBufferInfo> bufferInfos;
+        std::vector<VkWriteDescriptorSet> writes;
+
+    public:
+        void writeBuffer(VkDescriptorSet vkDescriptorSet, uint32_t binding, VkDescriptorType type, VkBuffer vkBuffer,
+                         VkDeviceSize offset, VkDeviceSize range);
+        void update(VkDevice vkLogicalDevice);
+    };
+}
@@ -1,15 +1,26 @@
 #pragma once
-#include "Mesh.h"
+#include "MeshRegistry.h"
+#include "MeshRenderData.h"
 namespace tgl {
     class Entity {
     public:
         glm::vec3 position{};
         float pitch, yaw, roll;
         glm::vec3 scale;
-        Mesh mesh;
-        bool registered;
+        //Shared geometry in the renderer's MeshRegistry
+        MeshHandle mesh;
+        //Object data, written to the renderer's object buffer when the entity is registered or moved
+        MeshRenderData renderData{};
+        //World space bounding sphere, xyz is the center and w the radius. Updated by the renderer along with
+        //renderData.
+        glm::vec4 bounds{};
+        //Set by Renderer::uploadEntity. Entities are only drawn if their mesh is resident as well.
+        bool resident = false;
+        //Level of detail drawn last frame, the renderer updates it from the entity's projected size. With GPU culling
+        //the culling pass picks it instead and this is only where it starts from.
+        uint32_t lod = 0;
         Entity() = default;
-        explicit Entity(const Mesh& mesh);
-        Entity(const Mesh& mesh, glm::vec3 position, float pitch, float yaw, glm::vec3 scale);
+        explicit Entity(MeshHandle mesh);
+        Entity(MeshHandle mesh, glm::vec3 position, float pitch, float yaw, glm::vec3 scale);
     };
-}
\ No newline at end of file
+}
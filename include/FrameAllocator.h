@@ -0,0 +1,53 @@
+#pragma once
+#include "AllocatedBuffer.h"
+#include <cstdint>
+
+namespace tgl {
+    //Linear allocator over one persistently mapped buffer, owned by a single frame in flight. Everything it handed
+    //out is dropped at once by reset, which is only safe after that frame's render fence signaled. Together the
+    //frames form a ring, the CPU writes one frame's data while the GPU still reads the others.
+    class FrameAllocator {
+    private:
+        VmaAllocator allocator{};
+        VkBufferUsageFlags usage = 0;
+        AllocatedBuffer buffer{};
+        char* mappedData = nullptr;
+        VkDeviceSize capacity = 0;
+        VkDeviceSize alignment = 1;
+        VkDeviceSize offset = 0;
+
+        void createBuffer(VkDeviceSize size);
+        void destroyBuffer();
+
+    public:
+        static const VkDeviceSize INVALID_OFFSET = UINT64_MAX;
+
+        //alignment has to be a power of two, e.g. minUniformBufferOffsetAlignment for dynamic uniform buffers
+        void init(VmaAllocator allocator, VkBufferUsageFlags usage, VkDeviceSize capacity, VkDeviceSize alignment);
+
+        //Grows the buffer right away if allocationCount more allocations of size bytes in total wouldn't fit. What was
+        //allocated so far keeps its offset, but getBuffer and getMappedData change. The old buffer is destroyed at once,
+        //so like reset this is only safe once the frame's render fence signaled.
+        void reserve(VkDeviceSize size, uint32_t allocationCount);
+        //Returns the aligned offset of size bytes in getBuffer, INVALID_OFFSET if the buffer is full
+        VkDeviceSize allocate(VkDeviceSize size);
+        //Copies size bytes into a new allocation and returns its offset, INVALID_OFFSET if the buffer is full
+        VkDeviceSize push(const void* data, VkDeviceSize size);
+        void* getMappedData(VkDeviceSize allocationOffset) const;
+        //Makes everything written since the last reset visible to the GPU, call it before submitting the frame.
+        //Free on host coherent memory, which VMA skips.
+        void flush();
+        //Makes GPU writes to size bytes at allocationOffset visible to the CPU, call it before reading them back
+        //through the mapping once the frame's fence signaled
+        void invalidate(VkDeviceSize allocationOffset, VkDeviceSize size);
+
+        //Frees every allocation
+        void reset();
+
+        VkBuffer getBuffer() const;
+        VkDeviceSize getCapacity() const;
+        VkDeviceSize getUsedBytes() const;
+
+        void destroy();
+    };
+}
@@ -0,0 +1,18 @@
+#pragma once
+#include <chrono>
+
+namespace tgl {
+    //Paces frames to a fixed rate. Sleeping is only precise to about a millisecond on most systems, so the last part
+    //of every wait is spent spinning, which costs a bit of CPU time for a precise frame start.
+    class FrameLimiter {
+    private:
+        static constexpr std::chrono::microseconds SPIN_TIME{1500};
+        std::chrono::steady_clock::time_point deadline{};
+
+    public:
+        //Blocks until 1 / framesPerSecond after the previous frame started and starts the next one. A frame that
+        //took longer than that starts the schedule over, so missed frames aren't rendered back to back. Returns
+        //right away for framesPerSecond <= 0.
+        void wait(float framesPerSecond);
+    };
+}
@@ -0,0 +1,40 @@
+#pragma once
+#include <glm/glm.hpp>
+#include <vector>
+#include <cstdint>
+
+namespace tgl {
+    //Tests world space bounding spheres against the six planes of a camera frustum. The spheres are kept as a
+    //structure of arrays, so the SIMD path loads the same component of 8 (AVX) or 4 (SSE) spheres with one
+    //instruction and tests them against a plane at once. AVX is picked at runtime if the CPU supports it.
+    class FrustumCuller {
+    private:
+        std::vector<float> centerX;
+        std::vector<float> centerY;
+        std::vector<float> centerZ;
+        std::vector<float> radius;
+        //Returned in the visible list for each sphere, e.g. the index of its entity
+        std::vector<uint32_t> ids;
+
+        //Tests the spheres [first, size) one at a time
+        void cullScalar(const glm::vec4 planes[6], size_t first, std::vector<uint32_t> &visible) const;
+
+    public:
+        //Planes pointing inwards from a view projection matrix, xyz is the normal and w the distance. Vulkan clips
+        //depth to [0, w], so the near plane is the matrix's third row on its own.
+        static void extractPlanes(const glm::mat4 &viewProjection, glm::vec4 planes[6]);
+
+        //Instruction set cull uses on this CPU, "AVX", "SSE" or "scalar"
+        static const char* getInstructionSet();
+
+        void clear();
+        void reserve(size_t count);
+        void add(glm::vec3 center, float sphereRadius, uint32_t id);
+        size_t size() const;
+
+        //Appends the ids of the spheres intersecting the frustum to visible, in the order they were added
+        void cull(const glm::vec4 planes[6], std::vector<uint32_t> &visible) const;
+        //Same result as cull without SIMD, as a reference
+        void cullScalar(const glm::vec4 planes[6], std::vector<uint32_t> &visible) const;
+    };
+}
@@ -0,0 +1,70 @@
+#pragma once
+#include "AllocatedBuffer.h"
+#include <map>
+#include <vector>
+#include <cstdint>
+
+namespace tgl {
+    //Range of elements in one of a GeometryArena's buffers
+    struct GeometryAllocation {
+        static const uint32_t INVALID_BLOCK = UINT32_MAX;
+        uint32_t block = INVALID_BLOCK;
+        //In elements, so it can be used as firstIndex or vertexOffset directly
+        uint32_t offset = 0;
+        uint32_t count = 0;
+
+        bool isValid() const {
+            return block != INVALID_BLOCK;
+        }
+    };
+
+    struct GeometryArenaStats {
+        uint32_t blockCount = 0;
+        //In elements
+        uint64_t capacity = 0;
+        uint64_t used = 0;
+        uint32_t allocationCount = 0;
+        uint32_t freeRangeCount = 0;
+        uint64_t largestFreeRange = 0;
+        //0 if all free space is one range, approaching 1 as it splits into many small ones
+        float fragmentation = 0;
+    };
+
+    //Suballocates ranges of fixed size elements out of a few large device local buffers, so meshes can share them and
+    //be drawn with offsets instead of binding their own buffers. Each buffer keeps a best fit free list that merges
+    //neighbouring ranges on free. A new buffer is only created once no existing one has room.
+    class GeometryArena {
+    private:
+        struct Block {
+            AllocatedBuffer buffer{};
+            uint32_t capacity = 0;
+            uint32_t used = 0;
+            uint32_t allocationCount = 0;
+            //Free ranges by offset
+            std::map<uint32_t, uint32_t> freeRanges;
+        };
+
+        VmaAllocator allocator{};
+        VkBufferUsageFlags usage = 0;
+        uint32_t elementSize = 0;
+        uint32_t blockCapacity = 0;
+        std::vector<Block> blocks;
+
+        bool allocateFromBlock(uint32_t blockIndex, uint32_t count, GeometryAllocation& allocation);
+        uint32_t createBlock(uint32_t capacity);
+
+    public:
+        //Blocks hold blockBytes each, rounded down to whole elements. Larger allocations get a block of their own.
+        void init(VmaAllocator allocator, VkBufferUsageFlags usage, uint32_t elementSize, VkDeviceSize blockBytes);
+
+        //Returns an invalid allocation for count 0
+        GeometryAllocation allocate(uint32_t count);
+        void free(const GeometryAllocation& allocation);
+
+        VkBuffer getBuffer(uint32_t block) const;
+        uint32_t getElementSize() const;
+        GeometryArenaStats getStats() const;
+
+        void destroy();
+    };
+}
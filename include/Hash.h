@@ -0,0 +1,11 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+
+namespace tgl {
+    class Hash {
+    public:
+        //64-bit XXH64 hash of a byte range.
+        static uint64_t hash64(const void* data, size_t size, uint64_t seed = 0);
+    };
+}
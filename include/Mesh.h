@@ -1,22 +1,38 @@
 #pragma once
 #include "Vertex.h"
-#include "AllocatedBuffer.h"
-#include "MeshRenderData.h"
-#include "PipelineBuilder.h"
 #include <vector>
 namespace tgl {
+    //Range of MeshDescription::indices drawn for one level of detail
+    struct MeshLod {
+        uint32_t indexOffset;
+        uint32_t indexCount;
+        //Largest object space distance between this level's surface and LOD 0
+        float error;
+    };
+
     struct MeshDescription {
+        //Layout uploaded to the GPU, vertices for VERTEX_FORMAT_FLOAT and packedVertices for VERTEX_FORMAT_PACKED
+        VertexFormat vertexFormat = VERTEX_FORMAT_FLOAT;
         std::vector<Vertex> vertices;
+        std::vector<PackedVertex> packedVertices;
+        //Indices of every level of detail, back to back
         std::vector<uint32_t> indices;
-        void* renderDataMappedDestination;
-        VkDescriptorSet vkDescriptorSet;
-        MeshRenderData renderData;
-        AllocatedBuffer vertexBuffer;
-        AllocatedBuffer indexBuffer;
-        AllocatedBuffer renderDataBuffer;
+        //Finest level first. Empty if the mesh has no simplified levels, in which case all indices form LOD 0.
+        std::vector<MeshLod> lods;
+        //Object space bounding box, also the quantization range of packed positions
+        glm::vec3 boundsMin{};
+        glm::vec3 boundsMax{};
+
+        void computeBounds();
+        //Quantizes vertices into packedVertices and switches the mesh to VERTEX_FORMAT_PACKED.
+        void packVertices();
+
+        const void* getVertexData() const;
+        size_t getVertexCount() const;
+        size_t getVertexStride() const;
 
-        bool operator==(const MeshDescription& other) const;
-        bool operator<(const MeshDescription& other) const;
+        uint32_t getLodCount() const;
+        MeshLod getLod(uint32_t level) const;
     };
 
     struct Mesh {
@@ -0,0 +1,71 @@
+#pragma once
+#include "Mesh.h"
+#include <string>
+#include <cstdint>
+
+namespace tgl {
+    //On-disk layout of a .tglmesh file. The vertex, index and MeshLod ranges follow the header at MESH_CACHE_ALIGNMENT
+    //aligned offsets so they can be copied straight out of the mapping.
+    struct MeshCacheHeader {
+        char magic[8];
+        uint32_t version;
+        uint32_t headerSize;
+        //Key of the source the cache was built from
+        uint64_t sourcePathHash;
+        int64_t sourceModifiedTime;
+        uint64_t sourceSize;
+        uint64_t sourceContentHash;
+        //Anything else that changes the generated geometry, see MeshCacheKey
+        float color[4];
+        uint32_t flags;
+        float overdrawThreshold;
+        uint64_t lodSettingsHash;
+        uint32_t vertexStride;
+        uint32_t indexStride;
+        //Object space bounds, needed to dequantize packed positions
+        float boundsMin[3];
+        float boundsMax[3];
+        //Payload
+        uint64_t vertexCount;
+        uint64_t vertexOffset;
+        uint64_t indexCount;
+        uint64_t indexOffset;
+        uint64_t lodCount;
+        uint64_t lodOffset;
+        uint64_t payloadHash;
+    };
+
+    //Load options the cached geometry was generated with, a cache is only used if all of them match.
+    struct MeshCacheKey {
+        glm::vec4 color;
+        //MESH_CACHE_FLAG_* bits
+        uint32_t flags;
+        float overdrawThreshold;
+        //Hash of the level of detail ratios and error bound
+        uint64_t lodSettingsHash;
+    };
+
+    enum MeshCacheFlags {
+        //Indices and vertices went through MeshOptimizer::optimize
+        MESH_CACHE_FLAG_OPTIMIZED = 1 << 0,
+        //Vertices are stored as PackedVertex instead of Vertex
+        MESH_CACHE_FLAG_PACKED_VERTICES = 1 << 1
+    };
+
+    class MeshCache {
+    public:
+        static const uint32_t VERSION = 4;
+        static const uint32_t MESH_CACHE_ALIGNMENT = 64;
+
+        //Next to the source file, named after a hash of the key so loads of one source with different options keep
+        //their own caches
+        static std::string getCachePath(const char* sourcePath, const MeshCacheKey& key);
+        //Fills the description from the cache next to the source file. A source that was touched but whose content
+        //is unchanged gets its new modification time recorded, so it is only hashed once.
+        //Returns false if there is no cache or it is stale or corrupt, in which case the source has to be parsed.
+        static bool load(const char* sourcePath, const MeshCacheKey& key, MeshDescription& description);
+        //Writes the cache for a freshly loaded mesh, sourceContentHash being the Hash::hash64 of the source file.
+        static bool store(const char* sourcePath, const MeshCacheKey& key, uint64_t sourceContentHash,
+                          const MeshDescription& description);
+    };
+}
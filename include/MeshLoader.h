@@ -1,14 +1,80 @@
 #pragma once
 #include "Mesh.h"
+#include "ObjParser.h"
+#include "MeshCache.h"
+#include "VertexHashTable.h"
+#include "MeshOptimizer.h"
+#include "MeshSimplifier.h"
+#include "ThreadPool.h"
 #include "tiny_obj_loader.h"
 #include "VkUtils.h"
 #include <unordered_map>
+#include <future>
 #include <iostream>
 
 namespace tgl {
+    struct MeshLoadOptions {
+        //Pool the file is parsed on, the loader's shared pool if null
+        ThreadPool* threadPool = nullptr;
+        //Read and write the binary .tglmesh cache next to the source file
+        bool useCache = true;
+        //Reorder the mesh for vertex cache, overdraw and vertex fetch efficiency, see MeshOptimizer
+        bool optimize = false;
+        //How much the vertex cache efficiency may degrade in favor of less overdraw, 1 disables the overdraw pass
+        float overdrawThreshold = 1.05F;
+        //Receives the vertex cache statistics before and after the optimization if optimize is set. Left untouched
+        //when the mesh comes from the cache, its statistics were measured by the load that stored it. loadObjAsync
+        //writes it before its future becomes ready.
+        MeshOptimizationReport* optimizationReport = nullptr;
+        //VERTEX_FORMAT_PACKED quantizes the vertices to 16 bytes, see PackedVertex
+        VertexFormat vertexFormat = VERTEX_FORMAT_FLOAT;
+        //Index count of each generated level of detail relative to the full mesh, e.g. {0.5, 0.25, 0.125}, see
+        //MeshSimplifier. Empty by default, the levels are appended to description.indices behind LOD 0.
+        std::vector<float> lodRatios;
+        //Largest surface deviation a level of detail may introduce, relative to the bounding box diagonal
+        float lodTargetError = 0.02F;
+    };
+
+    //Outcome of one file of MeshLoader::loadObjBatch
+    struct MeshLoadResult {
+        Mesh mesh;
+        bool success = false;
+        //Why the file failed to load, empty on success
+        std::string error;
+        //See MeshLoadOptions::optimizationReport, zero unless the file was optimized by this load
+        MeshOptimizationReport optimizationReport{};
+    };
+
     class MeshLoader {
+    private:
+        //Meshes loaded concurrently by loadObjAsync, each of them still parses on the shared pool
+        static const uint32_t STREAMING_THREAD_COUNT = 2;
+
+        static ThreadPool& getThreadPool();
+        static ThreadPool& getStreamingThreadPool();
+        static void buildMesh(const ObjData& objData, glm::vec4 color, MeshDescription& description);
+        //Loads the file, parsing it on threadPool or on the calling thread if null. Reports failures through error
+        //instead of exiting, loadObj turns them into ERROR.
+        static bool tryLoadObj(const char* filePath, glm::vec4 color, const MeshLoadOptions& options,
+                               ThreadPool* threadPool, Mesh& result, std::string& error);
     public:
         static Mesh loadObj(const char* filePath);
         static Mesh loadObj(const char* filePath, glm::vec4 color);
+        static Mesh loadObj(const char* filePath, glm::vec4 color, const MeshLoadOptions& options);
+        //Loads on the streaming threads, the future becomes ready once the mesh is in memory (see
+        //Renderer::addMeshAsync to upload it). options.threadPool must not be the streaming pool. A file that fails
+        //to load makes the future hold a std::runtime_error with the reason instead of a mesh.
+        static std::shared_future<Mesh> loadObjAsync(const char* filePath, glm::vec4 color,
+                                                     const MeshLoadOptions& options = MeshLoadOptions());
+        //Loads many files at once, one file per task on options.threadPool (the shared pool if null). Each file is
+        //parsed on its worker alone, which scales better than splitting every file. colors[i] applies to
+        //filePaths[i], a single color applies to all of them. Repeated path and color pairs are only loaded once.
+        //Results are in input order, a file that fails doesn't affect the others. Must not be called from a
+        //worker of the pool it loads on.
+        static std::vector<MeshLoadResult> loadObjBatch(const std::vector<std::string>& filePaths,
+                                                        const std::vector<glm::vec4>& colors,
+                                                        const MeshLoadOptions& options = MeshLoadOptions());
+        //Single threaded reference path through tinyobjloader.
+        static Mesh loadObjTinyObj(const char* filePath, glm::vec4 color);
     };
-}
\ No newline at end of file
+}
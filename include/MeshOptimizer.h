@@ -0,0 +1,43 @@
+#pragma once
+#include "Mesh.h"
+#include <vector>
+#include <cstdint>
+
+namespace tgl {
+    struct VertexCacheStatistics {
+        //Average cache miss ratio, transformed vertices per triangle. 0.5 is the theoretical optimum, 3 the worst case.
+        float acmr;
+        //Average transformed to vertex ratio, transformed vertices per unique vertex. 1 is optimal.
+        float atvr;
+    };
+
+    struct MeshOptimizationReport {
+        VertexCacheStatistics before;
+        VertexCacheStatistics after;
+    };
+
+    //Post-load reordering of a mesh's index and vertex buffers. The geometry doesn't change, only the order
+    //in which the GPU transforms triangles and fetches vertices.
+    class MeshOptimizer {
+    public:
+        //FIFO cache size used for the statistics, close to what current GPUs effectively achieve
+        static const uint32_t ANALYSIS_CACHE_SIZE = 16;
+        //LRU cache size the vertex cache optimization targets
+        static const uint32_t OPTIMIZATION_CACHE_SIZE = 32;
+
+        //Reorders triangles for post-transform cache locality (Forsyth's linear-speed algorithm).
+        static void optimizeVertexCache(std::vector<uint32_t>& indices, size_t vertexCount);
+        //Reorders clusters of a cache optimized index buffer so outward facing clusters are drawn first.
+        //threshold bounds how much the ACMR may degrade, e.g. 1.05 allows 5% more vertex transforms.
+        static void optimizeOverdraw(std::vector<uint32_t>& indices, const std::vector<Vertex>& vertices,
+                                     float threshold);
+        //Reorders the vertices in the order they are first referenced and drops unreferenced ones.
+        static void optimizeVertexFetch(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices);
+
+        static VertexCacheStatistics analyzeVertexCache(const std::vector<uint32_t>& indices, size_t vertexCount,
+                                                        uint32_t cacheSize = ANALYSIS_CACHE_SIZE);
+
+        //Runs all of the above in order and reports the cache statistics before and after.
+        static MeshOptimizationReport optimize(MeshDescription& description, float overdrawThreshold);
+    };
+}
@@ -0,0 +1,133 @@
+#pragma once
+#include "Mesh.h"
+#include "AllocatedBuffer.h"
+#include "GeometryArena.h"
+#include "UploadEngine.h"
+#include <unordered_map>
+#include <future>
+#include <vector>
+#include <deque>
+#include <cstdint>
+
+namespace tgl {
+    //Where a mesh's vertex and index buffers live
+    enum MeshMemory {
+        //Copied once through a staging buffer, the GPU reads them from its own memory. Meant for static geometry.
+        MESH_MEMORY_DEVICE_LOCAL,
+        //Host visible so they can be mapped and rewritten, for dynamic geometry. Not shared with identical meshes.
+        MESH_MEMORY_HOST_VISIBLE
+    };
+
+    //Lightweight reference to a mesh in a MeshRegistry, entities store this instead of the geometry
+    struct MeshHandle {
+        static const uint32_t INVALID_INDEX = UINT32_MAX;
+        uint32_t index = INVALID_INDEX;
+
+        bool isValid() const {
+            return index != INVALID_INDEX;
+        }
+
+        bool operator==(const MeshHandle& other) const {
+            return index == other.index;
+        }
+
+        bool operator!=(const MeshHandle& other) const {
+            return index != other.index;
+        }
+    };
+
+    struct MeshEntry {
+        MeshDescription description;
+        //Owned by host visible meshes only, device local ones are suballocated from the registry's geometry arenas
+        AllocatedBuffer vertexBuffer{};
+        AllocatedBuffer indexBuffer{};
+        GeometryAllocation vertexAllocation;
+        GeometryAllocation indexAllocation;
+        //What a draw binds and offsets by, valid once resident. Add MeshLod::indexOffset to firstIndex.
+        VkBuffer vkVertexBuffer = VK_NULL_HANDLE;
+        VkBuffer vkIndexBuffer = VK_NULL_HANDLE;
+        int32_t vertexOffset = 0;
+        uint32_t firstIndex = 0;
+        //Hash of the geometry, see MeshRegistry::hashGeometry
+        uint64_t contentHash = 0;
+        MeshMemory memory = MESH_MEMORY_DEVICE_LOCAL;
+        uint32_t referenceCount = 0;
+        //Frame the last reference was released in
+        uint64_t retiredFrame = 0;
+        //Entry holding the geometry. An entry that finished loading as a duplicate points to the original one.
+        uint32_t canonicalIndex = MeshHandle::INVALID_INDEX;
+        //Duplicates resolved to this entry, freed together with it
+        std::vector<uint32_t> aliases;
+        bool used = false;
+        bool resident = false;
+        //Set while the geometry is still loading
+        std::shared_future<Mesh> pendingMesh;
+    };
+
+    //Content addressed store of the meshes in use. Identical geometry is kept and uploaded once, no matter how
+    //many entities draw it, and its GPU buffers live until the last reference is released.
+    class MeshRegistry {
+    private:
+        static const VkDeviceSize VERTEX_ARENA_BLOCK_BYTES = 64 * 1024 * 1024;
+        static const VkDeviceSize INDEX_ARENA_BLOCK_BYTES = 32 * 1024 * 1024;
+
+        //Copies the device local meshes out of their staging buffer
+        UploadEngine* uploadEngine = nullptr;
+        VmaAllocator allocator{};
+        //One per VertexFormat, vertexOffset counts in vertices of the bound stride
+        GeometryArena vertexArenas[2];
+        GeometryArena indexArena;
+        std::vector<MeshEntry> entries;
+        std::vector<uint32_t> freeIndices;
+        //Canonical entries by content hash, colliding hashes are told apart by comparing the geometry
+        std::unordered_multimap<uint64_t, uint32_t> entriesByHash;
+        //Entries still loading or waiting for their upload, in registration order
+        std::deque<uint32_t> pendingEntries;
+        //Released entries and the frame they were released in, their buffers may still be used by that frame
+        std::deque<std::pair<uint32_t, uint64_t>> retiredEntries;
+
+        static uint64_t hashGeometry(const MeshDescription& description);
+        static bool isSameGeometry(const MeshDescription& description, const MeshDescription& other);
+
+        uint32_t allocateEntry();
+        uint32_t resolve(MeshHandle handle) const;
+        //Index of a registered entry with the same geometry, MeshHandle::INVALID_INDEX if there is none
+        uint32_t findDuplicate(const MeshDescription& description, uint64_t contentHash) const;
+        //Creates the buffers of the given entries. Device local ones share one staging buffer and one submission.
+        void uploadEntries(const std::vector<uint32_t>& indices);
+        void destroyEntry(uint32_t index);
+
+    public:
+        void init(UploadEngine* uploadEngine, VmaAllocator allocator);
+
+        //Registers loaded geometry and returns a handle holding one reference. Geometry that is already registered
+        //returns the existing handle. The upload happens in processUploads.
+        MeshHandle add(Mesh mesh, MeshMemory memory = MESH_MEMORY_DEVICE_LOCAL);
+        //Registers a mesh that is still loading, e.g. from MeshLoader::loadObjAsync. The handle can be used right
+        //away, the mesh becomes resident once it finished loading and was uploaded. A load that failed never does.
+        MeshHandle addAsync(const std::shared_future<Mesh>& mesh, MeshMemory memory = MESH_MEMORY_DEVICE_LOCAL);
+
+        //Adds a reference. Invalid handles are ignored by acquire and release.
+        void acquire(MeshHandle handle);
+        //Drops a reference. The last one retires the mesh, it is destroyed by collectGarbage once frame is done.
+        void release(MeshHandle handle, uint64_t frame);
+
+        bool isResident(MeshHandle handle) const;
+        const MeshEntry& getEntry(MeshHandle handle) const;
+        const MeshDescription& getDescription(MeshHandle handle) const;
+        GeometryArenaStats getVertexArenaStats(VertexFormat vertexFormat) const;
+        GeometryArenaStats getIndexArenaStats() const;
+        //Registered meshes, including the ones still loading. Duplicates resolved to another mesh don't count.
+        size_t getMeshCount() const;
+
+        //Resolves finished loads and uploads pending meshes in registration order. Stops once budgetBytes of
+        //vertex and index data went up, a single mesh larger than the budget still goes through on its own.
+        //Everything uploaded in one call goes through a single staging buffer and queue submission on the upload
+        //engine, which the current frame has to wait on, see UploadEngine::takeWaitSemaphores.
+        //Returns the uploaded byte count.
+        uint64_t processUploads(uint64_t budgetBytes);
+        //Destroys retired meshes released at least framesInFlight frames before currentFrame
+        void collectGarbage(uint64_t currentFrame, uint32_t framesInFlight);
+        void destroy();
+    };
+}
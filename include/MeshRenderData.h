@@ -1,8 +1,14 @@
 #pragma once
 #include <glm/glm.hpp>
 namespace tgl {
+    //Per object data, one element of the ObjectBuffer storage buffer array in the vertex shaders. The renderer keeps
+    //one per entity in a persistent buffer.
     struct MeshRenderData {
         glm::mat4 model;
         glm::vec3 lightPos;
+        //Dequantization of VERTEX_FORMAT_PACKED positions, position = positionOffset + unorm * positionScale.
+        //Aligned to match the std430 layout of the storage buffer.
+        alignas(16) glm::vec4 positionScale;
+        glm::vec4 positionOffset;
     };
 }
\ No newline at end of file
@@ -0,0 +1,24 @@
+#pragma once
+#include "Mesh.h"
+#include <vector>
+#include <cstdint>
+
+namespace tgl {
+    //Quadric error metric simplification (Garland and Heckbert) restricted to half-edge collapses, a vertex is only
+    //ever collapsed onto one of its neighbours. Simplified index buffers therefore keep referencing the original
+    //vertex buffer, which is what lets all levels of detail of a mesh share it.
+    class MeshSimplifier {
+    public:
+        //Collapses edges until the index count drops to targetIndexCount or the next collapse would move the surface
+        //further than targetError, given relative to the bounding box diagonal. resultError receives the largest
+        //error reached in the same unit.
+        static std::vector<uint32_t> simplify(const std::vector<uint32_t>& indices, const std::vector<Vertex>& vertices,
+                                              size_t targetIndexCount, float targetError,
+                                              float* resultError = nullptr);
+
+        //Appends one simplified index range per ratio (index count relative to LOD 0) to description.indices and
+        //fills description.lods, LOD 0 being the original index buffer. Levels that can't be reduced within
+        //targetError are skipped, so the chain can be shorter than the ratio list.
+        static void buildLodChain(MeshDescription& description, const std::vector<float>& ratios, float targetError);
+    };
+}
@@ -0,0 +1,33 @@
+#pragma once
+#include "ThreadPool.h"
+#include <glm/glm.hpp>
+#include <string>
+#include <vector>
+#include <cstdint>
+
+namespace tgl {
+    struct ObjCorner {
+        //Zero based index into ObjData::positions
+        int32_t vertexIndex;
+        //Zero based index into ObjData::normals, -1 if the face didn't reference a normal
+        int32_t normalIndex;
+    };
+
+    struct ObjData {
+        std::vector<glm::vec3> positions;
+        std::vector<glm::vec3> normals;
+        //Triangulated face corners in file order, three per triangle.
+        std::vector<ObjCorner> corners;
+    };
+
+    //Parses the geometry records (v, vn, f) of a Wavefront OBJ file.
+    //The input is split into chunks on line boundaries which are parsed on the thread pool workers,
+    //the chunk results are then merged in file order so the output doesn't depend on the thread count.
+    class ObjParser {
+    public:
+        static bool parse(const char* data, size_t size, ObjData& result, std::string& error,
+                          ThreadPool* threadPool = nullptr);
+        static bool parseFile(const char* filePath, ObjData& result, std::string& error,
+                              ThreadPool* threadPool = nullptr);
+    };
+}
@@ -5,6 +5,9 @@
 #include "Vertex.h"
 namespace tgl {
     class PipelineBuilder {
+    private:
+        void createDescriptorSetLayout(VkDevice &device);
+
     public:
         std::vector<VkPipelineShaderStageCreateInfo> vkShaderStages;
         VkPipelineVertexInputStateCreateInfo vkPipelineVertexInputStateCreateInfo{};
@@ -13,16 +16,24 @@ namespace tgl {
         VkPipelineColorBlendAttachmentState vkPipelineColorBlendAttachmentState{};
         VkPipelineMultisampleStateCreateInfo vkPipelineMultisampleStateCreateInfo{};
         VkPipelineLayout vkPipelineLayout{};
-        VkDescriptorPool vkDescriptorPool{};
+        //Shared by the graphics and the compute pipelines. Sets with this layout are allocated from the renderer's
+        //DescriptorAllocator.
         VkDescriptorSetLayout vkDescriptorSetLayout{};
+        //Layout of the compute pipelines, the same set layout with CullConstants as push constants
+        VkPipelineLayout vkComputePipelineLayout{};
+        //Passed to every pipeline creation, see PipelineCache. Not owned by the builder.
+        VkPipelineCache vkPipelineCache = VK_NULL_HANDLE;
 
         PipelineBuilder() = default;
 
+        //The descriptor set layout and pipeline layout are created by the first build and shared by later ones,
+        //so pipelines that only differ in shaders and vertex layout can be built from the same builder.
+        //Viewport and scissor are dynamic state, set while recording, so the pipelines survive a resize.
         VkPipeline build(VkDevice &device, GPU& gpu, VkRenderPass &pass, VkShaderModule &vkVertexShaderModule,
-                         VkShaderModule &vkFragmentShaderModule, VkViewport& vkViewport, VkRect2D& vkScissor, VkPrimitiveTopology vkTopology,
+                         VkShaderModule &vkFragmentShaderModule, const VertexInputDescription& vertexInputDescription, VkPrimitiveTopology vkTopology,
                          VkPolygonMode vkPolygonMode,
                          VkCullModeFlags vkCullModeFlags, VkFrontFace vkFrontFace, bool depthTestEnabled, bool depthWriteEnabled);
 
-        void allocateDescriptorSets(VkDevice& vkLogicalDevice, VkDescriptorSet* vkDescriptorSet);
+        VkPipeline buildCompute(VkDevice &device, VkShaderModule &vkComputeShaderModule);
     };
 }
\ No newline at end of file
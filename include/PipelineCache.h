@@ -0,0 +1,21 @@
+#pragma once
+#include "VkUtils.h"
+#include <string>
+#include <cstdint>
+
+namespace tgl {
+    //Persists a VkPipelineCache between runs, so pipelines built by an earlier run skip the driver's shader compilation.
+    class PipelineCache {
+    public:
+        //Size of VkPipelineCacheHeaderVersionOne: header size, header version, vendor ID, device ID and cache UUID
+        static const uint32_t HEADER_SIZE = 16 + VK_UUID_SIZE;
+
+        //Creates the pipeline cache, seeded with the blob at cachePath if its header matches the GPU and driver.
+        //warm is set if the blob was used, a missing, foreign or corrupt blob leaves an empty cache.
+        static VkPipelineCache load(VkDevice vkLogicalDevice, const VkPhysicalDeviceProperties& vkPhysicalDeviceProperties,
+                                    const std::string& cachePath, bool& warm);
+        //Writes the cache, with the loaded entries and the ones added since, to cachePath.
+        //Returns false if the data couldn't be retrieved or written, an existing blob is left untouched then.
+        static bool store(VkDevice vkLogicalDevice, VkPipelineCache vkPipelineCache, const std::string& cachePath);
+    };
+}
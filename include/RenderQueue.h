@@ -0,0 +1,71 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+namespace tgl {
+    //Passes in the order they are drawn, the most significant part of a draw key
+    enum DrawPass : uint32_t {
+        DRAW_PASS_OPAQUE = 0
+    };
+
+    //One visible entity to draw
+    struct DrawPacket {
+        //See RenderQueue::makeKey
+        uint64_t key;
+        uint32_t entityIndex;
+    };
+
+    //Render state changes of one frame. A bind is skipped when a draw uses the state the previous draw already bound,
+    //without sorting each draw would have bound its own.
+    struct BindCounters {
+        uint32_t pipelineBinds = 0;
+        uint32_t pipelineBindsSkipped = 0;
+        uint32_t descriptorSetBinds = 0;
+        uint32_t descriptorSetBindsSkipped = 0;
+        uint32_t vertexBufferBinds = 0;
+        uint32_t vertexBufferBindsSkipped = 0;
+        uint32_t indexBufferBinds = 0;
+        uint32_t indexBufferBindsSkipped = 0;
+
+        uint32_t getIssued() const;
+        uint32_t getSkipped() const;
+        BindCounters& operator+=(const BindCounters& other);
+    };
+
+    //Packets of the entities drawn this frame. Sorting them by key puts packets sharing render state next to each
+    //other, so consecutive draws rebind as little as possible.
+    class RenderQueue {
+    private:
+        std::vector<DrawPacket> packets;
+        //Second buffer of the radix sort, kept so its capacity is reused
+        std::vector<DrawPacket> sortBuffer;
+
+    public:
+        //Width of each key field, from the most significant one down
+        static const uint32_t PASS_BITS = 2;
+        static const uint32_t PIPELINE_BITS = 4;
+        static const uint32_t MATERIAL_BITS = 10;
+        static const uint32_t MESH_BITS = 24;
+        static const uint32_t LOD_BITS = 8;
+        static const uint32_t DEPTH_BITS = 16;
+        //Packets whose keys only differ outside the mask share all their state and can be drawn as one instanced draw
+        static const uint64_t BATCH_MASK = ~((1ULL << DEPTH_BITS) - 1);
+
+        //Pass, pipeline, material, mesh and level of detail, then depth in [0, 1] so packets with the same state are
+        //ordered front to back. Fields wider than their bits are truncated.
+        static uint64_t makeKey(uint32_t pass, uint32_t pipeline, uint32_t material, uint32_t mesh, uint32_t lod,
+                                float depth);
+
+        void clear();
+        void reserve(size_t count);
+        void push(uint64_t key, uint32_t entityIndex);
+
+        //Stable LSD radix sort over the keys, one pass per byte. Bytes every key shares, e.g. the pass while there
+        //is only one, are skipped.
+        void sort();
+
+        size_t size() const;
+        const DrawPacket& operator[](size_t index) const;
+    };
+}
@@ -10,12 +10,26 @@
 #include "Camera.h"
 #include "Light.h"
 #include "MeshRenderData.h"
+#include "MeshRegistry.h"
+#include "UploadEngine.h"
+#include "FrameAllocator.h"
+#include "DescriptorAllocator.h"
+#include "CullData.h"
+#include "FrustumCuller.h"
+#include "ThreadPool.h"
+#include "RenderQueue.h"
+#include "FrameLimiter.h"
+#include "PipelineCache.h"
 #include <glm/gtx/transform.hpp>
 #include <map>
+#include <algorithm>
 #include <cstring>
 #include <cmath>
 #include <deque>
-#define TGL_LOGGER_ENABLED
+#include <future>
+#include <memory>
+#include <chrono>
+#include <functional>
 namespace tgl {
     struct FrameData {
         //Vulkan synchronization structures.
@@ -27,12 +41,39 @@ namespace tgl {
 
         VkCommandPool vkCommandPool;
         VkCommandBuffer vkMainCommandBuffer;
+        //One pool and secondary command buffer per recording thread, empty if recording is single threaded
+        std::vector<VkCommandPool> vkSecondaryCommandPools;
+        std::vector<VkCommandBuffer> vkSecondaryCommandBuffers;
 
-        AllocatedBuffer objectBuffer;
+        //Entity writes staged for the persistent buffers, visible instances and draw commands of this frame, reset
+        //once vkRenderFence signaled
+        FrameAllocator objectAllocator;
+        //Sets only used by this frame's commands, reset once vkRenderFence signaled
+        DescriptorAllocator transientDescriptors;
+        //Draw commands written this frame, read back once vkRenderFence signaled to count the visible instances
+        VkDeviceSize drawCommandsOffset = 0;
+        uint32_t drawCommandCount = 0;
+        //Headless only, host visible copy of the frame's color image. Read once vkRenderFence signaled, so the CPU
+        //never stalls on a frame still in flight.
+        AllocatedBuffer readbackBuffer{};
+        bool readbackPending = false;
+        //frameCount of the frame copied into readbackBuffer
+        uint32_t readbackFrame = 0;
     };
     //Double buffering
     class Renderer {
     private:
+        //Initial capacity of each frame's object allocator. Grows before a frame that needs more is written.
+        static const VkDeviceSize FRAME_OBJECT_BYTES = 1024 * 1024;
+        //Entities the persistent object and culling buffers have room for at first, they double when more are
+        //registered
+        static const uint32_t INITIAL_ENTITY_CAPACITY = 1024;
+        //entityFlags bits
+        static const uint8_t ENTITY_DIRTY = 1;
+        static const uint8_t ENTITY_DRAWN = 2;
+        //Below this many draw batches per thread a frame is recorded on the calling thread only
+        static const size_t MIN_BATCHES_PER_RECORDING_THREAD = 64;
+
         //Vulkan instance
         VkInstance vkInstance{};
         //Logical device
@@ -48,19 +89,57 @@ namespace tgl {
 
         //Swapchain
         VkSwapchainKHR vkSwapchain{};
+        //presentMode or its fallback if the surface doesn't support it
+        VkPresentModeKHR vkPresentMode = VK_PRESENT_MODE_FIFO_KHR;
         VkExtent2D vkWindowExtent{};
         VkFormat vkSwapchainImageFormat{};
         std::vector<VkImage> vkSwapchainImages{};
         std::vector<VkImageView> vkSwapchainImageViews{};
+        //Set when the swapchain no longer matches the surface, it is recreated before the next acquire
+        bool swapchainOutdated = false;
+        //Swapchain resources replaced by a resize, destroyed once no frame in flight can use them anymore
+        struct RetiredSwapchain {
+            VkSwapchainKHR vkSwapchain;
+            std::vector<VkImageView> vkImageViews;
+            std::vector<VkFramebuffer> vkFramebuffers;
+            AllocatedImage depthImage;
+            VkImageView depthImageView;
+            //frameCount when it was replaced
+            uint32_t frame;
+        };
+        std::deque<RetiredSwapchain> retiredSwapchains;
+        //Headless only, the color images taking the place of the swapchain images
+        std::vector<AllocatedImage> offscreenImages{};
+        //Render fence of the frame that last rendered to each swapchain image, VK_NULL_HANDLE until one did
+        std::vector<VkFence> vkImagesInFlight{};
         //Queue
         VkQueue vkGraphicsQueue{};
         uint8_t vkGraphicsQueueFamilyIndex{};
+        //Dedicated transfer queue if the GPU has one, the graphics queue otherwise
+        VkQueue vkTransferQueue{};
+        uint32_t vkTransferQueueFamilyIndex{};
+        UploadEngine uploadEngine;
 
         VkPipeline vkPipeline;
+        //Same layout and fragment shader as vkPipeline, used for meshes in VERTEX_FORMAT_PACKED
+        VkPipeline vkPackedPipeline;
+        //Frustum culling compute pipeline, see cull.comp
+        VkPipeline vkCullPipeline;
         PipelineBuilder pipelineBuilder;
+        VkPipelineCache vkPipelineCache = VK_NULL_HANDLE;
+        //Whether init seeded the pipeline cache from pipelineCachePath
+        bool pipelineCacheWarm = false;
+        float pipelineBuildMilliseconds = 0;
 
         VkShaderModule vkVertexShaderModule;
+        VkShaderModule vkPackedVertexShaderModule;
         VkShaderModule vkFragmentShaderModule;
+        VkShaderModule vkCullShaderModule;
+
+        //GPU culling needs firstInstance in indirect draws. Without multi draw indirect every command is drawn by its
+        //own vkCmdDrawIndexedIndirect.
+        bool drawIndirectFirstInstanceSupported = false;
+        bool multiDrawIndirectSupported = false;
 
         //Render pass
         //The renderpass allows us to tell the GPU that we are going to send some rendering commands allowing it to optimize. Subpasses also exist to allow it to optimize even further.
@@ -68,8 +147,16 @@ namespace tgl {
         //Framebuffers.The framebuffer links to the images you will render to, and it’s used when starting a renderpass to set the target images for rendering.
         std::vector<VkFramebuffer> vkFramebuffers{};
 
+        //Renders into offscreen images instead of a window's swapchain, see the headless constructor
+        bool headless = false;
+        //Size and background color of a headless renderer, never created as a GLFW window
+        Window headlessWindow;
+
+        //Frames in flight, independent of the number of swapchain images
         uint32_t bufferingAmount;
-        uint32_t frameCount;
+        uint32_t frameCount = 0;
+        float cpuWaitMilliseconds = 0;
+        FrameLimiter frameLimiter;
         FrameData* frames;
 
         //Depth testing
@@ -77,11 +164,88 @@ namespace tgl {
         VkImageView depthImageView{};
 
         std::vector<Entity> entities;
+        //ENTITY_DIRTY while an entity's object data has to be written, ENTITY_DRAWN once it was written with a
+        //resident mesh
+        std::vector<uint8_t> entityFlags;
+        //Entities flagged ENTITY_DIRTY. Those whose mesh isn't resident yet stay until it is.
+        std::vector<uint32_t> dirtyEntities;
+        //Entities updateBuffers wrote this frame, their object data is copied into objectBuffer
+        std::vector<uint32_t> entityWrites;
+        //Light position in the object data of every written entity
+        glm::vec3 lightPosition{};
+
+        //MeshRenderData of every entity, indexed like entities. Device local and only written for dirty entities.
+        AllocatedBuffer objectBuffer{};
+        //CullObject of every entity, indexed like entities. Rewritten with the culled batches.
+        AllocatedBuffer cullBuffer{};
+        uint32_t entityCapacity = 0;
+        //Buffers replaced by larger ones, destroyed once no frame in flight can use them anymore
+        struct RetiredBuffer {
+            AllocatedBuffer buffer;
+            //frameCount when it was replaced
+            uint32_t frame;
+        };
+        std::deque<RetiredBuffer> retiredBuffers;
+
+        //Records the draws of a frame into the frame's secondary command buffers, one per worker
+        std::unique_ptr<ThreadPool> recordingThreadPool;
+        uint32_t recordingThreadCount = 1;
+
+        //World space bounding spheres of the drawn entities, filled by buildBatches
+        FrustumCuller frustumCuller;
+        //Indices of the entities in the camera frustum. Kept across frames so its capacity is reused.
+        std::vector<uint32_t> visibleEntities;
+        //Packets of the visible entities, sorted so entities sharing a mesh and level of detail end up next to each
+        //other and are drawn as the instances of one draw. buildCulledBatches groups the drawn entities by mesh with
+        //it. Kept across frames so its capacity is reused.
+        RenderQueue renderQueue;
+
+        //Instances sharing a mesh and level of detail. Without GPU culling command's instanceCount is the number of
+        //instances, with it the culling pass counts them from 0.
+        struct DrawBatch {
+            VkPipeline vkPipeline;
+            VkBuffer vkVertexBuffer;
+            VkBuffer vkIndexBuffer;
+            VkDrawIndexedIndirectCommand command;
+            float lodError;
+        };
+        //Kept across frames so its capacity is reused. With GPU culling they only change when an entity is registered,
+        //cleared or drawn for the first time, see buildCulledBatches.
+        std::vector<DrawBatch> drawBatches;
+        //Set when drawBatches no longer match the entities GPU culling draws
+        bool culledBatchesOutdated = true;
+        //Visible instance slots of the culled batches, every level of detail of a mesh has room for all its entities
+        uint32_t culledInstanceCapacity = 0;
+        //Culling input written by buildCulledBatches, copied into cullBuffer by the next frame
+        std::vector<CullObject> cullObjects;
+        bool cullObjectsPending = false;
+        //Copies of the frame's entity writes, kept across frames so its capacity is reused
+        std::vector<VkBufferCopy> vkEntityCopies;
+        uint32_t drawCallCount = 0;
+        uint32_t visibleInstanceCount = 0;
+        BindCounters bindCounters;
+
+        //Sort key of an entity's packet, see RenderQueue::makeKey
+        static uint64_t makeDrawKey(const MeshEntry& meshEntry, const Entity& entity, const Camera& camera);
 
         void prepareVulkan();
 
         void initSwapchain();
 
+        void initOffscreenTargets();
+
+        void initDepthImage();
+
+        //Recreates the swapchain if the window was resized or the swapchain went out of date. Returns false while the
+        //window is minimized, nothing can be rendered then.
+        bool updateSwapchain();
+
+        //Builds a new swapchain from the old one together with everything depending on the size, the old resources are
+        //retired
+        void recreateSwapchain();
+
+        void destroySwapchainResources(const RetiredSwapchain& swapchain);
+
         void initCommands();
 
         void initRenderpass();
@@ -92,23 +256,122 @@ namespace tgl {
 
         void initPipeline();
 
+        void initFrameAllocators();
+
+        //Flags the entity's object data to be written by the next frame
+        void markEntityDirty(uint32_t entityIndex);
+
+        //Replaces objectBuffer and cullBuffer with ones that fit every entity and marks all of them to be written
+        void growEntityBuffers();
+
+        //Batches of the entities the CPU culling left, sorted so entities sharing a mesh and level of detail are drawn
+        //as the instances of one draw
+        void buildBatches(const Camera& camera);
+
+        //One batch per mesh and level of detail of the drawn entities, along with their culling input. Only called when
+        //the entities changed, the culling pass refills the same batches every frame.
+        void buildCulledBatches();
+
+        //Copies the frame's staged entity writes into objectBuffer and cullBuffer
+        void recordEntityWrites(FrameData& frameData, VkDeviceSize objectWritesOffset, VkDeviceSize cullWritesOffset,
+                                size_t cullWriteCount);
+
+        //Records the culling pass of the frame's draw batches, see cull.comp
+        void recordCulling(FrameData& frameData, VkDescriptorSet vkDescriptorSet, const Camera& camera,
+                           uint32_t objectCount);
+
+        //Records the batches [first, last) including all state they need, returns the number of draw commands.
+        //The binds it issues and skips are added to counters.
+        uint32_t recordBatches(VkCommandBuffer vkCommandBuffer, const FrameData& frameData, const Camera& camera,
+                               VkDescriptorSet vkDescriptorSet, size_t first, size_t last, bool culling,
+                               BindCounters& counters) const;
+
+        //Records the indirect draws of the batches [first, last), which share pipeline, vertex and index buffer
+        uint32_t recordIndirectDraws(VkCommandBuffer vkCommandBuffer, const FrameData& frameData, size_t first,
+                                     size_t last) const;
+
+        //Copies the frame's color image into its readback buffer, after the render pass
+        void recordReadback(FrameData& frameData, VkImage vkImage);
+
+        //Hands a finished frame's readback to readbackCallback
+        void deliverReadback(FrameData& frameData);
+
+        void initSecondaryCommandBuffers();
+
+        void destroySecondaryCommandBuffers();
+
         void updateBuffers(Camera& camera, const Light& light);
 
+        void selectLod(const Camera& camera, const MeshDescription& description, Entity& entity) const;
+
         FrameData& getCurrentFrame();
 
     public:
         //Chosen GPU
         GPU gpu;
         Window *window;
+        //Geometry of every entity, see Entity::mesh
+        MeshRegistry meshRegistry;
+        //A coarser level of detail is drawn once its simplification error projects to less than this many pixels
+        float lodErrorThreshold = 1.0F;
+        //Switching to a coarser level additionally requires the error to be this fraction below the threshold,
+        //so entities near the boundary don't alternate between two levels
+        float lodHysteresis = 0.25F;
+        //Vertex and index bytes the mesh registry uploads per frame. A mesh larger than the budget still goes
+        //through on its own, so it can't block the queue.
+        uint64_t uploadBudgetBytes = 16 * 1024 * 1024;
+        //Present mode of the swapchain, read by init. FIFO waits for the vertical blank, FIFO_RELAXED tears when a
+        //frame is late, MAILBOX replaces the queued image without tearing and IMMEDIATE presents right away and tears.
+        //Falls back if unsupported, see VkUtils::getOptimalPresentMode.
+        VkPresentModeKHR presentMode = VK_PRESENT_MODE_MAILBOX_KHR;
+        //Frames per second render paces itself to, 0 renders as fast as the present mode allows. With MAILBOX or
+        //IMMEDIATE a limit just above the display's refresh rate saves the frames nobody sees.
+        float frameRateLimit = 0;
+        //Called by render after it waited for the GPU, the swapchain and then the frame limiter, right before it reads
+        //the camera. Polling window events and moving the camera here instead of before render means a frame shows
+        //input that is as fresh as possible, rather than input that already waited out the frame's blocking.
+        std::function<void()> inputCallback;
+        //Headless only. While set, every frame is copied into a staging ring with a slot per frame in flight, the
+        //callback receives its frameCount and tightly packed RGBA8 pixels once the GPU finished it. That is
+        //bufferingAmount frames later, or on flushReadbacks. The pixels are only valid during the call.
+        std::function<void(uint32_t frame, const uint8_t* pixels)> readbackCallback;
+        //Pipeline cache blob read by init and rewritten by destroy, relative to the working directory like the shaders.
+        //Empty disables the on-disk cache, pipelines are then compiled from scratch on every run.
+        std::string pipelineCachePath = "pipeline.cache";
 
         Renderer(Window *window, unsigned int bufferingAmount);
+        //Headless renderer without a window or surface, e.g. for benchmarks and CI under a CPU driver like lavapipe.
+        //Renders into one offscreen color image per frame in flight, through the same render path and pipelines.
+        //window points at a description of the target that is never opened, its backgroundColor is the clear color.
+        Renderer(uint32_t width, uint32_t height, unsigned int bufferingAmount);
         ~Renderer();
 
         void init();
 
+        //Marks the entity as ready to draw. Its mesh is uploaded by the registry, its object data when it is registered
+        //or moved.
         void uploadEntity(Entity &entity);
 
-        void registerEntity(Entity& entity);
+        //Registers geometry in the mesh registry and returns a handle holding one reference, see MeshRegistry::add.
+        //Entities drawing it get their own references, so the caller can release its reference right away.
+        MeshHandle addMesh(Mesh mesh, MeshMemory memory = MESH_MEMORY_DEVICE_LOCAL);
+
+        //Same as addMesh for a mesh that is still loading, e.g. from MeshLoader::loadObjAsync. Entities using the
+        //handle are drawn once the mesh finished loading and was uploaded, without blocking the frames in between.
+        //If the load fails they are never drawn, get on the future reports why.
+        MeshHandle addMeshAsync(const std::shared_future<Mesh>& mesh, MeshMemory memory = MESH_MEMORY_DEVICE_LOCAL);
+
+        //Drops a reference, the geometry is freed once no frame in flight uses it anymore
+        void releaseMesh(MeshHandle mesh);
+
+        //Acquires a reference to the entity's mesh, released again by clearEntities. Returns the index
+        //setEntityTransform takes.
+        uint32_t registerEntity(Entity& entity);
+
+        //Moves a registered entity. Only entities moved, registered or whose mesh became resident since the last frame
+        //have their object data written to the GPU.
+        void setEntityTransform(uint32_t entityIndex, const glm::vec3& position, float pitch, float yaw, float roll,
+                                const glm::vec3& scale);
 
         void registerEntities(std::vector<Entity>& entities);
 
@@ -116,6 +379,53 @@ namespace tgl {
 
         void render(Camera& camera, Light& light);
 
+        //Culls entities outside the camera frustum on the CPU before they are batched, see FrustumCuller. Only used
+        //while GPU culling isn't, which never looks at the entities on the CPU.
+        bool cpuCulling = true;
+        //Culls entities outside the camera frustum and picks their level of detail on the GPU, then draws indirectly.
+        //The CPU's work per frame then no longer depends on the number of entities. Only used if the GPU supports
+        //drawIndirectFirstInstance, otherwise the CPU batches the entities for direct instanced draws.
+        bool gpuCulling = true;
+
+        //Threads recording a frame's draws in parallel, 1 records inline into the main command buffer. Waits for the
+        //GPU to become idle when called after init.
+        void setRecordingThreadCount(uint32_t threadCount);
+
+        uint32_t getRecordingThreadCount() const;
+
+        //Draw commands recorded by the last render. With GPU culling one indirect draw covers all meshes sharing a
+        //pipeline and geometry buffers, otherwise there is one instanced draw per mesh and level of detail.
+        uint32_t getDrawCallCount() const;
+
+        //Instances drawn by the most recent frame the GPU finished, i.e. the ones that passed culling
+        uint32_t getVisibleInstanceCount() const;
+
+        //Binds recorded by the last render and the ones skipped because the previous draw already bound that state
+        const BindCounters& getBindCounters() const;
+
+        //Time the last render blocked on its frame's fence, the swapchain and the fence of the acquired image. Close to
+        //zero while the CPU is the bottleneck, more frames in flight trade this for latency when the GPU is.
+        float getCpuWaitMilliseconds() const;
+
+        //Present mode the swapchain was created with, presentMode unless it had to fall back
+        VkPresentModeKHR getPresentMode() const;
+
+        bool isHeadless() const;
+
+        //Time init spent creating the pipelines, compare runs with and without isPipelineCacheWarm to see what the
+        //cache saves
+        float getPipelineBuildMilliseconds() const;
+
+        //Whether the pipelines were created from a pipeline cache a previous run stored
+        bool isPipelineCacheWarm() const;
+
+        //Distance of a world space position in front of the camera, as render sorts entities by it. The projection is
+        //left handed, so the view space z axis points forward and positions in front have a positive depth.
+        static float getViewDepth(const Camera& camera, const glm::vec3& position);
+
+        //Waits for the frames in flight and hands their pending readbacks to readbackCallback, oldest first
+        void flushReadbacks();
+
         void destroy();
     };
 }
\ No newline at end of file
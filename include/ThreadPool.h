@@ -1,22 +1,38 @@
 #pragma once
 #include <cstdint>
 #include <thread>
-#include <map>
+#include <deque>
 #include <vector>
 #include <functional>
 #include <mutex>
+#include <condition_variable>
 namespace tgl {
     class ThreadPool {
         friend class Renderer;
         uint32_t threadCount;
         std::vector<std::thread> threads;
         std::mutex taskMutex;
-        std::map<std::thread::id, std::vector<std::function<void()>>> tasks;
+        //Signaled when a task is queued or the pool is shutting down.
+        std::condition_variable taskCondition;
+        //Signaled when the last pending task has finished.
+        std::condition_variable finishedCondition;
+        //One task queue per worker so callers can pin work to a thread.
+        std::vector<std::deque<std::function<void()>>> tasks;
+        uint32_t pendingTasks = 0;
+        bool stopping = false;
+
+        void work(uint32_t threadIndex);
     public:
         ThreadPool();
-        ThreadPool(uint32_t threadCount);
+        explicit ThreadPool(uint32_t threadCount);
+        ~ThreadPool();
+
+        ThreadPool(const ThreadPool&) = delete;
+        ThreadPool& operator=(const ThreadPool&) = delete;
 
+        uint32_t getThreadCount() const;
         void sendTask(uint32_t threadIndex, const std::function<void()>& task);
+        //Blocks until every task sent so far has finished executing.
         void finishTasks();
     };
 }
\ No newline at end of file
@@ -0,0 +1,72 @@
+#pragma once
+#include "AllocatedBuffer.h"
+#include <vector>
+#include <deque>
+#include <cstdint>
+
+namespace tgl {
+    //Copy of a staging range into a buffer the graphics queue reads as vertex or index data
+    struct UploadCopy {
+        VkBuffer vkDstBuffer;
+        VkBufferCopy vkBufferCopy;
+    };
+
+    //Records buffer copies on a dedicated transfer queue when the GPU has one, so uploads overlap rendering instead
+    //of stalling it. Every submission signals a semaphore the next frame waits on before reading vertex input. With
+    //separate queue families the copied ranges change queue family ownership: the transfer queue releases them and
+    //the frame's command buffer acquires them, see recordAcquireBarriers. Without a dedicated transfer queue the
+    //copies go to the graphics queue and only the semaphore remains.
+    class UploadEngine {
+    private:
+        struct Submission {
+            VkCommandBuffer vkCommandBuffer{};
+            VkFence vkFence{};
+            VkSemaphore vkSemaphore{};
+            //Freed once the fence signaled
+            AllocatedBuffer stagingBuffer{};
+            //Frame that waited on the semaphore, the semaphore can't be reused before that frame finished
+            uint64_t consumingFrame = UINT64_MAX;
+            //Set once the fence signaled and the staging buffer and command buffer were freed
+            bool finished = false;
+        };
+
+        VkDevice vkLogicalDevice{};
+        VmaAllocator allocator{};
+        VkQueue vkTransferQueue{};
+        uint32_t transferQueueFamilyIndex = 0;
+        uint32_t graphicsQueueFamilyIndex = 0;
+        VkCommandPool vkCommandPool{};
+        std::deque<Submission> submissions;
+        //Submissions not yet waited on by a frame
+        std::vector<VkSemaphore> pendingSemaphores;
+        //Ranges released by the transfer queue that the graphics queue still has to acquire
+        std::vector<VkBufferMemoryBarrier> pendingAcquires;
+        std::vector<VkFence> freeFences;
+        std::vector<VkSemaphore> freeSemaphores;
+
+        VkBufferMemoryBarrier createOwnershipBarrier(const UploadCopy& copy) const;
+
+    public:
+        //transferQueue may be the graphics queue, in which case both family indices are the same
+        void init(VkDevice vkLogicalDevice, VmaAllocator allocator, VkQueue vkTransferQueue,
+                  uint32_t transferQueueFamilyIndex, uint32_t graphicsQueueFamilyIndex);
+
+        bool hasDedicatedTransferQueue() const;
+
+        //Submits the copies out of stagingBuffer without waiting for them. The engine takes ownership of
+        //stagingBuffer and destroys it once the copies are done.
+        void submit(const AllocatedBuffer& stagingBuffer, const std::vector<UploadCopy>& copies);
+
+        //Semaphores of the uploads submitted since the last call. The graphics submission of frame has to wait on
+        //them at VK_PIPELINE_STAGE_VERTEX_INPUT_BIT.
+        std::vector<VkSemaphore> takeWaitSemaphores(uint64_t frame);
+        //Records the queue family ownership acquire of everything submitted since the last call. Has to be recorded
+        //outside of a render pass into the command buffer of the frame that waits on takeWaitSemaphores.
+        void recordAcquireBarriers(VkCommandBuffer vkCommandBuffer);
+
+        //Frees the staging buffers of finished uploads and recycles the synchronization objects of uploads whose
+        //frame finished, i.e. was submitted at least framesInFlight frames before currentFrame
+        void collect(uint64_t currentFrame, uint32_t framesInFlight);
+        void destroy();
+    };
+}
@@ -3,6 +3,7 @@
 #include <glm/gtx/hash.hpp>
 #include <vulkan/vulkan.h>
 #include <vector>
+#include "Hash.h"
 namespace tgl {
     struct VertexInputDescription {
         std::vector<VkVertexInputBindingDescription> bindings;
@@ -11,26 +12,48 @@ namespace tgl {
         VkPipelineVertexInputStateCreateFlags vkPipelineVertexInputStateCreateFlags = 0;
     };
 
+    enum VertexFormat {
+        //tgl::Vertex, full precision floats
+        VERTEX_FORMAT_FLOAT = 0,
+        //tgl::PackedVertex, quantized
+        VERTEX_FORMAT_PACKED = 1
+    };
+
     struct Vertex {
         glm::vec3 position;
         glm::vec3 normal;
         glm::vec4 color;
+        Vertex() = default;
         Vertex(glm::vec3 position, glm::vec3 normal, glm::vec4 color);
         bool operator==(const Vertex &b) const;
         bool operator!=(const Vertex &b) const;
+        //64-bit hash over the packed vertex bytes, consistent with operator==.
+        uint64_t hash() const;
+        //Only describes per vertex attributes. Per instance data is a MeshRenderData the vertex shaders read from the
+        //ObjectBuffer storage buffer at gl_InstanceIndex, so instanced draws need no second vertex binding.
+        static VertexInputDescription getVertexDescription();
+        static VertexInputDescription getVertexDescription(VertexFormat vertexFormat);
+    };
+    //Vertices are hashed and cached as raw bytes, so the layout must not contain padding.
+    static_assert(sizeof(Vertex) == 10 * sizeof(float), "tgl::Vertex must be tightly packed");
+
+    //Compact vertex layout. Positions are unorm16 relative to the mesh bounding box (dequantized in the vertex shader
+    //with MeshRenderData::positionScale/positionOffset), normals are octahedral encoded snorm16 and colors unorm8.
+    struct PackedVertex {
+        uint16_t position[4];
+        int16_t normal[2];
+        uint8_t color[4];
+
+        static PackedVertex pack(const Vertex& vertex, glm::vec3 boundsMin, glm::vec3 boundsMax);
         static VertexInputDescription getVertexDescription();
     };
+    static_assert(sizeof(PackedVertex) == 16, "tgl::PackedVertex must be tightly packed");
 }
 namespace std {
     template<>
     struct hash<tgl::Vertex> {
-        size_t operator()(tgl::Vertex const other) const {
-            size_t posHash = hash<glm::vec3>()(other.position);
-            size_t colorHash = hash<glm::vec4>()(other.color);
-            //size_t uvHash = hash<glm::vec2>()(other.);
-            size_t uvHash = 1;
-            size_t normalHash = hash<glm::vec3>()(other.normal);
-            return ((((posHash ^ (colorHash << 1)) >> 1) ^ uvHash) << 1) ^ normalHash;
+        size_t operator()(tgl::Vertex const &other) const {
+            return other.hash();
         }
     };
 }
\ No newline at end of file
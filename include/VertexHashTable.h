@@ -0,0 +1,37 @@
+#pragma once
+#include "Vertex.h"
+#include <vector>
+#include <cstdint>
+
+namespace tgl {
+    //Flat open addressing (linear probing) table used to deduplicate vertices while building index buffers.
+    //The table only stores indices into the caller's vertex array, so a lookup is a single probe sequence
+    //over 8 byte slots instead of a node allocation per vertex like std::unordered_map.
+    class VertexHashTable {
+    private:
+        struct Slot {
+            //Index into the vertex array, EMPTY_SLOT if unused
+            uint32_t vertexIndex;
+            //Upper bits of the hash, compared before touching the vertex array
+            uint32_t fingerprint;
+        };
+        static const uint32_t EMPTY_SLOT = UINT32_MAX;
+
+        std::vector<Slot> slots;
+        uint64_t mask;
+        size_t size = 0;
+        size_t lookupCount = 0;
+        size_t probeCount = 0;
+
+        void grow(const std::vector<Vertex>& vertices);
+    public:
+        //maxVertexCount is an upper bound of the unique vertices, e.g. the amount of face corners.
+        explicit VertexHashTable(size_t maxVertexCount);
+
+        //Returns the index of a vertex equal to the given one, appending it to vertices first if there is none.
+        uint32_t insert(const Vertex& vertex, std::vector<Vertex>& vertices);
+
+        //Average amount of occupied slots that had to be skipped per lookup.
+        double getAverageProbeLength() const;
+    };
+}
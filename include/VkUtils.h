@@ -32,11 +32,16 @@ namespace tgl {
         static VkShaderModule createShaderModule(VkDevice& vkLogicalDevice, std::vector<uint32_t> &shaderCode);
         static int getOptimalSwapchainImageCount(GPU& gpu);
         static VkFormat getOptimalSwapchainFormat();
-        static VkPresentModeKHR getOptimalPresentMode(std::vector<VkPresentModeKHR>& vkPresentModes);
+        //The desired mode if it is in vkPresentModes. Otherwise immediate falls back to mailbox and everything to FIFO.
+        static VkPresentModeKHR getOptimalPresentMode(const std::vector<VkPresentModeKHR>& vkPresentModes,
+                                                      VkPresentModeKHR vkDesiredPresentMode);
         static void createImageView(VkDevice &vkLogicalDevice, VkImage &vkImage, VkFormat vkFormat,
                                            VkImageAspectFlags vkImageAspectFlags, VkImageView *vkImageView);
         static void submitCommandBufferImmediately(VkDevice& vkLogicalDevice, VkQueue& vkQueue, VkCommandPool& vkCommandPool, std::function<void(VkCommandBuffer& vkCommandBuffer)> task);
         static VkSampleCountFlagBits getMaxUsableSampleCount(GPU& gpu);
-        static void createBuffer(VmaAllocator& allocator, VmaAllocation& allocation, VkBuffer& vkBuffer, VkDeviceSize size, VkBufferUsageFlagBits usage);
+        //CPU_TO_GPU buffers can be mapped and written directly. GPU_ONLY buffers have to be filled through a copy from
+        //a staging buffer, but the GPU reads them from its own memory instead of across the bus.
+        static void createBuffer(VmaAllocator& allocator, VmaAllocation& allocation, VkBuffer& vkBuffer, VkDeviceSize size,
+                                 VkBufferUsageFlags usage, VmaMemoryUsage memoryUsage = VMA_MEMORY_USAGE_CPU_TO_GPU);
     };
 }
\ No newline at end of file
@@ -1,3 +1,4 @@
 glslangValidator -V vertexShader.vert
+glslangValidator -V packedVertexShader.vert -o packedVert.spv
 
-glslangValidator -V anisoFragmentShader.frag
+glslangValidator -V cull.comp -o cull.spv
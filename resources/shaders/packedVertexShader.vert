@@ -0,0 +1,62 @@
+#version 450
+//tgl::PackedVertex, see Vertex.h
+layout(location = 0) in vec4 position;
+layout(location = 1) in vec2 normal;
+layout(location = 2) in vec4 color;
+
+//Output attributes
+layout(location = 0) out vec4 fragColor;
+layout(location = 1) out vec3 fragNormal;
+layout(location = 2) out vec3 fragViewVec;
+layout(location = 3) out vec3 fragLightPos;
+layout(location = 4) out vec3 fragWorldPos;
+
+layout( push_constant ) uniform constants
+{
+    mat4 view;
+    mat4 projection;
+} CameraData;
+
+
+//tgl::MeshRenderData, see MeshRenderData.h
+struct ObjectData
+{
+    mat4 model;
+    vec3 lightPos;
+    vec4 positionScale;
+    vec4 positionOffset;
+};
+
+//Every entity's object data, indexed like the renderer's entities
+layout(std430, binding = 0) readonly buffer objectbuffer
+{
+    ObjectData objects[];
+} ObjectBuffer;
+
+//Entities of the instances that passed culling, the draw's firstInstance selects the first of ours
+layout(std430, binding = 1) readonly buffer visiblebuffer
+{
+    uint indices[];
+} VisibleBuffer;
+
+//Inverse of the octahedral encoding in PackedVertex::pack
+vec3 decodeNormal(vec2 encoded) {
+    vec3 decoded = vec3(encoded, 1.0 - abs(encoded.x) - abs(encoded.y));
+    if (decoded.z < 0.0) {
+        decoded.xy = (1.0 - abs(decoded.yx)) * vec2(decoded.x >= 0.0 ? 1.0 : -1.0, decoded.y >= 0.0 ? 1.0 : -1.0);
+    }
+    return normalize(decoded);
+}
+
+void main() {
+    ObjectData ModelData = ObjectBuffer.objects[VisibleBuffer.indices[gl_InstanceIndex]];
+    vec3 objectPos = ModelData.positionOffset.xyz + position.xyz * ModelData.positionScale.xyz;
+    vec4 worldPos = ModelData.model * vec4(objectPos, 1);
+    gl_Position = CameraData.projection * CameraData.view * worldPos;
+
+    fragColor = color;
+    fragNormal = mat3(ModelData.model) * decodeNormal(normal);
+    fragViewVec = (CameraData.view * worldPos).xyz;
+    fragLightPos = ModelData.lightPos;
+    fragWorldPos = (worldPos).xyz;
+}
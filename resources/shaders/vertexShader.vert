@@ -17,12 +17,28 @@ layout( push_constant ) uniform constants
 } CameraData;
 
 
-layout(binding = 0) uniform modeldata
+//tgl::MeshRenderData, see MeshRenderData.h
+struct ObjectData
 {
     mat4 model;
     vec3 lightPos;
-} ModelData;
+    vec4 positionScale;
+    vec4 positionOffset;
+};
+
+//Every entity's object data, indexed like the renderer's entities
+layout(std430, binding = 0) readonly buffer objectbuffer
+{
+    ObjectData objects[];
+} ObjectBuffer;
+
+//Entities of the instances that passed culling, the draw's firstInstance selects the first of ours
+layout(std430, binding = 1) readonly buffer visiblebuffer
+{
+    uint indices[];
+} VisibleBuffer;
 void main() {
+    ObjectData ModelData = ObjectBuffer.objects[VisibleBuffer.indices[gl_InstanceIndex]];
     vec4 worldPos = ModelData.model * vec4(position, 1);
     gl_Position = CameraData.projection * CameraData.view * worldPos;
 